@@ -0,0 +1,548 @@
+#include "game.hpp"
+#include "profiler.hpp"
+#include "render_queue.hpp"
+#include "gl_state.hpp"
+#include "frame_constants.hpp"
+#include "instancing.hpp"
+#include "gpu_scene.hpp"
+#include "registry.hpp"
+#include "culling.hpp"
+#include "mesh_optimizer.hpp"
+#include "shader_cache.hpp"
+#include "job_system.hpp"
+#include "frame_arena.hpp"
+#include "transient_buffer.hpp"
+#include <spdlog/spdlog.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+/*
+renders a scripted scene into an offscreen framebuffer through each draw path
+and writes per-frame timings as JSON:
+
+naive      every object with its own material bind and draw, in creation order
+sorted     the render queue, sorted by state and depth, one draw per object
+instanced  the render queue with runs of mesh and material instanced
+indirect   opaque objects culled and drawn by the GPU scene, blended ones queued
+
+the camera orbits the scene at a fixed rate per frame, so every run of the
+same arguments renders the same frames.
+*/
+
+// GL_NVX_gpu_memory_info, not every loader is generated with it
+constexpr GLenum GPU_MEMORY_TOTAL_AVAILABLE_NVX = 0x9048;
+constexpr GLenum GPU_MEMORY_CURRENT_AVAILABLE_NVX = 0x9049;
+
+constexpr float ORBIT_SPEED = 0.01f; // radians per frame
+
+enum class BenchPath {
+	Naive,
+	Sorted,
+	Instanced,
+	Indirect
+};
+
+struct BenchOptions {
+	uint32_t objects = 10000;
+	uint32_t materials = 16;
+	float transparent = 0.1f;
+	uint32_t frames = 600;
+	uint32_t warmup = 60;
+	glm::ivec2 size{ 1280, 720 };
+	uint32_t seed = 1;
+	std::vector<BenchPath> paths{ BenchPath::Naive, BenchPath::Sorted, BenchPath::Instanced, BenchPath::Indirect };
+	std::string out = "bench.json";
+};
+
+struct Percentiles {
+	double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+};
+
+struct MemoryUsage {
+	uint64_t residentBytes = 0;
+	uint64_t peakResidentBytes = 0;
+	// only known with GL_NVX_gpu_memory_info
+	int64_t gpuUsedKilobytes = -1;
+};
+
+struct PathResult {
+	BenchPath path;
+	Percentiles cpuMs;
+	Percentiles gpuMs;
+	uint32_t gpuSamples = 0;
+	// per frame averages of the profiler counters
+	double drawCalls = 0.0, triangles = 0.0, stateChanges = 0.0, uploadBytes = 0.0;
+	MemoryUsage memory;
+};
+
+struct BenchScene {
+	Mesh* cube;
+	ShaderProgram* plainShader;
+	ShaderProgram* blockShader;
+	std::vector<Material*> materials;
+	std::vector<GameObject*> objects;
+	Registry registry;
+	std::vector<Entity> entities;
+	std::vector<Entity> transparentEntities;
+	float extent;
+};
+
+static const char* pathName(BenchPath path) {
+	switch (path) {
+	case BenchPath::Naive: return "naive";
+	case BenchPath::Sorted: return "sorted";
+	case BenchPath::Instanced: return "instanced";
+	case BenchPath::Indirect: return "indirect";
+	}
+	return "";
+}
+
+static std::vector<BenchPath> parsePaths(const std::string& list) {
+	std::vector<BenchPath> paths;
+	std::stringstream ss(list);
+	std::string name;
+	while (std::getline(ss, name, ',')) {
+		bool found = false;
+		for (BenchPath p : { BenchPath::Naive, BenchPath::Sorted, BenchPath::Instanced, BenchPath::Indirect }) {
+			if (name == pathName(p)) {
+				paths.push_back(p);
+				found = true;
+			}
+		}
+		if (!found) {
+			spdlog::error("Unknown draw path {}, expected naive, sorted, instanced or indirect", name);
+			throw std::runtime_error("Unknown draw path");
+		}
+	}
+	return paths;
+}
+
+static void printUsage() {
+	std::cout <<
+		"usage: renderer_bench [options]\n"
+		"  --objects N        cubes in the scene (10000)\n"
+		"  --materials N      distinct materials (16)\n"
+		"  --transparent F    fraction of blended objects (0.1)\n"
+		"  --frames N         measured frames per path (600)\n"
+		"  --warmup N         frames rendered before measuring (60)\n"
+		"  --size WxH         offscreen framebuffer size (1280x720)\n"
+		"  --seed N           scene layout seed (1)\n"
+		"  --paths LIST       comma separated: naive,sorted,instanced,indirect (all)\n"
+		"  --out PATH         JSON report, - for stdout (bench.json)\n";
+}
+
+static BenchOptions parseOptions(int argc, char** argv) {
+	BenchOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h") {
+			printUsage();
+			std::exit(0);
+		}
+		if (i + 1 >= argc) {
+			spdlog::error("Missing value for {}", arg);
+			throw std::runtime_error("Missing option value");
+		}
+		std::string value = argv[++i];
+
+		if (arg == "--objects") options.objects = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--materials") options.materials = std::max(static_cast<uint32_t>(std::stoul(value)), 1u);
+		else if (arg == "--transparent") options.transparent = std::clamp(std::stof(value), 0.0f, 1.0f);
+		else if (arg == "--frames") options.frames = std::max(static_cast<uint32_t>(std::stoul(value)), 1u);
+		else if (arg == "--warmup") options.warmup = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--seed") options.seed = static_cast<uint32_t>(std::stoul(value));
+		else if (arg == "--paths") options.paths = parsePaths(value);
+		else if (arg == "--out") options.out = value;
+		else if (arg == "--size") {
+			size_t x = value.find('x');
+			if (x == std::string::npos) {
+				spdlog::error("Expected --size WxH, got {}", value);
+				throw std::runtime_error("Bad framebuffer size");
+			}
+			options.size = { std::stoi(value.substr(0, x)), std::stoi(value.substr(x + 1)) };
+		}
+		else {
+			printUsage();
+			spdlog::error("Unknown option {}", arg);
+			throw std::runtime_error("Unknown option");
+		}
+	}
+	return options;
+}
+
+static Mesh* createCubeMesh() {
+	std::vector<Vertex> vertices;
+	for (int i = 0; i < 8; i++) {
+		glm::vec4 position((i & 1) ? 1.0f : 0.0f, (i & 2) ? 1.0f : 0.0f, (i & 4) ? -1.0f : 0.0f, 1.0f);
+		vertices.push_back({ position, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } });
+	}
+
+	// counter-clockwise seen from outside
+	std::vector<uint32_t> indices = {
+		0, 1, 3, 0, 3, 2, // front, z = 0
+		4, 6, 7, 4, 7, 5, // back, z = -1
+		1, 5, 7, 1, 7, 3, // right
+		0, 2, 6, 0, 6, 4, // left
+		2, 3, 7, 2, 7, 6, // top
+		0, 4, 5, 0, 5, 1, // bottom
+	};
+
+	optimizeMesh(vertices, indices);
+	return createMesh(vertices, indices, PrimitiveFormat::Triangles, compactVertexLayout());
+}
+
+static void createScene(BenchScene* scene, const BenchOptions& options, ShaderProgram* instancedShader) {
+	std::mt19937 rng(options.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	scene->cube = createCubeMesh();
+
+	// the first half opaque, the second half blended
+	for (uint32_t blended = 0; blended < 2; blended++) {
+		for (uint32_t i = 0; i < options.materials; i++) {
+			Material* mat = createMaterial(scene->blockShader);
+			mat->color = glm::vec4(unit(rng), unit(rng), unit(rng), blended ? 0.4f : 1.0f);
+			mat->instancedShader = instancedShader;
+			scene->materials.push_back(mat);
+		}
+	}
+
+	// about two units of space per cube
+	scene->extent = std::cbrt(static_cast<float>(std::max(options.objects, 1u))) * 2.0f;
+	std::uniform_real_distribution<float> coord(-scene->extent * 0.5f, scene->extent * 0.5f);
+	std::uniform_int_distribution<uint32_t> pickMaterial(0, options.materials - 1);
+
+	for (uint32_t i = 0; i < options.objects; i++) {
+		bool blended = unit(rng) < options.transparent;
+		Material* mat = scene->materials[pickMaterial(rng) + (blended ? options.materials : 0)];
+
+		Transform transform;
+		transform.position = { coord(rng), coord(rng), coord(rng) };
+		transform.rotation = glm::angleAxis(unit(rng) * 6.2831853f, glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + 0.01f));
+
+		GameObject* go = createGameObject(scene->cube, mat);
+		go->transform = transform;
+		scene->objects.push_back(go);
+
+		Entity e = createEntity(&scene->registry, scene->cube, mat, transform);
+		scene->entities.push_back(e);
+		if (blended) scene->transparentEntities.push_back(e);
+	}
+	updateWorldMatrices(&scene->registry);
+}
+
+static void orbitCamera(Camera* camera, float extent, uint64_t frame) {
+	float angle = static_cast<float>(frame) * ORBIT_SPEED;
+	float radius = extent;
+	camera->position = glm::vec3(std::sin(angle) * radius, extent * 0.25f, std::cos(angle) * radius);
+	camera->lookDirection = glm::angleAxis(-angle, glm::vec3(0.0f, 1.0f, 0.0f));
+	camera->farPlane = extent * 3.0f;
+}
+
+static Percentiles percentiles(std::vector<double> samples) {
+	Percentiles p;
+	if (samples.empty()) return p;
+	std::sort(samples.begin(), samples.end());
+
+	// nearest rank
+	auto rank = [&samples](double q) {
+		size_t i = static_cast<size_t>(std::ceil(q * samples.size()));
+		return samples[std::clamp<size_t>(i, 1, samples.size()) - 1];
+	};
+	double sum = 0.0;
+	for (double s : samples) sum += s;
+	p.mean = sum / samples.size();
+	p.p50 = rank(0.50);
+	p.p95 = rank(0.95);
+	p.p99 = rank(0.99);
+	p.max = samples.back();
+	return p;
+}
+
+static MemoryUsage memoryUsage() {
+	MemoryUsage usage;
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		usage.residentBytes = counters.WorkingSetSize;
+		usage.peakResidentBytes = counters.PeakWorkingSetSize;
+	}
+#else
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		// "VmRSS:     1234 kB"
+		if (line.rfind("VmRSS:", 0) == 0) usage.residentBytes = std::stoull(line.substr(6)) * 1024;
+		else if (line.rfind("VmHWM:", 0) == 0) usage.peakResidentBytes = std::stoull(line.substr(6)) * 1024;
+	}
+#endif
+
+	if (glfwExtensionSupported("GL_NVX_gpu_memory_info")) {
+		GLint total = 0, available = 0;
+		glGetIntegerv(GPU_MEMORY_TOTAL_AVAILABLE_NVX, &total);
+		glGetIntegerv(GPU_MEMORY_CURRENT_AVAILABLE_NVX, &available);
+		usage.gpuUsedKilobytes = static_cast<int64_t>(total) - available;
+	}
+	return usage;
+}
+
+struct BenchRenderer {
+	RenderQueue queue;
+	InstanceBuffer* instances;
+	Culler culler;
+	GpuScene* gpuScene;
+	FrameConstantsBuffer* frameConstants;
+	TransientBuffer* transient;
+};
+
+static void renderPath(BenchRenderer* r, BenchScene* scene, BenchPath path, Camera* camera) {
+	switch (path) {
+	case BenchPath::Naive:
+		renderGameObjects(scene->objects);
+		break;
+	case BenchPath::Sorted:
+	case BenchPath::Instanced:
+		r->queue.instances = path == BenchPath::Instanced ? r->instances : nullptr;
+		renderRegistryQueued(&r->queue, camera, &scene->registry);
+		break;
+	case BenchPath::Indirect:
+		uploadGpuScene(r->gpuScene);
+		cullGpuScene(r->gpuScene, r->culler.frustum);
+		drawGpuScene(r->gpuScene);
+		r->queue.instances = r->instances;
+		clearRenderQueue(&r->queue);
+		submitEntities(&r->queue, camera, &scene->registry, scene->transparentEntities);
+		sortRenderQueue(&r->queue);
+		flushRenderQueue(&r->queue);
+		break;
+	}
+}
+
+static PathResult runPath(GLFWwindow* win, BenchRenderer* r, BenchScene* scene, BenchPath path, const BenchOptions& options) {
+	// the naive path sets the model matrix and colour as plain uniforms, the others bind them from the transient buffer
+	for (Material* mat : scene->materials) mat->shader = path == BenchPath::Naive ? scene->plainShader : scene->blockShader;
+	invalidateStateCache(&glState);
+
+	Camera camera;
+	camera.aspect = static_cast<float>(options.size.x) / options.size.y;
+
+	std::vector<double> cpu, gpu;
+	FrameCounters totals;
+	uint32_t counted = 0;
+	uint64_t firstMeasured = profiler.frameIndex + options.warmup;
+	uint64_t lastMeasured = firstMeasured + options.frames;
+
+	// GPU results arrive a frame late, the extra frames collect the last measured ones
+	uint32_t total = options.warmup + options.frames + PROFILER_QUERY_FRAMES;
+	for (uint32_t i = 0; i < total; i++) {
+		uint64_t frame = profiler.frameIndex;
+		beginProfilerFrame(&profiler);
+		beginStateCacheFrame(&glState);
+		beginInstanceFrame(r->instances);
+		beginTransientFrame(r->transient);
+		uint64_t cpuBegin = profilerNow();
+
+		orbitCamera(&camera, scene->extent, i);
+		updateWorldMatrices(&scene->registry);
+		updateFrameConstants(r->frameConstants, &camera, options.size, i / 60.0, 1.0 / 60.0, frame);
+		r->queue.lodProjectionScale = 0.0f;
+		beginCulling(&r->culler, r->frameConstants->data.viewProjection);
+		{
+			PROFILE_PASS("bench frame");
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+			renderPath(r, scene, path, &camera);
+		}
+
+		endInstanceFrame(r->instances);
+		endTransientFrame(r->transient);
+		uint64_t cpuEnd = profilerNow();
+		endProfilerFrame(&profiler);
+		resetFrameArena(&frameArena);
+		glfwSwapBuffers(win);
+
+		if (frame >= firstMeasured && frame < lastMeasured) cpu.push_back((cpuEnd - cpuBegin) / 1e6);
+
+		// endProfilerFrame completes the frame before the one it ends
+		const ProfilerFrame& done = profiler.last;
+		bool completed = profiler.frameIndex >= 2 && done.index + 2 == profiler.frameIndex;
+		if (completed && done.index >= firstMeasured && done.index < lastMeasured) {
+			for (const GpuScopeResult& g : done.gpu) {
+				if (std::string(g.name) == "bench frame") gpu.push_back(g.gpuNanoseconds / 1e6);
+			}
+			totals.drawCalls += done.counters.drawCalls;
+			totals.triangles += done.counters.triangles;
+			totals.stateChanges += done.counters.stateChanges;
+			totals.uploadBytes += done.counters.uploadBytes;
+			counted++;
+		}
+	}
+	glFinish();
+
+	PathResult result;
+	result.path = path;
+	result.cpuMs = percentiles(cpu);
+	result.gpuMs = percentiles(gpu);
+	result.gpuSamples = static_cast<uint32_t>(gpu.size());
+	if (counted > 0) {
+		result.drawCalls = static_cast<double>(totals.drawCalls) / counted;
+		result.triangles = static_cast<double>(totals.triangles) / counted;
+		result.stateChanges = static_cast<double>(totals.stateChanges) / counted;
+		result.uploadBytes = static_cast<double>(totals.uploadBytes) / counted;
+	}
+	result.memory = memoryUsage();
+
+	spdlog::info("{:>9}: cpu p50 {:.3f} ms p99 {:.3f} ms | gpu p50 {:.3f} ms p99 {:.3f} ms | {:.0f} draws",
+		pathName(path), result.cpuMs.p50, result.cpuMs.p99, result.gpuMs.p50, result.gpuMs.p99, result.drawCalls);
+	return result;
+}
+
+static std::string jsonString(const std::string& s) {
+	std::string out = "\"";
+	for (char c : s) {
+		if (c == '"' || c == '\\') out += '\\';
+		if (static_cast<unsigned char>(c) < 0x20) continue;
+		out += c;
+	}
+	return out + "\"";
+}
+
+static std::string jsonPercentiles(const Percentiles& p) {
+	return fmt::format("{{\"mean\":{:.4f},\"p50\":{:.4f},\"p95\":{:.4f},\"p99\":{:.4f},\"max\":{:.4f}}}", p.mean, p.p50, p.p95, p.p99, p.max);
+}
+
+static std::string benchReport(const BenchOptions& options, const std::vector<PathResult>& results) {
+	std::string s = "{\n";
+	s += fmt::format("\"config\":{{\"objects\":{},\"materials\":{},\"transparent\":{:.3f},\"frames\":{},\"warmup\":{},\"width\":{},\"height\":{},\"seed\":{}}},\n",
+		options.objects, options.materials, options.transparent, options.frames, options.warmup, options.size.x, options.size.y, options.seed);
+	s += fmt::format("\"gl\":{{\"vendor\":{},\"renderer\":{},\"version\":{}}},\n",
+		jsonString(reinterpret_cast<const char*>(glGetString(GL_VENDOR))),
+		jsonString(reinterpret_cast<const char*>(glGetString(GL_RENDERER))),
+		jsonString(reinterpret_cast<const char*>(glGetString(GL_VERSION))));
+	s += "\"paths\":[";
+	for (size_t i = 0; i < results.size(); i++) {
+		const PathResult& r = results[i];
+		s += i == 0 ? "\n" : ",\n";
+		s += fmt::format("{{\"name\":\"{}\",\"cpuMs\":{},\"gpuMs\":{},\"gpuSamples\":{},"
+			"\"drawCalls\":{:.1f},\"triangles\":{:.1f},\"stateChanges\":{:.1f},\"uploadBytes\":{:.1f},"
+			"\"memory\":{{\"residentBytes\":{},\"peakResidentBytes\":{},\"gpuUsedKilobytes\":{}}}}}",
+			pathName(r.path), jsonPercentiles(r.cpuMs), jsonPercentiles(r.gpuMs), r.gpuSamples,
+			r.drawCalls, r.triangles, r.stateChanges, r.uploadBytes,
+			r.memory.residentBytes, r.memory.peakResidentBytes, r.memory.gpuUsedKilobytes >= 0 ? std::to_string(r.memory.gpuUsedKilobytes) : "null");
+	}
+	s += "\n]}\n";
+	return s;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options = parseOptions(argc, argv);
+
+	glfwInit();
+	glfwDefaultWindowHints();
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	// never shown, everything is drawn into the framebuffer below
+	GLFWwindow* win = glfwCreateWindow(64, 64, "renderer_bench", NULL, NULL);
+	if (win == nullptr) {
+		spdlog::error("Failed to create a GL 4.5 context");
+		throw std::runtime_error("Failed to create a GL 4.5 context");
+	}
+	glfwMakeContextCurrent(win);
+	glfwSwapInterval(0);
+
+	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+	enableParallelShaderCompile();
+
+	uint32_t fbo, color, depth;
+	glCreateRenderbuffers(1, &color);
+	glNamedRenderbufferStorage(color, GL_RGBA8, options.size.x, options.size.y);
+	glCreateRenderbuffers(1, &depth);
+	glNamedRenderbufferStorage(depth, GL_DEPTH24_STENCIL8, options.size.x, options.size.y);
+	glCreateFramebuffers(1, &fbo);
+	glNamedFramebufferRenderbuffer(fbo, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glNamedFramebufferRenderbuffer(fbo, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		spdlog::error("Offscreen framebuffer of {}x{} is incomplete", options.size.x, options.size.y);
+		throw std::runtime_error("Offscreen framebuffer is incomplete");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, options.size.x, options.size.y);
+
+	glClearColor(0, 1.0f, 0, 1.0f);
+	setDepthTest(&glState, true);
+	setBlend(&glState, true);
+	setBlendFunc(&glState, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBlendEquation(GL_FUNC_ADD);
+	glCullFace(GL_BACK);
+	setCullFace(&glState, true);
+	glFrontFace(GL_CCW);
+
+	ShaderVariantTable shaderVariants;
+	BenchScene scene;
+	scene.plainShader = requestShaderVariant(&shaderVariants, { "test.glsl" });
+	scene.blockShader = requestShaderVariant(&shaderVariants, { "test.glsl" }, { { "DRAW_CONSTANTS_BLOCK" } });
+	ShaderProgram* spInstanced = requestShaderVariant(&shaderVariants, { "instanced.glsl" });
+	ShaderProgram* spCull = requestShaderProgram({ "cull.glsl" });
+	ShaderProgram* spIndirect = requestShaderVariant(&shaderVariants, { "instanced.glsl" }, { { "INDIRECT_DRAW" } });
+
+	createScene(&scene, options, spInstanced);
+	for (ShaderProgram* p : { scene.plainShader, scene.blockShader, spInstanced, spCull, spIndirect }) finishShaderProgram(p);
+
+	BenchRenderer renderer;
+	renderer.instances = createInstanceBuffer(std::max(1u << 16, options.objects));
+	renderer.queue.culling = &renderer.culler;
+	JobSystem* jobs = createJobSystem();
+	renderer.queue.jobs = jobs;
+	renderer.transient = createTransientBuffer();
+	renderer.queue.transient = renderer.transient;
+	renderer.frameConstants = createFrameConstantsBuffer();
+	renderer.frameConstants->transient = renderer.transient;
+
+	renderer.gpuScene = createGpuScene(spCull, spIndirect);
+	for (Entity e : scene.entities) {
+		Material* mat = materialOf(&scene.registry, e);
+		if (!isTransparent(mat)) addGpuSceneObject(renderer.gpuScene, meshOf(&scene.registry, e), mat, getTransform(&scene.registry, e));
+	}
+
+	spdlog::info("{} objects, {} materials, {:.0f}% blended, {} frames at {}x{} on {}", options.objects, options.materials,
+		options.transparent * 100.0f, options.frames, options.size.x, options.size.y, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+	std::vector<PathResult> results;
+	for (BenchPath path : options.paths) results.push_back(runPath(win, &renderer, &scene, path, options));
+
+	std::string report = benchReport(options, results);
+	if (options.out == "-") std::cout << report;
+	else {
+		std::ofstream out(options.out);
+		if (!out) {
+			spdlog::error("Failed to open {} for the report", options.out);
+			throw std::runtime_error("Failed to open the report");
+		}
+		out << report;
+		spdlog::info("Wrote {}", options.out);
+	}
+
+	destroyJobSystem(jobs);
+	glfwDestroyWindow(win);
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+// mirrors PointLight in clustered_lighting.hpp
+struct GpuLight {
+	vec4 positionRadius; // world space
+	vec4 colorIntensity;
+};
+
+// mirrors ClusterParams in clustered_lighting.hpp
+layout(std140, binding = 2) uniform ClusterParams {
+	uvec4 uClusterGrid;
+	// x: lights, y: capacity of the light index list
+	uvec4 uClusterCounts;
+	// xy: clusters per pixel, z: slices per unit of log view depth, w: slice offset
+	vec4 uClusterScale;
+	// x: near plane, y: far plane, z: 1 / projection[0][0], w: 1 / projection[1][1]
+	vec4 uClusterDepth;
+	vec4 uAmbient;
+};
@@ -0,0 +1,39 @@
+#pragma once
+// fragment side of clustered forward lighting, see ClusteredLighting
+#include "depth_shade.glsl"
+#include "cluster_params.glsl"
+
+layout(std430, binding = 5) readonly buffer Lights { GpuLight lights[]; };
+layout(std430, binding = 6) readonly buffer LightIndices { uint lightIndices[]; };
+layout(std430, binding = 7) readonly buffer LightGrid { uvec2 lightGrid[]; };
+
+uint clusterIndex(vec2 fragCoord, float viewDepth) {
+	uvec2 tile = min(uvec2(fragCoord * uClusterScale.xy), uClusterGrid.xy - 1u);
+	// past the far plane still lands in the last slice
+	float slice = log(max(viewDepth, uClusterDepth.x)) * uClusterScale.z + uClusterScale.w;
+	uint z = min(uint(max(slice, 0.0)), uClusterGrid.z - 1u);
+	return (z * uClusterGrid.y + tile.y) * uClusterGrid.x + tile.x;
+}
+
+// lambert from every light of this fragment's cluster plus the ambient term.
+// `normal` is in world space, meshes without normals pass zero and are shaded faceted
+vec3 shadeClustered(vec3 albedo, vec3 worldPos, vec3 normal) {
+	// derivatives outside the branch, they are undefined in non-uniform control flow
+	vec3 faceted = cross(dFdx(worldPos), dFdy(worldPos));
+	vec3 n = normalize(dot(normal, normal) > 1e-8 ? normal : faceted);
+
+	uvec2 cell = lightGrid[clusterIndex(gl_FragCoord.xy, linearDepth(gl_FragCoord.z))];
+	vec3 lit = uAmbient.rgb;
+	for (uint i = 0; i < cell.y; i++) {
+		GpuLight light = lights[lightIndices[cell.x + i]];
+		vec3 toLight = light.positionRadius.xyz - worldPos;
+		float d2 = dot(toLight, toLight);
+		float r2 = light.positionRadius.w * light.positionRadius.w;
+		// inverse square windowed to reach zero at the radius it was culled with
+		float window = clamp(1.0 - (d2 * d2) / (r2 * r2), 0.0, 1.0);
+		float attenuation = window * window / (d2 + 1.0);
+		float lambert = max(dot(n, toLight * inversesqrt(max(d2, 1e-8))), 0.0);
+		lit += light.colorIntensity.rgb * light.colorIntensity.w * attenuation * lambert;
+	}
+	return albedo * lit;
+}
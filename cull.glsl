@@ -0,0 +1,57 @@
+#type compute
+#version 430 core
+
+layout(local_size_x = 64) in;
+
+#include "gpu_object.glsl"
+
+struct MeshDraw {
+	uint count;
+	uint firstIndex;
+	int baseVertex;
+	uint pad;
+};
+
+struct DrawCommand {
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int baseVertex;
+	uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer Objects { GpuObject objects[]; };
+layout(std430, binding = 1) readonly buffer Draws { MeshDraw draws[]; };
+layout(std430, binding = 2) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 3) buffer Parameters { uint drawCount; };
+
+uniform vec4 uFrustumPlanes[6];
+uniform uint uObjectCount;
+uniform bool uCompact;
+
+void main() {
+	uint i = gl_GlobalInvocationID.x;
+	if (i >= uObjectCount) return;
+
+	vec4 s = objects[i].sphere;
+	bool visible = true;
+	for (int p = 0; p < 6; p++) {
+		if (dot(uFrustumPlanes[p].xyz, s.xyz) + uFrustumPlanes[p].w < -s.w) visible = false;
+	}
+
+	MeshDraw d = draws[objects[i].draw];
+	DrawCommand cmd;
+	cmd.count = d.count;
+	cmd.instanceCount = 1;
+	cmd.firstIndex = d.firstIndex;
+	cmd.baseVertex = d.baseVertex;
+	cmd.baseInstance = i; // the draw shader reads its object through this
+
+	if (uCompact) {
+		if (visible) commands[atomicAdd(drawCount, 1)] = cmd;
+	}
+	else {
+		cmd.instanceCount = visible ? 1 : 0;
+		commands[i] = cmd;
+	}
+}
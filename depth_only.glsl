@@ -0,0 +1,22 @@
+#version 430 core
+/*
+depth pre-pass, reads the geometry pool's position-only stream and the
+instance model matrix. the position is computed exactly as in test.glsl and
+instanced.glsl, all three declare it invariant.
+*/
+
+#type vertex
+#include "frame_constants.glsl"
+
+layout(location = 0) in vec4 inPos;
+layout(location = 4) in mat4 inModel;
+
+invariant gl_Position;
+
+void main() {
+	gl_Position = uViewProjection * inModel * inPos;
+}
+
+#type fragment
+void main() {
+}
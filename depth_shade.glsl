@@ -0,0 +1,18 @@
+#pragma once
+#include "frame_constants.glsl"
+
+// view space distance of a window space depth, for either depth convention
+float linearDepth(float depth) {
+	float nearPlane = uDepthParams.x;
+	// reversed-Z with an infinite far plane stores nearPlane / distance
+	if (uDepthParams.z > 0.0) return nearPlane / max(depth, 1e-7);
+
+	float farPlane = uDepthParams.y;
+	float z = depth * 2.0 - 1.0; // back to NDC
+	return (2.0 * nearPlane * farPlane) / (farPlane + nearPlane - z * (farPlane - nearPlane));
+}
+
+// darkens with distance, the only shading the test scenes have
+vec3 depthShade(vec3 color) {
+	return (1 - linearDepth(gl_FragCoord.z) / 6) * color;
+}
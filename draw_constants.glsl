@@ -0,0 +1,15 @@
+#pragma once
+#ifdef DRAW_CONSTANTS_BLOCK
+// mirrors DrawConstants in frame_constants.hpp, bound by offset into the transient buffer per draw
+layout(std140, binding = 1) uniform DrawConstants {
+	mat4 uModel;
+	vec4 uColor;
+	// LOD cross-fade, > 0 fading in, < 0 fading out, 0 fully drawn
+	float uLodFade;
+};
+#else
+uniform mat4 uModel;
+uniform vec4 uColor;
+// LOD cross-fade, > 0 fading in, < 0 fading out, 0 fully drawn
+uniform float uLodFade;
+#endif
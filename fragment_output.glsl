@@ -0,0 +1,30 @@
+#pragma once
+/*
+variants:
+  OIT_ACCUMULATE  blended colour is accumulated for the order-independent composite, see oit.hpp
+*/
+
+#ifdef OIT_ACCUMULATE
+#include "depth_shade.glsl"
+
+layout(location = 0) out vec4 outAccumulation;
+layout(location = 1) out float outRevealage;
+
+// equation 9 of the paper, nearer and more opaque layers weigh more. view distance works for either depth convention
+float oitWeight(float alpha) {
+	float z = linearDepth(gl_FragCoord.z) / 200.0;
+	return alpha * clamp(0.03 / (1e-5 + z * z * z * z), 1e-2, 3e3);
+}
+
+void writeColor(vec4 color) {
+	float w = oitWeight(color.a);
+	outAccumulation = vec4(color.rgb * color.a, color.a) * w;
+	outRevealage = color.a;
+}
+#else
+layout(location = 0) out vec4 outColor;
+
+void writeColor(vec4 color) {
+	outColor = color;
+}
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+// mirrors FrameConstants in frame_constants.hpp
+layout(std140, binding = 0) uniform FrameConstants {
+	mat4 uView;
+	mat4 uProjection;
+	mat4 uViewProjection;
+	vec4 uCameraPosition;
+	vec4 uTime;
+	// x: near plane, y: far plane, 0 when infinite, z: 1 with reversed-Z
+	vec4 uDepthParams;
+};
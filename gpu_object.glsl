@@ -0,0 +1,10 @@
+#pragma once
+// mirrors GpuObject in gpu_scene.hpp
+struct GpuObject {
+	mat4 model;
+	vec4 color;
+	vec4 sphere;
+	uint draw;
+	uint material;
+	uint pad0, pad1;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "scene_asset.hpp"
+#include "staging_ring.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+constexpr size_t STREAM_STAGING_SIZE = 64ull << 20;
+// bytes copied into the staging ring per pumpAssetStreamer, bounds the upload cost of one frame
+constexpr size_t STREAM_UPLOAD_BUDGET = 8ull << 20;
+
+enum class StreamState : uint8_t {
+	Queued,
+	Reading,
+	Uploading,
+	Resident,
+	Failed
+};
+
+struct MappedFile;
+
+// one in-flight or finished request, owned by the streamer
+struct StreamedScene {
+	std::string path;
+	std::atomic<StreamState> state = StreamState::Queued;
+	// set once state is Resident
+	SceneAsset* asset = nullptr;
+
+	// filled by the worker that read the file
+	MappedFile* file = nullptr;
+	SceneAssetView view{};
+
+	// GL thread only, the destination pool and how many bytes of each blob were copied so far
+	GeometryPool* pool = nullptr;
+	size_t vertexBytesCopied = 0, positionBytesCopied = 0, indexBytesCopied = 0;
+};
+
+/*
+workers map, validate and page in asset files off the main thread.
+pumpAssetStreamer then moves the blobs through the staging ring into
+GL buffers a budget's worth per frame, and publishes an asset as
+Resident only after its last copy has been issued. GL is never called
+from a worker.
+*/
+struct AssetStreamer {
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	// guarded by mutex
+	std::deque<StreamedScene*> requests;
+	std::vector<StreamedScene*> read;
+
+	// GL thread only
+	StagingRing* staging;
+	size_t uploadBudget = STREAM_UPLOAD_BUDGET;
+	std::deque<StreamedScene*> uploads;
+	std::vector<StreamedScene*> all;
+};
+
+AssetStreamer* createAssetStreamer(uint32_t workerCount = 2, size_t stagingSize = STREAM_STAGING_SIZE);
+// joins the workers, waiting for reads in progress, and destroys every scene it streamed.
+// entities instantiated from resident scenes have to be destroyed first
+void destroyAssetStreamer(AssetStreamer* streamer);
+
+// returns immediately, poll state from the returned request
+StreamedScene* streamSceneAsset(AssetStreamer* streamer, const std::string& path);
+// once per frame on the GL thread, retires staging space and issues uploads up to the budget
+void pumpAssetStreamer(AssetStreamer* streamer);
+
+inline bool isResident(const StreamedScene* scene) {
+	return scene->state.load(std::memory_order_acquire) == StreamState::Resident;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "game.hpp"
+#include "frustum.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+constexpr int32_t BVH_NULL = -1;
+
+struct BvhNode {
+	// leaves store their box grown by the tree margin, so small moves need no tree update
+	Aabb fat;
+	Aabb tight;
+	int32_t parent = BVH_NULL; // next free node while on the free list
+	int32_t left = BVH_NULL;
+	int32_t right = BVH_NULL;
+	int32_t height = 0; // 0 for leaves, -1 for free nodes
+	uint32_t value = 0;
+};
+
+/*
+dynamic AABB tree. leaves are inserted where they grow the surface area of
+the tree the least and the tree is kept balanced with AVL style rotations on
+the way back up, so moving a leaf is a remove and insert in O(log n) instead
+of a rebuild.
+*/
+struct Bvh {
+	std::vector<BvhNode> nodes;
+	int32_t root = BVH_NULL;
+	int32_t freeList = BVH_NULL;
+	size_t leafCount = 0;
+	float margin = 0.1f;
+};
+
+struct BvhHit {
+	uint32_t value;
+	float distance;
+};
+
+// returns the leaf id, stable until the leaf is removed
+int32_t insertBvhLeaf(Bvh* bvh, const Aabb& box, uint32_t value);
+void removeBvhLeaf(Bvh* bvh, int32_t leaf);
+// true when the leaf had to be reinserted because it left its fat box
+bool moveBvhLeaf(Bvh* bvh, int32_t leaf, const Aabb& box);
+
+// values of every leaf whose box touches the frustum, appended to `out`
+void queryBvhFrustum(const Bvh* bvh, const Frustum& frustum, std::vector<uint32_t>& out);
+// nearest leaf box along the ray, `direction` need not be normalized but distances are in its units
+bool raycastBvh(const Bvh* bvh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhHit* hit);
+// up to k leaves nearest to `point`, closest first
+void nearestBvh(const Bvh* bvh, const glm::vec3& point, size_t k, std::vector<BvhHit>& out);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "game.hpp"
+#include "transient_buffer.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// froxels: screen tiles along x and y, exponential depth slices between the camera's near and far plane
+constexpr uint32_t CLUSTER_GRID_X = 16;
+constexpr uint32_t CLUSTER_GRID_Y = 9;
+constexpr uint32_t CLUSTER_GRID_Z = 24;
+constexpr uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+// lights one cluster can hold, light_cluster.glsl drops the rest. must match the shader
+constexpr uint32_t CLUSTER_MAX_LIGHTS = 128;
+// sizes the shared light index list, clusters past it in a frame get no lights
+constexpr uint32_t CLUSTER_AVERAGE_LIGHTS = 32;
+
+// the ClusterParams block and the storage buffers of light_cluster.glsl and clustered_lights.glsl
+constexpr uint32_t CLUSTER_PARAMS_BINDING = 2;
+constexpr uint32_t LIGHT_BINDING = 5;
+constexpr uint32_t LIGHT_INDEX_BINDING = 6;
+constexpr uint32_t LIGHT_GRID_BINDING = 7;
+constexpr uint32_t LIGHT_COUNTER_BINDING = 8;
+
+// std430 layout, must match GpuLight in cluster_params.glsl
+struct PointLight {
+	glm::vec3 position; // world space
+	float radius; // the light reaches exactly zero here, and is culled against it
+	glm::vec3 color;
+	float intensity;
+};
+static_assert(sizeof(PointLight) == 32);
+
+// std140 layout, must match the ClusterParams block in cluster_params.glsl
+struct ClusterParams {
+	glm::uvec4 grid; // clusters along x, y and z
+	glm::uvec4 counts; // x: lights, y: capacity of the light index list
+	glm::vec4 scale; // xy: clusters per pixel, z: slices per unit of log view depth, w: slice offset
+	glm::vec4 depth; // x: near plane, y: far plane, z: 1 / projection[0][0], w: 1 / projection[1][1]
+	glm::vec4 ambient;
+};
+
+/*
+clustered forward shading (Olsson, Billeter and Assarsson 2012). every
+frame the lights are uploaded, and one compute invocation per froxel
+tests them all against its view space bounds, a workgroup's worth at a
+time through shared memory. survivors go to one shared index list, each
+cluster keeping an offset and count into it. fragment shaders built with
+CLUSTERED_LIGHTING find their cluster from window position and view depth
+and loop over that list only, so the per-pixel cost follows the lights
+that actually reach the pixel rather than how many exist.
+*/
+struct ClusteredLighting {
+	ShaderProgram* assignProgram;
+	// edited freely between frames, the whole list is uploaded each update
+	std::vector<PointLight> lights;
+	glm::vec3 ambient{ 0.05f, 0.05f, 0.05f };
+
+	// lights and params are bound by offset from here when set, instead of the buffers below
+	TransientBuffer* transient = nullptr;
+	uint32_t lightBuffer;
+	uint32_t lightCapacity;
+	uint32_t paramsBuffer;
+
+	// uvec2 offset and count per cluster, the index list and its atomic fill counter
+	uint32_t gridBuffer;
+	uint32_t indexBuffer;
+	uint32_t counterBuffer;
+	uint32_t indexCapacity;
+	ClusterParams params;
+};
+
+ClusteredLighting* createClusteredLighting(ShaderProgram* assignProgram);
+// after updateFrameConstants, the assignment reads the view matrix from the FrameConstants block.
+// leaves everything the shading variants read bound for the rest of the frame
+void updateClusteredLighting(ClusteredLighting* lighting, Camera* camera, glm::ivec2 framebufferSize);
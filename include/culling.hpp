@@ -0,0 +1,62 @@
+#pragma once
+
+#include "game.hpp"
+#include "frustum.hpp"
+
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// depth readbacks in flight, the CPU only maps one once its fence has signalled
+constexpr uint32_t HIZ_READBACK_FRAMES = 3;
+
+/*
+CPU copy of an earlier frame's depth buffer as a pyramid of farthest depth.
+level 0 is the depth buffer itself, every texel above holds the farthest
+depth of the 2x2 texels below it, so one lookup covers a whole screen rect.
+farthest is the maximum, or the minimum for a reversed-Z capture.
+
+the depth is read back asynchronously and is usually a frame or two old,
+boxes are projected with the view projection it was rendered with.
+*/
+struct HiZBuffer {
+	std::array<uint32_t, HIZ_READBACK_FRAMES> pbos{};
+	std::array<GLsync, HIZ_READBACK_FRAMES> fences{};
+	std::array<glm::ivec2, HIZ_READBACK_FRAMES> sizes{};
+	std::array<glm::mat4, HIZ_READBACK_FRAMES> viewProjections{};
+	std::array<uint64_t, HIZ_READBACK_FRAMES> serials{};
+	std::array<bool, HIZ_READBACK_FRAMES> reversed{};
+	uint32_t next = 0;
+	uint64_t serial = 0;
+
+	std::vector<std::vector<float>> levels;
+	std::vector<glm::ivec2> levelSizes;
+	glm::mat4 viewProjection;
+	bool reversedZ = false;
+	bool valid = false;
+};
+
+HiZBuffer* createHiZBuffer();
+// queues a readback of the bound framebuffer's depth, call once the opaque geometry is drawn
+void captureHiZ(HiZBuffer* hiz, glm::ivec2 size, const glm::mat4& viewProjection, bool reversedZ = false);
+// picks up the newest finished readback and rebuilds the pyramid, never waits on the GPU
+void updateHiZ(HiZBuffer* hiz);
+bool aabbOccluded(const HiZBuffer* hiz, const Aabb& box);
+
+struct CullStats {
+	uint32_t tested = 0;
+	uint32_t frustumRejected = 0;
+	uint32_t occlusionRejected = 0;
+};
+
+struct Culler {
+	Frustum frustum;
+	// boxes hidden behind the previous depth are rejected too when set
+	HiZBuffer* hiz = nullptr;
+	CullStats stats;
+};
+
+void beginCulling(Culler* culler, const glm::mat4& viewProjection, bool reversedZ = false);
+// true when the world space box can be skipped
+bool cullBounds(Culler* culler, const Aabb& box);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// initial block size, the arena grows to a frame's high water mark after an overflow
+constexpr size_t FRAME_ARENA_SIZE = 1ull << 20;
+
+/*
+linear allocator for CPU data that lives for one frame: draw lists, sort
+buffers, candidate lists. allocation is a bump of `used` and nothing is
+freed on its own, resetFrameArena drops everything at once right before
+the swap. what does not fit goes to blocks of its own, freed at the next
+reset, and the main block is then grown so the next frame fits.
+
+GL thread only, memory handed out is invalid after the next reset.
+*/
+struct FrameArena {
+	std::unique_ptr<std::byte[]> block;
+	size_t capacity = 0;
+	size_t used = 0;
+
+	std::vector<std::unique_ptr<std::byte[]>> overflow;
+	// bytes this frame that did not fit into `block`
+	size_t overflowBytes = 0;
+	// the most one frame has used, block and overflow together
+	size_t peak = 0;
+};
+
+extern FrameArena frameArena;
+
+// never nullptr, alignment is a power of two
+void* allocateFrame(FrameArena* arena, size_t size, size_t alignment = alignof(std::max_align_t));
+void resetFrameArena(FrameArena* arena);
+
+// uninitialised, the arena runs no destructors
+template<typename T>
+std::span<T> allocateFrameArray(FrameArena* arena, size_t count) {
+	static_assert(std::is_trivially_destructible_v<T>, "frame arena memory is dropped without destructors");
+	return { static_cast<T*>(allocateFrame(arena, count * sizeof(T), alignof(T))), count };
+}
+
+// lets standard containers live in the arena, freed memory is only reclaimed by the reset
+template<typename T>
+struct FrameAllocator {
+	using value_type = T;
+	FrameArena* arena = &frameArena;
+
+	FrameAllocator() = default;
+	template<typename U>
+	FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t n) { return static_cast<T*>(allocateFrame(arena, n * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	template<typename U>
+	bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+};
+
+// for temporaries that would otherwise be a fresh heap vector every frame
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "game.hpp"
+#include "transient_buffer.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// every program built by createShaderProgram gets its FrameConstants block bound here
+constexpr uint32_t FRAME_CONSTANTS_BINDING = 0;
+// and its DrawConstants block, if it has one, here
+constexpr uint32_t DRAW_CONSTANTS_BINDING = 1;
+
+// std140 layout, must match the FrameConstants block in the shaders
+struct FrameConstants {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 cameraPosition;
+	glm::vec4 time; // x: seconds since start, y: frame delta, z: frame index
+	glm::vec4 depthParams; // x: near plane, y: far plane, 0 when infinite, z: 1 with reversed-Z
+};
+
+// std140 layout, must match the DrawConstants block in draw_constants.glsl
+struct DrawConstants {
+	glm::mat4 model;
+	glm::vec4 color;
+	float lodFade;
+	float pad[3];
+};
+
+struct FrameConstantsBuffer {
+	uint32_t handle;
+	FrameConstants data;
+	// each frame's constants are written here and bound by offset when set, instead of updating `handle` in place
+	TransientBuffer* transient = nullptr;
+};
+
+FrameConstantsBuffer* createFrameConstantsBuffer();
+void updateFrameConstants(FrameConstantsBuffer* buffer, Camera* camera, glm::ivec2 framebufferSize, double time, double delta, uint64_t frame);
+void bindFrameConstants(uint32_t program, const UniformTable* uniforms);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <glm/glm.hpp>
+#include <array>
+
+// planes point inwards, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all six
+struct Frustum {
+	std::array<glm::vec4, 6> planes;
+};
+
+// reversedZ for the infinite projection of Camera::reversedZ, its far plane accepts everything
+Frustum extractFrustum(const glm::mat4& viewProjection, bool reversedZ = false);
+bool sphereInFrustum(const Frustum& frustum, const glm::vec4& sphere);
+// conservative, a box crossing two planes outside a corner of the frustum is kept
+bool aabbInFrustum(const Frustum& frustum, const Aabb& box);
+
+enum class FrustumOverlap {
+	Outside,
+	Intersecting,
+	Inside
+};
+
+FrustumOverlap classifyAabb(const Frustum& frustum, const Aabb& box);
+
+// bounding sphere of `sphere` after `model`, scaled by the largest axis scale
+glm::vec4 transformSphere(const glm::mat4& model, const glm::vec4& sphere);
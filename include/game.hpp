@@ -0,0 +1,221 @@
+#pragma once
+
+#include "uniform_table.hpp"
+#include "geometry_pool.hpp"
+#include "shader_preprocessor.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <array>
+#include <span>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+struct GLFWwindow;
+struct LodChain;
+
+struct Vertex {
+	glm::vec4 position;
+	glm::vec4 color;
+	glm::vec2 textureCoords;
+	glm::vec4 normals;
+};
+
+enum class PrimitiveFormat {
+	Triangles = GL_TRIANGLES,
+	TriangleFan = GL_TRIANGLE_FAN,
+	TriangleStrip = GL_TRIANGLE_STRIP,
+	Lines = GL_LINES,
+	LineStrip = GL_LINE_STRIP
+};
+
+struct Aabb {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+uint32_t nextMeshSortId();
+
+struct Mesh {
+	// CPU copies for picking or physics, empty unless the mesh was created with retainCpuData
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	PrimitiveFormat primitiveFormat;
+
+	// the pool VAO, shared by every mesh suballocated from the same pool and layout
+	const VertexLayout* layout;
+	uint32_t vao;
+	GeometryPool* pool;
+	uint32_t baseVertex, firstIndex, indexCount;
+
+	// local space, sphere is xyz center and w radius
+	glm::vec4 boundingSphere;
+	Aabb bounds;
+
+	// meshes share a VAO now, so the render queue groups on this instead
+	uint32_t sortId = nextMeshSortId();
+
+	// buffer the per-instance attributes of `vao` read from, 0 until instanced once
+	uint32_t instanceBuffer = 0;
+};
+
+struct TextureSource;
+
+struct Texture {
+	uint32_t handle;
+
+	// of the full resolution level, even while only coarser levels are resident
+	glm::ivec2 size;
+
+	GLenum internalFormat = GL_RGBA8;
+	uint32_t levelCount = 1;
+	// the storage holds levels residentLevel..levelCount-1, GL level 0 of `handle` is residentLevel
+	uint32_t residentLevel = 0;
+	// where missing levels are streamed from, nullptr for textures that are fully resident for good
+	TextureSource* source = nullptr;
+
+	// resident bindless handle, and the texture object it was created for
+	uint64_t bindlessHandle = 0;
+	uint32_t bindlessOf = 0;
+};
+
+// locations the engine itself writes every draw, resolved once at link time
+struct BuiltinUniforms {
+	int32_t color = -1;
+	int32_t model = -1;
+	int32_t lodFade = -1;
+	// the three above come from a DrawConstants block bound per draw instead when true
+	bool drawConstants = false;
+};
+
+struct PendingProgram;
+
+struct ShaderProgram {
+	uint32_t handle;
+	UniformTable uniforms;
+	BuiltinUniforms builtins;
+	// vertex attribute locations the program reads, see reflectVertexInputs
+	uint32_t vertexInputs = 0;
+	// set while the driver is still compiling and linking, uniforms and builtins are empty until then
+	PendingProgram* pending = nullptr;
+	// files and defines it was built from, see shaderVariantKey
+	uint64_t variantKey = 0;
+};
+
+// programs by variant key, so every permutation is built once however often it is asked for
+struct ShaderVariantTable {
+	std::unordered_map<uint64_t, ShaderProgram*> programs;
+};
+
+uint32_t nextMaterialSortId();
+
+struct Material {
+	ShaderProgram* shader;
+	// variant reading model and color per instance, batches of this material are not instanced without it
+	ShaderProgram* instancedShader = nullptr;
+	// instanced variant reading everything else from the material table, see MaterialTable
+	ShaderProgram* bindlessShader = nullptr;
+	// OIT_ACCUMULATE variants of shader and instancedShader. blended draws of a queue with an OitTarget skip the depth sort with them
+	ShaderProgram* oitShader = nullptr;
+	ShaderProgram* oitInstancedShader = nullptr;
+	std::array<Texture*, 32> textures;
+	glm::vec4 color;
+
+	// dense id used to group draws by material in the render queue sort key
+	uint32_t sortId = nextMaterialSortId();
+};
+
+struct MeshRenderer {
+	Mesh* mesh;
+	Material* material;
+	// simplified versions of `mesh`, picked per draw from screen size when set
+	const LodChain* lods = nullptr;
+};
+
+struct Transform {
+	glm::vec3 position{0.0f, 0.0f, 0.0f};
+	glm::fquat rotation = glm::quat_identity<float, glm::packed_highp>();
+	glm::vec3 scale{1.0f, 1.0f, 1.0f};
+};
+
+struct GameObject {
+	MeshRenderer meshRenderer;
+	Transform transform;
+};
+
+struct Camera {
+	glm::vec3 position;
+	glm::fquat lookDirection = glm::angleAxis(0.f, glm::vec3(0.f,0.f,1.f));
+
+	float fov = 90.0f; // vertical, degrees
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+	float aspect = 1.0f;
+	// depth 1 at the near plane falling to 0 at infinity, farPlane is then only used for sort keys. see applyDepthConvention
+	bool reversedZ = false;
+};
+
+std::string readFile(std::string name);
+uint32_t createShader(std::string path);
+// blocks until linked, from the program binary cache when it has a match
+// files go through preprocessShader, a file may hold several stages
+ShaderProgram* createShaderProgram(std::initializer_list<std::string> files, std::initializer_list<ShaderDefine> defines = {});
+// starts compiling and returns right away, request many programs before completing any so the driver overlaps them
+ShaderProgram* requestShaderProgram(std::initializer_list<std::string> files, std::initializer_list<ShaderDefine> defines = {});
+ShaderProgram* requestShaderVariant(ShaderVariantTable* table, std::initializer_list<std::string> files, std::initializer_list<ShaderDefine> defines = {});
+// completes the program once the driver is done with it, never blocks while parallel compile is enabled
+bool pollShaderProgram(ShaderProgram* program);
+void finishShaderProgram(ShaderProgram* program);
+// deletes the GL program, and its shaders while it is still pending
+void destroyShaderProgram(ShaderProgram* program);
+// destroys every program in the table and empties it
+void destroyShaderVariants(ShaderVariantTable* table);
+
+Aabb computeBounds(std::span<const Vertex> vertices);
+glm::vec4 computeBoundingSphere(std::span<const Vertex> vertices);
+// vertices are converted to `layout` on upload. only the GPU copy, index count and bounds are kept,
+// unless retainCpuData copies the authoring data onto the mesh
+Mesh* createMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, PrimitiveFormat fmt, const VertexLayout& layout = fullVertexLayout(), bool retainCpuData = false);
+// same, but retained data is moved in instead of copied
+Mesh* createMesh(std::vector<Vertex>&& vertices, std::vector<uint32_t>&& indices, PrimitiveFormat fmt, const VertexLayout& layout = fullVertexLayout(), bool retainCpuData = false);
+
+// a blank mesh for geometry that reached its pool another way, like a scene asset's
+Mesh* allocateMesh();
+// the vertex and index ranges stay allocated, geometry pools only grow
+void destroyMesh(Mesh* mesh);
+
+Material* createMaterial(ShaderProgram* shader = nullptr);
+// a MaterialTable keeps pointers to what was registered with it, destroy those only with the table
+void destroyMaterial(Material* mat);
+
+GameObject* createGameObject(Mesh* mesh, Material* material);
+void destroyGameObject(GameObject* go);
+
+glm::mat4 composeTRS(const glm::vec3& translation, const glm::fquat& rotation, const glm::vec3& scale);
+// smallest axis aligned box around the transformed box
+Aabb transformAabb(const glm::mat4& model, const Aabb& box);
+glm::mat4 createModelMatrix(const Transform& transform);
+glm::mat4 createModelMatrix(const Transform* transform);
+glm::mat4 calcViewMatrix(Camera* camera);
+glm::mat4 calcProjectionMatrix(Camera* camera);
+glm::mat4 calcVPMatrix(Camera* camera);
+// clip control, depth clear value and depth compare for cameras with or without reversedZ.
+// reversed-Z needs a float depth buffer to gain anything, the default framebuffer is fixed point
+void applyDepthConvention(bool reversedZ);
+
+bool isTransparent(const Material* mat);
+
+void applyMaterial(Material* mat);
+void applyMaterial(Material* mat, ShaderProgram* program);
+void applyTransform(ShaderProgram* shader, const Transform& transform);
+void applyTransform(ShaderProgram* shader, const glm::mat4& model);
+void drawMesh(Mesh* mesh);
+
+void renderGameObject(GameObject* go);
+void renderGameObjects(std::vector<GameObject*> objs);
+
+void updateCamera(GLFWwindow* win, Camera* camera);
+
+float dist(Camera* cam, const GameObject* go);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "vertex_layout.hpp"
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+shared vertex and index buffers that every mesh is suballocated from.
+all meshes in a pool share one VAO, so switching meshes is just a change
+of firstIndex/baseVertex, and the pool can be drawn with multi-draw indirect.
+
+positions are kept a second time on their own, tightly packed, for depth
+only passes that would otherwise fetch whole vertices to use 12 bytes.
+depthVao reads them with the same indices and base vertices.
+*/
+struct GeometryPool {
+	uint32_t vao;
+	uint32_t vbo, ibo;
+	const VertexLayout* layout;
+	uint32_t vertexStride;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, indices are local to each mesh since draws pass baseVertex
+	GLenum indexType;
+	uint32_t indexSize;
+
+	uint32_t vertexCapacity, indexCapacity;
+	uint32_t vertexCount = 0, indexCount = 0;
+
+	// the layout's position attribute alone, in its format
+	const VertexLayout* positionLayout;
+	uint32_t positionVbo;
+	uint32_t depthVao;
+	// the instance buffer attached to depthVao, see attachDepthInstanceBuffer
+	uint32_t depthInstanceBuffer = 0;
+};
+
+struct GeometryAllocation {
+	uint32_t baseVertex;
+	uint32_t firstIndex;
+};
+
+GeometryPool* createGeometryPool(const VertexLayout& layout, GLenum indexType, uint32_t vertexCapacity, uint32_t indexCapacity);
+// a full pool whose buffers are created straight from `vertices`, `positions` and `indices`, already in the pool format
+GeometryPool* createGeometryPool(const VertexLayout& layout, GLenum indexType, const void* vertices, const void* positions, uint32_t vertexCount, const void* indices, uint32_t indexCount);
+// only for pools of our own, after their meshes. the shared pools live as long as the context
+void destroyGeometryPool(GeometryPool* pool);
+// one pool per vertex layout and index type, created on first use
+GeometryPool* geometryPoolFor(const VertexLayout& layout, GLenum indexType = GL_UNSIGNED_INT);
+// the pool for fullVertexLayout and 32 bit indices
+GeometryPool* sharedGeometryPool();
+// 16 bit indices whenever every index of the mesh fits
+GLenum selectIndexType(uint32_t vertexCount);
+
+// grows the buffers when needed, the pool VAO stays the same object
+GeometryAllocation allocateGeometry(GeometryPool* pool, uint32_t vertexCount, uint32_t indexCount);
+// indices are narrowed to the pool's index type
+void uploadGeometry(GeometryPool* pool, GeometryAllocation alloc, const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+// fills the position stream from vertices in the pool format, for vertex data that reached `vbo` another way
+void uploadPositionStream(GeometryPool* pool, uint32_t baseVertex, const void* vertices, uint32_t vertexCount);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <spdlog/logger.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+// queued messages, new ones are dropped and counted while the ring is full. a power of two
+constexpr uint32_t GL_DEBUG_RING_SIZE = 1024;
+// longer message text is cut off in the ring
+constexpr size_t GL_DEBUG_MESSAGE_LENGTH = 256;
+// seconds between reports of how often an already logged message came back
+constexpr double GL_DEBUG_REPEAT_INTERVAL = 5.0;
+
+struct GlDebugMessage {
+	GLenum source;
+	GLenum type;
+	GLenum severity;
+	uint32_t id;
+	std::array<char, GL_DEBUG_MESSAGE_LENGTH> text;
+};
+
+struct GlDebugSlot {
+	// equal to the write position once the slot is free for it, one past it once the message is in
+	std::atomic<uint32_t> sequence;
+	GlDebugMessage message;
+};
+
+// how often a message of one source, type and id has been seen, only the first is logged in full
+struct GlDebugRepeat {
+	uint64_t count = 0;
+	uint64_t reported = 0;
+	GLenum source, type, severity;
+};
+
+/*
+in async mode the driver may call back from any of its threads, the
+callback only copies the message into a bounded multi-producer ring and
+returns. pumpGlDebugOutput drains it on the GL thread once a frame, drops
+ignored ids, counts repeats and hands what is left to an spdlog async
+logger, so no GL call waits on console output.
+
+sync mode turns GL_DEBUG_OUTPUT_SYNCHRONOUS back on and logs from inside
+the callback, on the thread and in the call that raised the message, for
+breaking on it in a debugger.
+*/
+struct GlDebugOutput {
+	std::array<GlDebugSlot, GL_DEBUG_RING_SIZE> ring;
+	std::atomic<uint32_t> writePosition{ 0 };
+	uint32_t readPosition = 0;
+	std::atomic<uint64_t> dropped{ 0 };
+
+	// read by the callback on any thread, only handled in place on the GL thread
+	std::atomic<bool> synchronous{ false };
+	std::thread::id glThread;
+	std::unordered_set<uint32_t> ignoredIds;
+	std::unordered_map<uint64_t, GlDebugRepeat> repeats;
+	uint64_t lastRepeatReport = 0;
+
+	// both write to the same console sink
+	std::shared_ptr<spdlog::logger> syncLogger;
+	std::shared_ptr<spdlog::logger> asyncLogger;
+};
+
+// nullptr when the context was not created with GLFW_OPENGL_DEBUG_CONTEXT
+GlDebugOutput* createGlDebugOutput(bool synchronous = false);
+void destroyGlDebugOutput(GlDebugOutput* output);
+
+// drains whatever is still queued before switching
+void setGlDebugSynchronous(GlDebugOutput* output, bool synchronous);
+// messages with this id are neither logged nor counted, from any source
+void ignoreGlDebugMessage(GlDebugOutput* output, uint32_t id);
+
+// GL thread, once a frame. GL_DEBUG_TYPE_PERFORMANCE messages are added to the profiler's frame counters
+void pumpGlDebugOutput(GlDebugOutput* output);
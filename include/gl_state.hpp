@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include <cstdint>
+
+struct Material;
+
+constexpr uint32_t MAX_TEXTURE_UNITS = 32;
+
+// marks a cached value as unknown so the next set always reaches GL
+constexpr uint32_t GL_STATE_UNKNOWN = 0xFFFFFFFF;
+
+struct GLStateCounters {
+	uint64_t issued = 0;
+	uint64_t skipped = 0;
+};
+
+struct GLStateCache {
+	uint32_t program = GL_STATE_UNKNOWN;
+	uint32_t vao = GL_STATE_UNKNOWN;
+	std::array<uint32_t, MAX_TEXTURE_UNITS> textures;
+
+	uint32_t blend = GL_STATE_UNKNOWN;
+	uint32_t blendSrc = GL_STATE_UNKNOWN;
+	uint32_t blendDst = GL_STATE_UNKNOWN;
+	uint32_t depthTest = GL_STATE_UNKNOWN;
+	uint32_t depthWrite = GL_STATE_UNKNOWN;
+	uint32_t depthFunc = GL_STATE_UNKNOWN;
+	uint32_t cullFace = GL_STATE_UNKNOWN;
+
+	// material whose uniforms are currently loaded into `program`
+	const Material* material = nullptr;
+
+	GLStateCounters counters;
+
+	GLStateCache() { textures.fill(GL_STATE_UNKNOWN); }
+};
+
+extern GLStateCache glState;
+
+// forget everything, for use after code that touches GL state directly
+void invalidateStateCache(GLStateCache* cache);
+// reset the counters and uniform tracking, material values may have been edited since last frame
+void beginStateCacheFrame(GLStateCache* cache);
+
+bool bindProgram(GLStateCache* cache, uint32_t program);
+bool bindVertexArray(GLStateCache* cache, uint32_t vao);
+bool bindTexture(GLStateCache* cache, uint32_t unit, uint32_t texture);
+// call before deleting a texture, so a recycled name is not mistaken for the deleted one
+void forgetTexture(GLStateCache* cache, uint32_t texture);
+
+bool setBlend(GLStateCache* cache, bool enabled);
+bool setBlendFunc(GLStateCache* cache, GLenum src, GLenum dst);
+bool setDepthTest(GLStateCache* cache, bool enabled);
+bool setDepthWrite(GLStateCache* cache, bool enabled);
+bool setDepthFunc(GLStateCache* cache, GLenum func);
+bool setCullFace(GLStateCache* cache, bool enabled);
+
+// returns true when `mat` still has to be uploaded to the bound program, and records it as uploaded
+bool needsMaterialUpload(GLStateCache* cache, const Material* mat);
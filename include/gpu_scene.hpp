@@ -0,0 +1,83 @@
+#pragma once
+
+#include "game.hpp"
+#include "frustum.hpp"
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+// shader storage bindings used by the cull compute shader and the indirect draw shaders
+constexpr uint32_t GPU_SCENE_OBJECT_BINDING = 0;
+constexpr uint32_t GPU_SCENE_DRAW_BINDING = 1;
+constexpr uint32_t GPU_SCENE_COMMAND_BINDING = 2;
+constexpr uint32_t GPU_SCENE_PARAMETER_BINDING = 3;
+
+// vertex binding and location carrying the object index, fed through baseInstance
+constexpr uint32_t GPU_SCENE_OBJECT_ID_BINDING = 2;
+constexpr uint32_t GPU_SCENE_OBJECT_ID_ATTRIB = 9;
+
+constexpr uint32_t GPU_CULL_GROUP_SIZE = 64;
+
+// std430, mirrored in gpu_object.glsl
+struct GpuObject {
+	glm::mat4 model;
+	glm::vec4 color;
+	glm::vec4 sphere; // world space
+	uint32_t draw;
+	// index into the material table, for draw shaders that read it
+	uint32_t material;
+	uint32_t pad[2];
+};
+
+struct GpuMeshDraw {
+	uint32_t count;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t pad;
+};
+
+struct DrawElementsIndirectCommand {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+/*
+a static set of opaque objects drawn entirely from GPU-built commands.
+the cull shader tests every object against the frustum and appends a
+command for each visible one, the scene is then drawn with a single
+multi-draw. every object has to live in the same geometry pool.
+*/
+struct GpuScene {
+	GeometryPool* geometry = nullptr;
+	ShaderProgram* cullProgram;
+	ShaderProgram* drawProgram;
+
+	std::vector<GpuObject> objects;
+	std::vector<GpuMeshDraw> draws;
+	std::vector<const Mesh*> drawMeshes;
+	std::unordered_map<const Mesh*, uint32_t> drawIndex;
+
+	// own VAO so the object id attribute never reaches the pool VAO used by other paths
+	uint32_t vao = 0;
+	uint32_t boundVbo = 0, boundIbo = 0;
+
+	uint32_t objectBuffer = 0, drawBuffer = 0, commandBuffer = 0, parameterBuffer = 0, objectIdBuffer = 0;
+	uint32_t capacity = 0, drawCapacity = 0;
+	bool dirty = true;
+
+	// glMultiDrawElementsIndirectCount is GL 4.6, without it culled commands are written with zero instances
+	bool compact = false;
+};
+
+GpuScene* createGpuScene(ShaderProgram* cullProgram, ShaderProgram* drawProgram);
+uint32_t addGpuSceneObject(GpuScene* scene, Mesh* mesh, Material* material, const Transform& transform);
+void updateGpuSceneObject(GpuScene* scene, uint32_t index, const Transform& transform);
+
+void uploadGpuScene(GpuScene* scene);
+void cullGpuScene(GpuScene* scene, const Frustum& frustum);
+void drawGpuScene(GpuScene* scene);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+
+// attribute locations the instanced shader variants read per-instance data from
+constexpr uint32_t INSTANCE_BINDING = 1;
+constexpr uint32_t INSTANCE_ATTRIB_MODEL = 4; // occupies 4 consecutive locations
+constexpr uint32_t INSTANCE_ATTRIB_COLOR = 8;
+// location 9 is the GPU scene's object id
+constexpr uint32_t INSTANCE_ATTRIB_MATERIAL = 10;
+
+// frames the CPU can run ahead of the GPU before a region is reused
+constexpr uint32_t INSTANCE_BUFFER_FRAMES = 3;
+
+// runs shorter than this are drawn one object at a time
+constexpr uint32_t INSTANCING_MIN_BATCH = 2;
+
+struct InstanceData {
+	glm::mat4 model;
+	glm::vec4 color;
+	// material table index, read by the bindless shaders only
+	uint32_t material;
+	uint32_t pad[3];
+};
+
+/*
+persistently mapped ring split into one region per frame in flight.
+a region is only written again after the fence placed at the end of
+the frame that used it has signalled.
+*/
+struct InstanceBuffer {
+	uint32_t handle;
+	InstanceData* mapped;
+	uint32_t capacity; // instances per region
+
+	uint32_t region = 0;
+	uint32_t used = 0;
+	std::array<GLsync, INSTANCE_BUFFER_FRAMES> fences{};
+};
+
+struct InstanceAllocation {
+	InstanceData* data;
+	uint32_t baseInstance;
+};
+
+InstanceBuffer* createInstanceBuffer(uint32_t capacity);
+void beginInstanceFrame(InstanceBuffer* buffer);
+void endInstanceFrame(InstanceBuffer* buffer);
+// data is nullptr when the region is full
+InstanceAllocation allocateInstances(InstanceBuffer* buffer, uint32_t count);
+
+// enables the per-instance attributes on the mesh VAO and points them at `buffer`
+void attachInstanceBuffer(Mesh* mesh, InstanceBuffer* buffer);
+// the same for the pool's position-only VAO, which only reads the model matrix
+void attachDepthInstanceBuffer(GeometryPool* pool, InstanceBuffer* buffer);
+void drawMeshInstanced(Mesh* mesh, uint32_t count, uint32_t baseInstance);
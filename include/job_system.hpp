@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// chunks handed out per thread by parallelFor, more than one so a slow chunk can be balanced by stealing
+constexpr size_t JOB_CHUNKS_PER_THREAD = 4;
+
+// jobs still running under this counter, a job may add more to it before it finishes
+struct JobCounter {
+	std::atomic<uint32_t> pending = 0;
+};
+
+struct Job {
+	std::function<void()> run;
+	JobCounter* counter;
+};
+
+struct JobQueue {
+	std::mutex mutex;
+	std::deque<Job> jobs;
+};
+
+/*
+work stealing pool. every thread owns a queue, it pushes and pops its own
+jobs at the back and steals from the front of the others when it runs dry.
+thread 0 is the one that created the system, it only runs jobs while it
+waits on a counter, so nothing runs behind the GL thread's back. jobs must
+not call GL, they record into per-thread lists the GL thread replays.
+*/
+struct JobSystem {
+	std::vector<std::thread> workers;
+	// indexed by job thread, see jobThreadIndex
+	std::vector<std::unique_ptr<JobQueue>> queues;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	std::atomic<uint32_t> queued = 0;
+};
+
+// 0 picks one worker per hardware thread besides the calling one
+JobSystem* createJobSystem(uint32_t workerCount = 0);
+// joins the workers, queued jobs are dropped
+void destroyJobSystem(JobSystem* jobs);
+
+// worker threads and the creating thread
+uint32_t jobThreadCount(const JobSystem* jobs);
+// 0 on the creating thread, and on any thread outside the system
+uint32_t jobThreadIndex();
+
+void runJob(JobSystem* jobs, JobCounter* counter, std::function<void()> job);
+// runs other jobs on the calling thread until the counter drains
+void waitForJobs(JobSystem* jobs, JobCounter* counter);
+
+// splits [0, count) into chunks of at least `grain` and waits for all of them. fn(begin, end, thread),
+// where thread is the jobThreadIndex running the chunk. runs inline when `jobs` is nullptr
+void parallelFor(JobSystem* jobs, size_t count, size_t grain, const std::function<void(size_t, size_t, uint32_t)>& fn);
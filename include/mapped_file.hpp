@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// read-only view of a whole file, pages are faulted in by the OS as they are touched
+struct MappedFile {
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+MappedFile* mapFile(const std::string& path);
+void unmapFile(MappedFile* file);
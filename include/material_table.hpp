@@ -0,0 +1,45 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// shader storage binding of the Materials block, after the GPU scene's bindings
+constexpr uint32_t MATERIAL_TABLE_BINDING = 4;
+// texture units the bindless shaders can reach through the table
+constexpr uint32_t MATERIAL_TABLE_TEXTURES = 4;
+
+// std430, mirrored in instanced.glsl. a zero handle is an empty slot
+struct GpuMaterial {
+	glm::vec4 color;
+	uint64_t textures[MATERIAL_TABLE_TEXTURES];
+};
+
+static_assert(sizeof(GpuMaterial) == 48);
+
+/*
+every registered material at the index of its sortId, with bindless handles
+for its first MATERIAL_TABLE_TEXTURES textures. shaders reading the table get
+the material index per instance, so one instanced draw can cover objects of
+different materials and nothing is bound or uploaded when the material changes.
+*/
+struct MaterialTable {
+	uint32_t buffer = 0;
+	uint32_t capacity = 0;
+	std::vector<GpuMaterial> data;
+	// indexed by sortId, nullptr for ids never registered
+	std::vector<const Material*> materials;
+	bool dirty = true;
+};
+
+// GL_ARB_bindless_texture, the table is pointless without it
+bool bindlessTexturesSupported();
+
+MaterialTable* createMaterialTable();
+void registerMaterial(MaterialTable* table, const Material* material);
+bool isRegistered(const MaterialTable* table, const Material* material);
+// picks up edited colors and textures, and new handles of textures whose storage the streamer replaced
+void uploadMaterialTable(MaterialTable* table);
+void bindMaterialTable(const MaterialTable* table);
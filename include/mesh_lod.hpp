@@ -0,0 +1,47 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+// a level is used once its simplification error projects to at most this many pixels
+constexpr float LOD_PIXEL_ERROR = 1.0f;
+// fraction of the switch distance over which a level dithers into the next one
+constexpr float LOD_FADE_BAND = 0.1f;
+
+struct LodLevel {
+	Mesh* mesh;
+	// object space, how far the level may deviate from the full detail surface
+	float error;
+};
+
+// level 0 is the full detail mesh, errors grow with the level
+struct LodChain {
+	std::vector<LodLevel> levels;
+};
+
+/*
+quadric error edge collapse (Garland and Heckbert), every collapse moves one
+vertex onto a neighbour so the result indexes the input vertices. edges on
+open borders and attribute seams are locked, and collapses that would flip
+a triangle are skipped. stops at targetIndexCount or when nothing can go.
+*/
+std::vector<uint32_t> simplifyMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float* error = nullptr);
+
+// each level keeps about `ratio` of the previous one's triangles, stops early once simplification stalls
+LodChain* generateLodChain(std::span<const Vertex> vertices, std::span<const uint32_t> indices, const VertexLayout& layout = fullVertexLayout(), uint32_t maxLevels = 4, float ratio = 0.5f);
+
+// pixels one world unit covers at distance one
+float lodProjectionScale(const Camera* camera, float viewportHeight);
+
+struct LodSelection {
+	uint32_t level;
+	// equal to level unless the object is in a fade band, then both are drawn dithered
+	uint32_t next;
+	float fade;
+};
+
+// `scale` is the model's largest axis scale, `distance` is to the nearest point of the bounding sphere
+LodSelection selectLod(const LodChain* chain, float distance, float scale, float projectionScale);
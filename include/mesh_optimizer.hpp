@@ -0,0 +1,29 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <vector>
+#include <cstdint>
+
+// post-transform cache size the reordering targets, conservative for current GPUs
+constexpr uint32_t MESH_VERTEX_CACHE_SIZE = 16;
+
+/*
+triangle list preprocessing, run on the authoring data before createMesh:
+
+	deduplicateVertices   merge bitwise identical vertices
+	optimizeVertexCache   Tipsify, reorders triangles for post-transform cache hits
+	optimizeOverdraw      sorts the cache-friendly clusters outside-in
+	optimizeVertexFetch   renumbers vertices in first-use order, drops unused ones
+
+optimizeMesh runs all four in that order.
+*/
+void deduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+// `clusters` receives the first index of every run that starts after a cache flush
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>* clusters = nullptr);
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters);
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// transformed vertices per triangle with a FIFO cache, 0.5 is ideal and 3 is no reuse
+float averageCacheMissRatio(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = MESH_VERTEX_CACHE_SIZE);
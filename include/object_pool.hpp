@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+// objects per chunk, a pool grows by whole chunks and never gives memory back
+constexpr uint32_t OBJECT_POOL_CHUNK = 256;
+
+/*
+fixed size slots for one type of long-lived engine object. slots live in
+chunks that never move, so pointers stay valid, and a freed slot goes on an
+intrusive free list and is the next one handed out. compared to a bare new
+per object this keeps objects of a type together and makes create/destroy
+churn a push and a pop.
+
+not thread safe, the engine's creation functions run on the GL thread.
+*/
+template<typename T>
+struct ObjectPool {
+	union Slot {
+		Slot* next;
+		alignas(T) std::byte storage[sizeof(T)];
+	};
+
+	std::vector<std::unique_ptr<Slot[]>> chunks;
+	Slot* freeList = nullptr;
+	uint32_t live = 0;
+};
+
+// value-initialised like `new T()`
+template<typename T>
+T* allocateObject(ObjectPool<T>* pool) {
+	using Slot = typename ObjectPool<T>::Slot;
+	if (pool->freeList == nullptr) {
+		Slot* chunk = pool->chunks.emplace_back(new Slot[OBJECT_POOL_CHUNK]).get();
+		// linked back to front so slots are handed out in address order
+		for (uint32_t i = OBJECT_POOL_CHUNK; i-- > 0;) {
+			chunk[i].next = pool->freeList;
+			pool->freeList = &chunk[i];
+		}
+	}
+
+	Slot* slot = pool->freeList;
+	pool->freeList = slot->next;
+	pool->live++;
+	return new (slot->storage) T();
+}
+
+// `object` has to come from this pool, nullptr is ignored
+template<typename T>
+void freeObject(ObjectPool<T>* pool, T* object) {
+	if (object == nullptr) return;
+	using Slot = typename ObjectPool<T>::Slot;
+	object->~T();
+	Slot* slot = reinterpret_cast<Slot*>(object);
+	slot->next = pool->freeList;
+	pool->freeList = slot;
+	pool->live--;
+}
+
+template<typename T>
+size_t objectPoolCapacity(const ObjectPool<T>* pool) {
+	return pool->chunks.size() * OBJECT_POOL_CHUNK;
+}
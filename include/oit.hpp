@@ -0,0 +1,53 @@
+#pragma once
+
+#include "game.hpp"
+#include "render_target.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// texture units the composite program reads the accumulation targets from, see oit_composite.glsl
+constexpr uint32_t OIT_ACCUMULATION_UNIT = 0;
+constexpr uint32_t OIT_REVEALAGE_UNIT = 1;
+
+/*
+weighted blended order-independent transparency (McGuire and Bavoil 2013).
+blended draws add premultiplied, depth weighted colour into `accumulation`
+and multiply their coverage out of `revealage`, in any order, tested
+against the target's depth. an offscreen target's depth is attached as is,
+the window's can't be and is copied. the composite then lays the weighted
+average over the target in one fullscreen pass.
+
+the result is exact for one layer and an approximation for several, good
+enough for glass, particles and foliage but not for layers of very
+different opacity.
+*/
+struct OitTarget {
+	uint32_t framebuffer = 0;
+	// RGBA16F, premultiplied colour times weight and coverage times weight
+	uint32_t accumulation = 0;
+	// R8, the product of (1 - alpha) of every layer
+	uint32_t revealage = 0;
+	// the copy of the window's depth in `depthFormat`, which has to match it, depth blits do not convert. only made for the window
+	uint32_t depth = 0;
+	GLenum depthFormat;
+	// the depth buffer on the framebuffer's depth attachment, `depth` or the target's
+	uint32_t attachedDepth = 0;
+	glm::ivec2 size{ 0, 0 };
+
+	// composited into and its depth tested against, the window when null. has the same size
+	RenderTarget* target = nullptr;
+	ShaderProgram* compositeProgram;
+	// the composite triangle comes from gl_VertexID, core profiles still need a VAO bound
+	uint32_t vao;
+};
+
+// GL_DEPTH24_STENCIL8 is the format of the default framebuffer
+OitTarget* createOitTarget(ShaderProgram* compositeProgram, GLenum depthFormat = GL_DEPTH24_STENCIL8);
+// reallocates the targets when `size` differs from the last call, and has to follow every resize of `target`
+void resizeOitTarget(OitTarget* oit, glm::ivec2 size);
+
+// attaches or copies the target's depth, clears and binds the accumulation targets with their blend functions
+void beginOitAccumulation(OitTarget* oit);
+// binds the target again and blends the accumulated layers over it
+void resolveOit(OitTarget* oit);
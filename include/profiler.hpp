@@ -0,0 +1,148 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// sets of GPU timer queries, a set is only read back once the frame after it has been recorded
+constexpr uint32_t PROFILER_QUERY_FRAMES = 2;
+// GPU scopes per frame, later ones are dropped
+constexpr uint32_t PROFILER_MAX_GPU_SCOPES = 32;
+// overlay bars span this much time across the full framebuffer width
+constexpr double PROFILER_OVERLAY_SPAN = 1.0 / 30.0;
+
+// names are not copied, pass string literals
+struct ProfileEvent {
+	const char* name;
+	// jobThreadIndex of the recording thread
+	uint32_t thread;
+	uint32_t depth;
+	// nanoseconds since the profiler started
+	uint64_t begin, end;
+};
+
+struct GpuScopeResult {
+	const char* name;
+	// CPU time the scope was opened, the trace places the GPU span there
+	uint64_t cpuBegin;
+	uint64_t gpuNanoseconds;
+};
+
+struct FrameCounters {
+	uint64_t drawCalls = 0;
+	// of CPU issued draws, indirect draws are only counted as calls
+	uint64_t triangles = 0;
+	// GL state calls that made it past the state cache
+	uint64_t stateChanges = 0;
+	uint64_t uploadBytes = 0;
+	// GL_DEBUG_TYPE_PERFORMANCE messages, see GlDebugOutput
+	uint64_t performanceWarnings = 0;
+};
+
+struct ProfilerFrame {
+	uint64_t index = 0;
+	uint64_t begin = 0, end = 0;
+	std::vector<ProfileEvent> cpu;
+	std::vector<GpuScopeResult> gpu;
+	FrameCounters counters;
+	// GPU scopes whose result was not ready in time, skipped instead of waited on
+	uint32_t gpuDropped = 0;
+};
+
+struct GpuTimer {
+	const char* name;
+	uint64_t cpuBegin;
+	uint32_t query;
+};
+
+/*
+CPU scopes are recorded from any thread, GPU scopes are GL_TIME_ELAPSED
+queries issued on the GL thread and must not nest. queries are double
+buffered: a frame's results are collected at the end of the next frame
+without waiting, a frame is complete one frame late.
+*/
+struct Profiler {
+	bool enabled = true;
+	uint64_t frameIndex = 0;
+
+	std::mutex mutex;
+	// the frame being recorded, guarded by mutex while job threads may add to it
+	ProfilerFrame current;
+	// recorded, waiting for its GPU results
+	ProfilerFrame pending;
+	bool hasPending = false;
+	// the newest complete frame
+	ProfilerFrame last;
+
+	std::array<std::vector<GpuTimer>, PROFILER_QUERY_FRAMES> timers;
+	std::vector<uint32_t> freeQueries;
+	bool gpuScopeOpen = false;
+
+	// complete frames are collected here while captureFrames is above 0, then written as a trace
+	std::vector<ProfilerFrame> capture;
+	uint32_t captureFrames = 0;
+	std::string capturePath;
+
+	bool overlay = false;
+};
+
+extern Profiler profiler;
+
+uint64_t profilerNow();
+
+void beginProfilerFrame(Profiler* p);
+// call before the swap. collects the previous frame's GPU results without waiting
+void endProfilerFrame(Profiler* p);
+
+struct ProfileScope {
+	const char* name;
+	uint64_t begin;
+	uint32_t depth;
+
+	explicit ProfileScope(const char* name);
+	~ProfileScope();
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+// GL thread only. false, and nothing to end, while another GPU scope is open or the profiler is off
+bool beginGpuScope(Profiler* p, const char* name);
+void endGpuScope(Profiler* p);
+
+// a CPU scope and a GPU scope of the same name, for whole passes. the GPU half is skipped inside another pass
+struct ProfilePass {
+	ProfileScope cpu;
+	bool gpu;
+
+	explicit ProfilePass(const char* name);
+	~ProfilePass();
+};
+
+#define PROFILE_PASS(name) ProfilePass PROFILE_CONCAT(profilePass, __LINE__)(name)
+
+// GL thread only, like the calls they count
+inline void countDrawCall(uint64_t triangles) {
+	profiler.current.counters.drawCalls++;
+	profiler.current.counters.triangles += triangles;
+}
+inline void countUpload(uint64_t bytes) {
+	profiler.current.counters.uploadBytes += bytes;
+}
+
+// triangles drawn by `count` indices of a primitive format
+uint64_t primitiveTriangles(GLenum mode, uint64_t count);
+
+// the next `frames` complete frames are written to `path` as a Chrome trace, which Tracy imports with import-chrome
+void startProfilerCapture(Profiler* p, uint32_t frames, const std::string& path);
+void writeChromeTrace(const std::vector<ProfilerFrame>& frames, const std::string& path);
+
+// frame time, the slowest scopes and the counters of the last complete frame on one line
+std::string profilerSummary(const Profiler* p);
+// one bar per GPU and top level main thread scope across the top of the framebuffer, drawn with scissored clears
+void drawProfilerOverlay(const Profiler* p, glm::ivec2 framebufferSize);
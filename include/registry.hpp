@@ -0,0 +1,107 @@
+#pragma once
+
+#include "game.hpp"
+#include "bvh.hpp"
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+// stable handle, a destroyed entity's slot is reused with a higher generation
+struct Entity {
+	uint32_t slot;
+	uint32_t generation;
+
+	bool operator==(const Entity&) const = default;
+};
+
+constexpr Entity NULL_ENTITY{ 0xFFFFFFFF, 0 };
+
+/*
+components are stored as parallel dense arrays, the entity at dense index i
+owns element i of every array. destroying swaps the last entity into the
+hole, so the arrays stay packed and iteration never touches dead entities.
+*/
+struct Registry {
+	// indexed by slot
+	std::vector<uint32_t> generations;
+	std::vector<uint32_t> slotToDense;
+	std::vector<uint32_t> freeSlots;
+
+	// indexed by dense index
+	std::vector<uint32_t> denseToSlot;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::fquat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<Mesh*> meshes;
+	std::vector<const LodChain*> lodChains;
+	std::vector<Material*> materials;
+	std::vector<glm::mat4> worldMatrices;
+	// mesh bounds, and the same box in world space kept up to date with worldMatrices
+	std::vector<Aabb> localBounds;
+	std::vector<Aabb> worldBounds;
+
+	// hierarchy, links are handles so they survive the swap on destroy
+	std::vector<Entity> parents;
+	std::vector<Entity> firstChildren;
+	std::vector<Entity> nextSiblings;
+	std::vector<Entity> prevSiblings;
+
+	// set when the local transform changed, spreads to children during updateWorldMatrices
+	std::vector<uint8_t> dirty;
+	size_t dirtyCount = 0;
+
+	// dense indices sorted by depth, so a parent is always updated before its children
+	std::vector<uint32_t> order;
+	bool orderDirty = true;
+
+	// world bounds of every entity keyed by slot, kept in sync by updateWorldMatrices when set
+	Bvh* spatial = nullptr;
+	std::vector<int32_t> spatialLeaves;
+};
+
+Entity createEntity(Registry* registry, Mesh* mesh, Material* material, const Transform& transform = {});
+// bulk clone of a prefab, the arrays grow once for the whole batch
+std::vector<Entity> createEntities(Registry* registry, const GameObject* prefab, size_t count);
+// children of a destroyed entity become roots
+void destroyEntity(Registry* registry, Entity e);
+
+bool isAlive(const Registry* registry, Entity e);
+uint32_t denseIndexOf(const Registry* registry, Entity e);
+size_t entityCount(const Registry* registry);
+Entity entityAt(const Registry* registry, uint32_t dense);
+
+Transform getTransform(const Registry* registry, Entity e);
+void setTransform(Registry* registry, Entity e, const Transform& transform);
+void setPosition(Registry* registry, Entity e, const glm::vec3& position);
+void setRotation(Registry* registry, Entity e, const glm::fquat& rotation);
+void setScale(Registry* registry, Entity e, const glm::vec3& scale);
+void setMaterial(Registry* registry, Entity e, Material* material);
+// the mesh becomes the chain's full detail level
+void setLodChain(Registry* registry, Entity e, const LodChain* lods);
+Mesh* meshOf(const Registry* registry, Entity e);
+Material* materialOf(const Registry* registry, Entity e);
+
+void markDirty(Registry* registry, Entity e);
+
+// keeps the child's local transform, its world matrix follows the new parent
+void setParent(Registry* registry, Entity child, Entity parent);
+Entity parentOf(const Registry* registry, Entity e);
+std::vector<Entity> childrenOf(const Registry* registry, Entity e);
+
+// dirty entities at or above this fraction go through the batch kernel for the whole registry
+constexpr size_t REGISTRY_BATCH_DIRTY_DIVISOR = 4;
+
+// indexes every entity, and everything created afterwards, in `bvh`
+void setSpatialIndex(Registry* registry, Bvh* bvh);
+// the entities behind leaf values returned by queries on the spatial index
+Entity entityOfSlot(const Registry* registry, uint32_t slot);
+// nearest entity whose world bounds the ray hits, NULL_ENTITY if none
+Entity pickEntity(const Registry* registry, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance = nullptr);
+std::vector<Entity> nearestEntities(const Registry* registry, const glm::vec3& point, size_t k);
+
+struct JobSystem;
+
+// recomputes world matrices and bounds of dirty entities and their descendants in one pass over `order`.
+// a full batch update runs the kernel on every thread of `jobs` when set, the parent pass stays serial
+void updateWorldMatrices(Registry* registry, JobSystem* jobs = nullptr);
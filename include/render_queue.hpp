@@ -0,0 +1,121 @@
+#pragma once
+
+#include "game.hpp"
+#include "instancing.hpp"
+#include "registry.hpp"
+#include "culling.hpp"
+#include "material_table.hpp"
+#include "texture_streamer.hpp"
+#include "transient_buffer.hpp"
+#include "oit.hpp"
+
+#include <vector>
+#include <cstdint>
+
+// in draw order
+enum class RenderPass : uint8_t {
+	Opaque = 0,
+	// blended draws into the queue's OitTarget, composited before the sorted ones
+	Accumulated = 1,
+	Transparent = 2
+};
+
+/*
+sort key layout, most significant bit first:
+
+opaque:      [pass:2][shader:12][material:12][mesh:12][depth:24][unused:2]
+accumulated: [pass:2][shader:12][material:12][mesh:12][depth:24][unused:2]
+transparent: [pass:2][~depth:24][shader:12][material:12][mesh:12][unused:2]
+
+opaque draws are grouped by state and go front-to-back inside a group.
+accumulated draws blend in any order, so they are grouped and instanced
+the same way, the remaining blended draws go strictly back-to-front.
+*/
+constexpr uint32_t SORT_KEY_STATE_BITS = 12;
+constexpr uint32_t SORT_KEY_DEPTH_BITS = 24;
+
+struct RenderItem {
+	Mesh* mesh;
+	Material* material;
+	glm::mat4 model;
+	// dithered LOD transition, positive when fading in and negative when fading out
+	float lodFade = 0.0f;
+};
+
+struct RenderKey {
+	uint64_t key;
+	uint32_t item;
+};
+
+struct JobSystem;
+struct RenderCommandList;
+
+struct RenderQueue {
+	std::vector<RenderItem> items;
+	std::vector<RenderKey> keys;
+	std::vector<RenderKey> scratch;
+
+	// runs of identical mesh and material are instanced through this when set
+	InstanceBuffer* instances = nullptr;
+
+	// objects outside the frustum or hidden by the previous depth never enter the queue when set
+	Culler* culling = nullptr;
+
+	// opaque depth is laid down first with this program from the pools' position streams when set, needs `instances`
+	ShaderProgram* depthPrepass = nullptr;
+
+	// per-draw values of shaders with a DrawConstants block are written here and bound by offset when set
+	TransientBuffer* transient = nullptr;
+
+	// blended materials with an oitShader are drawn order-independently into this when set
+	OitTarget* oit = nullptr;
+
+	// materials registered here that have a bindlessShader are batched by shader and mesh alone when set
+	MaterialTable* materials = nullptr;
+	// leaf values from the registry's spatial index, reused between frames
+	std::vector<uint32_t> visible;
+
+	// see lodProjectionScale, LOD chains and texture footprints are ignored while 0
+	float lodProjectionScale = 0.0f;
+	// reports each object's screen size to its material's streamed textures, see noteMaterialUsage
+	bool textureFootprints = false;
+	// footprints are collected here instead of reaching the textures when set
+	std::vector<MaterialFootprint>* footprints = nullptr;
+
+	// submitRegistry spreads culling, LOD selection and sort key generation over these threads when set
+	JobSystem* jobs = nullptr;
+	// one per job thread, kept between frames for their capacity
+	std::vector<RenderCommandList> commandLists;
+};
+
+/*
+what one job thread recorded during a parallel submit. the queue carries
+the owner's settings and a private culler, so nothing shared is written
+while recording. the GL thread then replays every list into the owner in
+thread order: items and keys are appended, footprints noted, stats summed.
+*/
+struct RenderCommandList {
+	RenderQueue queue;
+	Culler culler;
+	std::vector<MaterialFootprint> footprints;
+};
+
+RenderPass passOf(const RenderQueue* queue, const Material* mat);
+uint64_t makeSortKey(RenderPass pass, uint32_t shader, uint32_t material, uint32_t mesh, float depth01);
+
+void clearRenderQueue(RenderQueue* queue);
+// always queued, the submit functions below cull their objects first
+void submitRenderItem(RenderQueue* queue, Camera* camera, Mesh* mesh, Material* material, const glm::mat4& model, float lodFade = 0.0f);
+// picks the level of `lods` for the object's screen size, two items while it crosses a fade band.
+// `lods` may be nullptr, the object's screen size still feeds texture streaming
+void submitLodItem(RenderQueue* queue, Camera* camera, const LodChain* lods, Mesh* mesh, Material* material, const glm::mat4& model);
+void submitGameObjects(RenderQueue* queue, Camera* camera, const std::vector<GameObject*>& objs);
+// world matrices have to be current, see updateWorldMatrices
+void submitRegistry(RenderQueue* queue, Camera* camera, const Registry* registry);
+void submitEntities(RenderQueue* queue, Camera* camera, const Registry* registry, const std::vector<Entity>& entities);
+void radixSortKeys(std::vector<RenderKey>& keys, std::vector<RenderKey>& scratch);
+void sortRenderQueue(RenderQueue* queue);
+void flushRenderQueue(RenderQueue* queue);
+
+void renderGameObjectsQueued(RenderQueue* queue, Camera* camera, const std::vector<GameObject*>& objs);
+void renderRegistryQueued(RenderQueue* queue, Camera* camera, const Registry* registry);
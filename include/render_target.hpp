@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+
+/*
+offscreen colour and depth the frame is drawn into, then copied to the
+window. the window's depth format is whatever the pixel format gave us,
+usually 24 bit fixed point, which throws away most of what a reversed-Z
+projection gains. a target of our own can use GL_DEPTH32F_STENCIL8.
+*/
+struct RenderTarget {
+	uint32_t framebuffer = 0;
+	// renderbuffers, they are only blitted and read back, never sampled
+	uint32_t color = 0;
+	uint32_t depth = 0;
+	GLenum colorFormat;
+	GLenum depthFormat;
+	glm::ivec2 size{ 0, 0 };
+};
+
+RenderTarget* createRenderTarget(GLenum colorFormat = GL_RGBA8, GLenum depthFormat = GL_DEPTH32F_STENCIL8);
+// reallocates the attachments when `size` differs from the last call
+void resizeRenderTarget(RenderTarget* target, glm::ivec2 size);
+
+// copies colour into the window's back buffer and leaves the window bound, call before the swap
+void presentRenderTarget(RenderTarget* target);
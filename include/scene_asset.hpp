@@ -0,0 +1,111 @@
+#pragma once
+
+#include "game.hpp"
+#include "registry.hpp"
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+constexpr uint32_t SCENE_ASSET_MAGIC = 0x4E435350; // "PSCN"
+// bumped on any change to the structs below, older files are rejected
+constexpr uint32_t SCENE_ASSET_VERSION = 2;
+constexpr uint64_t SCENE_ASSET_ALIGNMENT = 16;
+
+/*
+scene asset file, little endian, every section starts on SCENE_ASSET_ALIGNMENT:
+  SceneAssetHeader
+  SceneAssetMesh[meshCount]
+  SceneAssetNode[nodeCount]
+  vertices, vertexCount * stride bytes already in the header's vertex layout
+  positions, the position attribute of every vertex again on its own, for the pool's position stream
+  indices, indexCount of indexType, local to each mesh's baseVertex
+
+the blobs are exactly what the geometry pool buffers hold, so loading maps
+the file and hands the mapped pages to glNamedBufferStorage. nothing is
+parsed per vertex, only the small tables are read on the CPU.
+*/
+struct SceneAssetHeader {
+	uint32_t magic;
+	uint32_t version;
+	// AttributeFormat per VertexAttribute
+	uint8_t formats[VERTEX_ATTRIBUTE_COUNT];
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	uint32_t indexType;
+	uint32_t meshCount, nodeCount;
+	uint32_t vertexCount, indexCount;
+	uint64_t meshOffset, nodeOffset, vertexOffset, positionOffset, indexOffset;
+	uint64_t fileSize;
+};
+
+struct SceneAssetMesh {
+	uint32_t baseVertex, firstIndex;
+	uint32_t vertexCount, indexCount;
+	// PrimitiveFormat
+	uint32_t primitive;
+	float boundingSphere[4];
+	float boundsMin[3], boundsMax[3];
+};
+
+constexpr uint32_t SCENE_ASSET_NO_MESH = 0xFFFFFFFF;
+
+// parents come before their children
+struct SceneAssetNode {
+	// SCENE_ASSET_NO_MESH for pure transform nodes
+	uint32_t mesh;
+	// index of the parent node, -1 for roots
+	int32_t parent;
+	float position[3];
+	float rotation[4]; // x y z w
+	float scale[3];
+};
+
+static_assert(sizeof(SceneAssetHeader) == 80);
+static_assert(sizeof(SceneAssetMesh) == 60);
+static_assert(sizeof(SceneAssetNode) == 48);
+
+// authoring input for writeSceneAsset
+struct SceneAssetSource {
+	std::span<const Vertex> vertices;
+	std::span<const uint32_t> indices;
+	PrimitiveFormat primitiveFormat = PrimitiveFormat::Triangles;
+};
+
+// all meshes share one layout and one index type, 16 bit when every mesh has at most 65536 vertices
+void writeSceneAsset(const std::string& path, std::span<const SceneAssetSource> meshes, std::span<const SceneAssetNode> nodes, const VertexLayout& layout = compactVertexLayout());
+
+// the meshes live in a pool of their own, sized exactly for the file
+struct SceneAsset {
+	GeometryPool* pool;
+	std::vector<Mesh*> meshes;
+	std::vector<SceneAssetNode> nodes;
+};
+
+struct MappedFile;
+
+// validated tables and blobs of a mapped scene asset, pointing into the mapping
+struct SceneAssetView {
+	SceneAssetHeader header;
+	const SceneAssetMesh* meshes;
+	const SceneAssetNode* nodes;
+	const VertexLayout* layout;
+	uint32_t indexSize;
+	const uint8_t* vertices;
+	const uint8_t* positions;
+	// bytes per vertex of `positions`
+	uint32_t positionStride;
+	const uint8_t* indices;
+};
+
+// checks every table against the file size and throws on a corrupt file, touches no GL state
+void readSceneAsset(const MappedFile* file, const std::string& path, SceneAssetView* view);
+// meshes for the records of `view`, whose blobs `pool` already holds at the same offsets
+SceneAsset* createSceneAsset(const SceneAssetView& view, GeometryPool* pool);
+
+// the file is only mapped while loading, the GL keeps its own copy of the blobs
+SceneAsset* loadSceneAsset(const std::string& path);
+// the meshes and the pool, entities instantiated from the asset have to be destroyed first
+void destroySceneAsset(SceneAsset* asset);
+// one entity per node with the node hierarchy, all sharing `material`
+std::vector<Entity> instantiateSceneAsset(Registry* registry, const SceneAsset* asset, Material* material);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// relative to the working directory, created on first store
+constexpr const char* SHADER_CACHE_DIR = "shader_cache";
+constexpr uint32_t SHADER_CACHE_MAGIC = 0x48435350; // "PSCH"
+
+/*
+program binaries on disk, one file per program named after its key.
+the key hashes the driver's vendor, renderer and version strings together
+with every stage's source, so any edit or driver update misses the cache.
+a stale or rejected binary is not an error, the program is just built
+from source again and the file replaced.
+*/
+struct ProgramCacheKey {
+	uint64_t hash = 14695981039346656037ull;
+};
+
+// seeded with the driver strings, needs a current context
+ProgramCacheKey beginProgramCacheKey();
+void hashProgramSource(ProgramCacheKey* key, uint32_t stage, std::string_view source);
+
+// links `program` from the cached binary, false on a miss or when the driver rejects it
+bool loadProgramBinary(uint32_t program, ProgramCacheKey key);
+// call after a successful link of a program created with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+void storeProgramBinary(uint32_t program, ProgramCacheKey key);
+
+// lets the driver compile on its own threads, see KHR_parallel_shader_compile
+bool enableParallelShaderCompile();
+bool parallelShaderCompileEnabled();
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+/*
+shader files hold one or more stages, each starting at a line
+	#type <vertex|fragment|compute|geometry|tess-control|tess-evaluation>
+text above the first #type is shared by every stage of the file.
+
+	#include "path"  relative to the including file, expanded in place
+	#pragma once     the file is expanded at most once per stage, as is a
+	                 file whose whole body sits inside an #ifndef/#define guard
+
+each stage's #version line is hoisted to the top, followed by the variant's
+defines and a #line directive, so compile errors still point at the original
+line. the number after the line in an error is the index into `files`.
+conditionals are left to the GLSL compiler, so a once file first included
+under a false #ifdef is not expanded again further down.
+*/
+struct ShaderDefine {
+	std::string_view name;
+	std::string_view value = "1";
+};
+
+// file contents and their guard, read from disk once and shared by every program and variant
+struct ShaderSourceFile {
+	std::string text;
+	bool once = false;
+};
+
+struct ShaderSourceCache {
+	std::unordered_map<std::string, ShaderSourceFile> files;
+};
+
+extern ShaderSourceCache shaderSources;
+
+struct ShaderStageSource {
+	uint32_t stage;
+	std::string source;
+	// every file expanded into `source`, in source string number order
+	std::vector<std::string> files;
+};
+
+uint32_t shaderStageFromName(std::string_view name);
+
+// appends one entry per #type section, throws when a file or the #version line is missing
+void preprocessShader(ShaderSourceCache* cache, const std::string& path, std::span<const ShaderDefine> defines, std::vector<ShaderStageSource>* stages);
+
+// the same files with the same defines in any order give the same key
+uint64_t shaderVariantKey(std::span<const std::string> files, std::span<const ShaderDefine> defines);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <deque>
+#include <cstdint>
+#include <cstddef>
+
+/*
+persistently mapped upload buffer used as a byte ring. the CPU writes at
+head, GPU copies read out of it, and every batch of copies is followed by
+a fence. the space behind a fence is only reused once the fence has
+signalled, checked without blocking, so a full ring just means the next
+upload waits a frame instead of stalling the GL thread.
+*/
+struct StagingRing {
+	uint32_t handle;
+	uint8_t* mapped;
+	size_t size;
+
+	// running byte counters, position in the buffer is counter % size
+	uint64_t head = 0;
+	uint64_t tail = 0;
+
+	struct Fence {
+		GLsync sync;
+		uint64_t head;
+	};
+	std::deque<Fence> fences;
+	// head when the last fence was placed, nothing to fence while unchanged
+	uint64_t fencedHead = 0;
+};
+
+struct StagingAllocation {
+	uint8_t* data;
+	// byte offset into the ring buffer, the source offset for glCopyNamedBufferSubData and unpack reads
+	size_t offset;
+};
+
+// allocations are aligned to this, enough for any vertex, index or texel block copy
+constexpr size_t STAGING_ALIGNMENT = 16;
+
+StagingRing* createStagingRing(size_t size);
+void destroyStagingRing(StagingRing* ring);
+// data is nullptr when the free space is not yet retired, allocations never wrap around the end
+StagingAllocation allocateStaging(StagingRing* ring, size_t size);
+// bytes allocateStaging can currently hand out in one piece
+size_t stagingContiguousFree(const StagingRing* ring);
+// fences everything allocated since the last call, call after issuing the copies
+void fenceStaging(StagingRing* ring);
+// frees the space of signalled fences
+void retireStaging(StagingRing* ring);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct MappedFile;
+struct StagingRing;
+
+// levels of this size and smaller are loaded up front and never evicted
+constexpr uint32_t TEXTURE_STREAMING_MIN_SIZE = 64;
+constexpr float TEXTURE_MAX_ANISOTROPY = 8.0f;
+
+// block compressed formats are 4x4 texels for BCn and up to 8x8 for ASTC, uncompressed ones are 1x1
+struct TextureFormatInfo {
+	GLenum internalFormat;
+	uint32_t blockWidth, blockHeight;
+	uint32_t blockBytes;
+	// for glTextureSubImage2D, GL_NONE on compressed formats
+	GLenum format, type;
+};
+
+struct TextureLevel {
+	// into the mapped file
+	size_t offset, bytes;
+	glm::ivec2 extent;
+};
+
+/*
+a KTX2 file kept mapped for the lifetime of the texture, so any level can
+be uploaded again after it was evicted. the streamer records the largest
+screen footprint a texture was drawn at each frame and moves the resident
+level towards the one that footprint needs.
+*/
+struct TextureSource {
+	MappedFile* file;
+	TextureFormatInfo format;
+	std::vector<TextureLevel> levels;
+
+	// pixels across the largest object drawn with the texture this frame, reset by the streamer
+	float footprint = 0.0f;
+	uint64_t lastUsedFrame = 0;
+};
+
+// false when the format needs an extension the driver lacks
+bool textureFormatSupported(GLenum internalFormat);
+size_t textureLevelBytes(const TextureFormatInfo& format, glm::ivec2 extent);
+// bytes of video memory currently held by the texture's levels
+size_t textureResidentBytes(const Texture* texture);
+
+// immutable storage for `levelCount` levels, sampler state set for trilinear filtering
+Texture* createTexture(glm::ivec2 size, GLenum internalFormat, uint32_t levelCount);
+// uploads level 0 and generates the rest of the chain on the GPU
+Texture* createTextureRGBA8(const uint8_t* pixels, glm::ivec2 size, bool mipmaps = true);
+
+/*
+BCn, ASTC or RGBA8 KTX2 without supercompression. the file's mip chain is
+used when present, uncompressed files with a single level get one generated.
+with `streamed` only the levels up to TEXTURE_STREAMING_MIN_SIZE are
+uploaded here and the rest come through a TextureStreamer.
+*/
+Texture* loadKtx2(const std::string& path, bool streamed = true);
+// reallocates the storage to hold levels `level`..levelCount-1, keeping what is already resident.
+// new levels are read from the source through `staging` when it has room, or straight from the mapping
+void setResidentLevel(Texture* texture, uint32_t level, StagingRing* staging = nullptr);
+void destroyTexture(Texture* texture);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "texture.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+constexpr size_t TEXTURE_VRAM_BUDGET = 256ull << 20;
+// storage reallocations per frame, each one is a texture create, GPU copy and one level upload
+constexpr uint32_t TEXTURE_UPGRADES_PER_FRAME = 4;
+
+struct TextureStreamingStats {
+	size_t residentBytes = 0;
+	uint32_t upgraded = 0;
+	uint32_t evicted = 0;
+	// textures that wanted a finer level but did not fit in the budget
+	uint32_t starved = 0;
+};
+
+/*
+keeps every streamed texture at the level its screen footprint needs,
+within `budget` bytes. each update makes at most a few textures one level
+finer, and when over budget drops the finest level of whatever was used
+least recently until the total fits again. levels up to
+TEXTURE_STREAMING_MIN_SIZE are never dropped.
+*/
+struct TextureStreamer {
+	std::vector<Texture*> textures;
+	size_t budget = TEXTURE_VRAM_BUDGET;
+	// uploads go through it when set, shared with the asset streamer
+	StagingRing* staging = nullptr;
+	uint64_t frame = 0;
+	TextureStreamingStats stats;
+};
+
+TextureStreamer* createTextureStreamer(size_t budget = TEXTURE_VRAM_BUDGET, StagingRing* staging = nullptr);
+// textures without a source are fully resident already and ignored
+void addStreamedTexture(TextureStreamer* streamer, Texture* texture);
+void removeStreamedTexture(TextureStreamer* streamer, Texture* texture);
+
+// `pixels` is how many pixels the object drawn with `material` spans on screen
+void noteMaterialUsage(const Material* material, float pixels);
+
+// a noteMaterialUsage call held back by a thread that must not touch the textures itself
+struct MaterialFootprint {
+	const Material* material;
+	float pixels;
+};
+// once per frame after everything was submitted, fences its staging uploads
+void updateTextureStreaming(TextureStreamer* streamer);
+// level of `texture` needed to draw it `pixels` across, the texture is assumed to span the object once
+uint32_t desiredTextureLevel(const Texture* texture, float pixels);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "game.hpp"
+
+#include <glm/glm.hpp>
+#include <cstddef>
+
+enum class TransformKernelIsa {
+	Scalar,
+	Sse2,
+	Avx2,
+	Neon
+};
+
+// compiled in and usable on the running CPU
+bool transformKernelSupported(TransformKernelIsa isa);
+// the widest supported one, picked once
+TransformKernelIsa transformKernelIsa();
+const char* transformKernelName(TransformKernelIsa isa);
+
+/*
+T*R*S world matrices for `count` transforms given as parallel arrays, plus
+their world-space boxes when both bounds pointers are set. matches
+composeTRS and transformAabb, only several transforms at a time.
+*/
+void batchTransforms(const glm::vec3* positions, const glm::fquat* rotations, const glm::vec3* scales, const Aabb* localBounds, size_t count, glm::mat4* outWorld, Aabb* outBounds);
+
+// forces an instruction set, for comparing the paths against each other. throws if it is not supported
+void batchTransforms(TransformKernelIsa isa, const glm::vec3* positions, const glm::fquat* rotations, const glm::vec3* scales, const Aabb* localBounds, size_t count, glm::mat4* outWorld, Aabb* outBounds);
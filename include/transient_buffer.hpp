@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// frames the CPU can run ahead of the GPU before a region is reused
+constexpr uint32_t TRANSIENT_BUFFER_FRAMES = 3;
+constexpr size_t TRANSIENT_BUFFER_SIZE = 8ull << 20; // per region
+// the largest block bindTransientUniforms can place once a region is full, GL guarantees 16KB blocks
+constexpr size_t TRANSIENT_OVERFLOW_SIZE = 16ull << 10;
+
+/*
+persistently mapped, coherent buffer of per-frame data that lives for one
+frame: constants, per-draw values, anything bound by offset. split into one
+region per frame in flight like InstanceBuffer, a region is written again
+only after the fence placed at the end of the frame that used it has
+signalled, so frame N+1 is recorded while the GPU still reads frame N.
+allocation is a bump of `used`, everything in the region is freed at once.
+*/
+struct TransientBuffer {
+	uint32_t handle;
+	uint8_t* mapped;
+	size_t regionSize;
+
+	uint32_t region = 0;
+	size_t used = 0;
+	std::array<GLsync, TRANSIENT_BUFFER_FRAMES> fences{};
+
+	// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT and its storage buffer counterpart
+	uint32_t uniformAlignment;
+	uint32_t storageAlignment;
+
+	// updated with glNamedBufferSubData when a region is full, correct but synchronised like the old path
+	uint32_t overflow;
+	// bytes requested that did not fit in this frame's region
+	size_t overflowBytes = 0;
+};
+
+struct TransientAllocation {
+	void* data;
+	// from the start of the buffer, for glBindBufferRange or attribute bindings
+	size_t offset;
+};
+
+TransientBuffer* createTransientBuffer(size_t regionSize = TRANSIENT_BUFFER_SIZE);
+// waits for the GPU to be done with the region it switches to, usually already the case
+void beginTransientFrame(TransientBuffer* buffer);
+void endTransientFrame(TransientBuffer* buffer);
+
+// data is nullptr when the region is full. `alignment` does not need to be a power of two
+TransientAllocation allocateTransient(TransientBuffer* buffer, size_t size, size_t alignment);
+// copies `data` into this frame's region and binds it to the uniform block binding
+void bindTransientUniforms(TransientBuffer* buffer, uint32_t binding, const void* data, size_t size);
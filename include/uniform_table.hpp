@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+struct UniformInfo {
+	uint32_t hash;
+	int32_t location;
+	GLenum type;
+	int32_t arraySize;
+	std::string name;
+};
+
+struct UniformBlockInfo {
+	uint32_t hash;
+	uint32_t index;
+	int32_t binding;
+	int32_t dataSize;
+	std::string name;
+};
+
+/*
+flat open-addressed tables filled once at link time.
+slots hold an index into `uniforms`/`blocks`, or -1 when empty.
+*/
+struct UniformTable {
+	std::vector<UniformInfo> uniforms;
+	std::vector<int32_t> uniformSlots;
+
+	std::vector<UniformBlockInfo> blocks;
+	std::vector<int32_t> blockSlots;
+};
+
+constexpr uint32_t hashName(std::string_view name) {
+	uint32_t h = 2166136261u;
+	for (char c : name) {
+		h ^= static_cast<uint8_t>(c);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+void reflectProgram(uint32_t program, UniformTable* table);
+
+const UniformInfo* findUniform(const UniformTable* table, std::string_view name);
+const UniformBlockInfo* findUniformBlock(const UniformTable* table, std::string_view name);
+
+// -1 when the program has no active uniform of that name, which glUniform* ignores
+int32_t uniformLocation(const UniformTable* table, std::string_view name);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+struct Vertex;
+struct Mesh;
+struct Material;
+
+// each attribute always uses the same shader location, so one shader can read any layout
+enum class VertexAttribute : uint8_t {
+	Position = 0,
+	Color = 1,
+	TexCoord = 2,
+	Normal = 3
+};
+
+constexpr uint32_t VERTEX_ATTRIBUTE_COUNT = 4;
+
+/*
+how an attribute is stored in the vertex buffer. the GL converts on fetch, so
+a shader input declared as vec4 works with all of them: missing components
+read as 0 and w as 1, packed integer formats are normalized to [0,1] or [-1,1].
+*/
+enum class AttributeFormat : uint8_t {
+	None,
+	Float2,
+	Float3,
+	Float4,
+	Half2,
+	Half4,
+	Unorm8x4,
+	Snorm10x3_2 // GL_INT_2_10_10_10_REV
+};
+
+struct VertexLayout {
+	std::array<AttributeFormat, VERTEX_ATTRIBUTE_COUNT> formats{};
+	std::array<uint32_t, VERTEX_ATTRIBUTE_COUNT> offsets{};
+	uint32_t stride = 0;
+
+	// one bit per present attribute, and all formats packed into one value for pool lookup
+	uint32_t mask = 0;
+	uint32_t key = 0;
+};
+
+VertexLayout makeVertexLayout(AttributeFormat position, AttributeFormat color, AttributeFormat texCoord, AttributeFormat normal);
+
+// matches `Vertex` byte for byte, 56 bytes
+const VertexLayout& fullVertexLayout();
+// vec3 position, RGBA8 color, half UVs and 2_10_10_10 normals, 24 bytes
+const VertexLayout& compactVertexLayout();
+// the one long-lived copy of a layout, for layouts built at runtime that pools and meshes point at
+const VertexLayout& internVertexLayout(const VertexLayout& layout);
+
+uint32_t attributeSize(AttributeFormat format);
+void setupVertexLayout(uint32_t vao, const VertexLayout& layout);
+// converts from the authoring format, `out` needs count * layout.stride bytes
+void packVertices(const VertexLayout& layout, const Vertex* vertices, size_t count, void* out);
+
+// bit per vertex attribute location below VERTEX_ATTRIBUTE_COUNT the linked program reads
+uint32_t reflectVertexInputs(uint32_t program);
+// logs once per layout and program when the shader reads attributes the mesh does not store
+bool checkVertexLayout(const Mesh* mesh, const Material* material);
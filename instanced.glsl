@@ -0,0 +1,100 @@
+#version 430 core
+/*
+variants:
+  INDIRECT_DRAW       objects come from the GPU scene, baseInstance selects one
+  BINDLESS_MATERIALS  color and textures come from the material table
+  OIT_ACCUMULATE      see fragment_output.glsl
+  CLUSTERED_LIGHTING  lit by the clustered point lights instead of darkened with depth
+*/
+
+#type vertex
+#include "vertex_inputs.glsl"
+#include "frame_constants.glsl"
+
+// bit for bit what depth_only.glsl writes, so the colour pass passes the depth test the pre-pass laid down
+invariant gl_Position;
+
+#ifdef INDIRECT_DRAW
+#include "gpu_object.glsl"
+
+// instanced attribute over 0..N-1, so baseInstance selects the object
+layout(location = 9) in uint inObjectId;
+
+layout(std430, binding = 0) readonly buffer Objects { GpuObject objects[]; };
+#else
+layout(location = 4) in mat4 inModel;
+layout(location = 8) in vec4 inInstanceColor;
+layout(location = 10) in uint inMaterial;
+#endif
+
+out vec4 vColor;
+out vec2 vTexCoords;
+// for fragment shaders reading the material table
+flat out uint vMaterial;
+#ifdef CLUSTERED_LIGHTING
+out vec3 vWorldPosition;
+out vec3 vNormal;
+#endif
+
+void main() {
+#ifdef INDIRECT_DRAW
+	GpuObject obj = objects[inObjectId];
+	vColor = obj.color;
+	vMaterial = obj.material;
+	mat4 model = obj.model;
+#else
+	vColor = inInstanceColor;
+	vMaterial = inMaterial;
+	mat4 model = inModel;
+#endif
+	vTexCoords = inTexCoords;
+	gl_Position = uViewProjection * model * inPos;
+#ifdef CLUSTERED_LIGHTING
+	vWorldPosition = vec3(model * inPos);
+	vNormal = mat3(model) * inNormals.xyz;
+#endif
+}
+
+#type fragment
+#ifdef BINDLESS_MATERIALS
+#extension GL_ARB_bindless_texture : require
+#endif
+#include "depth_shade.glsl"
+#include "fragment_output.glsl"
+
+in vec4 vColor;
+in vec2 vTexCoords;
+flat in uint vMaterial;
+
+#ifdef CLUSTERED_LIGHTING
+#include "clustered_lights.glsl"
+
+in vec3 vWorldPosition;
+in vec3 vNormal;
+#endif
+
+#ifdef BINDLESS_MATERIALS
+// mirrors GpuMaterial in material_table.hpp
+struct GpuMaterial {
+	vec4 color;
+	uvec2 textures[4];
+};
+
+layout(std430, binding = 4) readonly buffer Materials { GpuMaterial materials[]; };
+#endif
+
+void main() {
+#ifdef BINDLESS_MATERIALS
+	GpuMaterial material = materials[vMaterial];
+	vec4 color = material.color;
+	// a zero handle is an empty slot
+	if (material.textures[0] != uvec2(0)) color *= texture(sampler2D(material.textures[0]), vTexCoords);
+#else
+	vec4 color = vColor;
+#endif
+#ifdef CLUSTERED_LIGHTING
+	writeColor(vec4(shadeClustered(color.rgb, vWorldPosition, vNormal), color.a));
+#else
+	writeColor(vec4(depthShade(color.rgb), color.a));
+#endif
+}
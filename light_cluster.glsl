@@ -0,0 +1,77 @@
+#type compute
+#version 430 core
+/*
+assigns lights to froxels, one invocation per cluster. the lights are
+staged through shared memory a workgroup at a time in view space, every
+invocation tests the whole batch against its cluster's bounds.
+*/
+
+// CLUSTER_WORKGROUP_SIZE in clustered_lighting.cpp
+layout(local_size_x = 128) in;
+
+#include "frame_constants.glsl"
+#include "cluster_params.glsl"
+
+// CLUSTER_MAX_LIGHTS in clustered_lighting.hpp
+const uint MAX_LIGHTS = 128;
+
+layout(std430, binding = 5) readonly buffer Lights { GpuLight lights[]; };
+layout(std430, binding = 6) writeonly buffer LightIndices { uint lightIndices[]; };
+layout(std430, binding = 7) writeonly buffer LightGrid { uvec2 lightGrid[]; };
+layout(std430, binding = 8) buffer LightCounter { uint lightIndexCount; };
+
+// view space position and radius
+shared vec4 batch[gl_WorkGroupSize.x];
+
+float sliceDepth(uint slice) {
+	return uClusterDepth.x * pow(uClusterDepth.y / uClusterDepth.x, float(slice) / float(uClusterGrid.z));
+}
+
+void main() {
+	uint cluster = gl_GlobalInvocationID.x;
+	uint clusterCount = uClusterGrid.x * uClusterGrid.y * uClusterGrid.z;
+	// no early return, every invocation has to reach the barriers
+	bool valid = cluster < clusterCount;
+	uvec3 c = uvec3(cluster % uClusterGrid.x, (cluster / uClusterGrid.x) % uClusterGrid.y, cluster / (uClusterGrid.x * uClusterGrid.y));
+
+	// the froxel's eight corners are its tile's corner rays at the slice's two depths, the camera looks down -z
+	vec2 ndcMin = vec2(c.xy) / vec2(uClusterGrid.xy) * 2.0 - 1.0;
+	vec2 ndcMax = vec2(c.xy + 1u) / vec2(uClusterGrid.xy) * 2.0 - 1.0;
+	float nearDepth = sliceDepth(c.z);
+	float farDepth = sliceDepth(c.z + 1u);
+	vec3 boundsMin = vec3(1e30);
+	vec3 boundsMax = vec3(-1e30);
+	for (int i = 0; i < 4; i++) {
+		vec2 ndc = vec2((i & 1) != 0 ? ndcMax.x : ndcMin.x, (i & 2) != 0 ? ndcMax.y : ndcMin.y);
+		vec3 ray = vec3(ndc * uClusterDepth.zw, -1.0);
+		boundsMin = min(boundsMin, min(ray * nearDepth, ray * farDepth));
+		boundsMax = max(boundsMax, max(ray * nearDepth, ray * farDepth));
+	}
+
+	uint found[MAX_LIGHTS];
+	uint count = 0;
+	uint lightCount = uClusterCounts.x;
+	for (uint base = 0; base < lightCount; base += gl_WorkGroupSize.x) {
+		uint l = base + gl_LocalInvocationIndex;
+		if (l < lightCount) {
+			vec4 light = lights[l].positionRadius;
+			batch[gl_LocalInvocationIndex] = vec4((uView * vec4(light.xyz, 1.0)).xyz, light.w);
+		}
+		barrier();
+
+		uint batchSize = min(gl_WorkGroupSize.x, lightCount - base);
+		for (uint j = 0; valid && j < batchSize; j++) {
+			// sphere against box, by the distance to the box's closest point
+			vec3 closest = clamp(batch[j].xyz, boundsMin, boundsMax) - batch[j].xyz;
+			if (dot(closest, closest) <= batch[j].w * batch[j].w && count < MAX_LIGHTS) found[count++] = base + j;
+		}
+		barrier();
+	}
+	if (!valid) return;
+
+	// a full index list leaves the remaining clusters unlit for the frame rather than writing past it
+	uint offset = atomicAdd(lightIndexCount, count);
+	count = offset < uClusterCounts.y ? min(count, uClusterCounts.y - offset) : 0;
+	for (uint i = 0; i < count; i++) lightIndices[offset + i] = found[i];
+	lightGrid[cluster] = uvec2(offset, count);
+}
@@ -0,0 +1,28 @@
+#version 430 core
+
+#type vertex
+void main() {
+	// one triangle covering the screen
+	vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
+
+#type fragment
+// OIT_ACCUMULATION_UNIT and OIT_REVEALAGE_UNIT in oit.hpp
+layout(binding = 0) uniform sampler2D uAccumulation;
+layout(binding = 1) uniform sampler2D uRevealage;
+
+out vec4 outColor;
+
+void main() {
+	ivec2 p = ivec2(gl_FragCoord.xy);
+	float revealage = texelFetch(uRevealage, p, 0).r;
+	// nothing blended here
+	if (revealage >= 1.0) discard;
+
+	vec4 accumulation = texelFetch(uAccumulation, p, 0);
+	// many bright layers can overflow half floats
+	if (any(isinf(accumulation.rgb))) accumulation.rgb = vec3(accumulation.a);
+	vec3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+	outColor = vec4(average, revealage);
+}
@@ -0,0 +1,155 @@
+#include "asset_streamer.hpp"
+#include "profiler.hpp"
+#include "mapped_file.hpp"
+
+#include <spdlog/spdlog.h>
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+// touch one byte per page so the GL thread's copies do not stall on disk reads
+static uint8_t pageIn(const MappedFile* file) {
+	constexpr size_t PAGE = 4096;
+	uint8_t sum = 0;
+	for (size_t i = 0; i < file->size; i += PAGE) sum ^= reinterpret_cast<const volatile uint8_t*>(file->data)[i];
+	return sum;
+}
+
+static void readScene(StreamedScene* scene) {
+	scene->state.store(StreamState::Reading, std::memory_order_release);
+	try {
+		scene->file = mapFile(scene->path);
+		readSceneAsset(scene->file, scene->path, &scene->view);
+		pageIn(scene->file);
+	}
+	catch (const std::exception&) {
+		if (scene->file != nullptr) unmapFile(scene->file);
+		scene->file = nullptr;
+		scene->state.store(StreamState::Failed, std::memory_order_release);
+	}
+}
+
+static void workerLoop(AssetStreamer* streamer) {
+	while (true) {
+		StreamedScene* scene;
+		{
+			std::unique_lock<std::mutex> lock(streamer->mutex);
+			streamer->wake.wait(lock, [streamer] { return streamer->stopping || !streamer->requests.empty(); });
+			if (streamer->stopping) return;
+			scene = streamer->requests.front();
+			streamer->requests.pop_front();
+		}
+
+		readScene(scene);
+		if (scene->state.load(std::memory_order_acquire) == StreamState::Failed) continue;
+
+		std::lock_guard<std::mutex> lock(streamer->mutex);
+		streamer->read.push_back(scene);
+	}
+}
+
+AssetStreamer* createAssetStreamer(uint32_t workerCount, size_t stagingSize) {
+	AssetStreamer* streamer = new AssetStreamer();
+	streamer->staging = createStagingRing(stagingSize);
+	for (uint32_t i = 0; i < std::max(workerCount, 1u); i++) {
+		streamer->workers.emplace_back(workerLoop, streamer);
+	}
+	return streamer;
+}
+
+void destroyAssetStreamer(AssetStreamer* streamer) {
+	{
+		std::lock_guard<std::mutex> lock(streamer->mutex);
+		streamer->stopping = true;
+	}
+	streamer->wake.notify_all();
+	for (std::thread& worker : streamer->workers) worker.join();
+
+	// resident scenes own their pool through the asset, in-flight ones only have the pool
+	for (StreamedScene* scene : streamer->all) {
+		if (scene->file != nullptr) unmapFile(scene->file);
+		if (scene->asset != nullptr) destroySceneAsset(scene->asset);
+		else if (scene->pool != nullptr) destroyGeometryPool(scene->pool);
+		delete scene;
+	}
+	destroyStagingRing(streamer->staging);
+	delete streamer;
+}
+
+StreamedScene* streamSceneAsset(AssetStreamer* streamer, const std::string& path) {
+	StreamedScene* scene = new StreamedScene();
+	scene->path = path;
+	streamer->all.push_back(scene);
+	{
+		std::lock_guard<std::mutex> lock(streamer->mutex);
+		streamer->requests.push_back(scene);
+	}
+	streamer->wake.notify_one();
+	return scene;
+}
+
+// copies as much of src as the budget and the ring allow, returns false once either runs out
+static bool uploadBlob(AssetStreamer* streamer, const uint8_t* src, size_t size, size_t* copied, uint32_t dst, size_t* budget) {
+	while (*copied < size) {
+		size_t chunk = std::min({ size - *copied, *budget, stagingContiguousFree(streamer->staging) });
+		if (chunk == 0) return false;
+
+		StagingAllocation staging = allocateStaging(streamer->staging, chunk);
+		if (staging.data == nullptr) return false;
+		std::memcpy(staging.data, src + *copied, chunk);
+		countUpload(chunk);
+		glCopyNamedBufferSubData(streamer->staging->handle, dst, static_cast<GLintptr>(staging.offset), static_cast<GLintptr>(*copied), static_cast<GLsizeiptr>(chunk));
+
+		*copied += chunk;
+		*budget -= chunk;
+	}
+	return true;
+}
+
+static void finishScene(StreamedScene* scene) {
+	const SceneAssetHeader& header = scene->view.header;
+	scene->pool->vertexCount = header.vertexCount;
+	scene->pool->indexCount = header.indexCount;
+	scene->asset = createSceneAsset(scene->view, scene->pool);
+
+	unmapFile(scene->file);
+	scene->file = nullptr;
+	// copies already issued are ordered before any draw that follows, so the asset is usable right away
+	scene->state.store(StreamState::Resident, std::memory_order_release);
+	spdlog::info("Streamed scene asset {}: {} meshes, {} vertices", scene->path, header.meshCount, header.vertexCount);
+}
+
+void pumpAssetStreamer(AssetStreamer* streamer) {
+	retireStaging(streamer->staging);
+
+	{
+		std::lock_guard<std::mutex> lock(streamer->mutex);
+		for (StreamedScene* scene : streamer->read) {
+			// the pool is sized exactly, the blobs are copied into it in place
+			const SceneAssetHeader& header = scene->view.header;
+			scene->pool = createGeometryPool(*scene->view.layout, header.indexType, header.vertexCount, header.indexCount);
+			scene->state.store(StreamState::Uploading, std::memory_order_release);
+			streamer->uploads.push_back(scene);
+		}
+		streamer->read.clear();
+	}
+
+	size_t budget = streamer->uploadBudget;
+	while (!streamer->uploads.empty()) {
+		StreamedScene* scene = streamer->uploads.front();
+		const SceneAssetView& view = scene->view;
+		size_t vertexBytes = static_cast<size_t>(view.header.vertexCount) * view.layout->stride;
+		size_t positionBytes = static_cast<size_t>(view.header.vertexCount) * view.positionStride;
+		size_t indexBytes = static_cast<size_t>(view.header.indexCount) * view.indexSize;
+
+		if (!uploadBlob(streamer, view.vertices, vertexBytes, &scene->vertexBytesCopied, scene->pool->vbo, &budget)) break;
+		if (!uploadBlob(streamer, view.positions, positionBytes, &scene->positionBytesCopied, scene->pool->positionVbo, &budget)) break;
+		if (!uploadBlob(streamer, view.indices, indexBytes, &scene->indexBytesCopied, scene->pool->ibo, &budget)) break;
+
+		finishScene(scene);
+		streamer->uploads.pop_front();
+	}
+
+	fenceStaging(streamer->staging);
+}
@@ -0,0 +1,312 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <cmath>
+
+static Aabb combine(const Aabb& a, const Aabb& b) {
+	return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+static bool contains(const Aabb& outer, const Aabb& inner) {
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+		&& outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+// half the surface area, the insertion cost heuristic only compares these
+static float area(const Aabb& box) {
+	glm::vec3 d = box.max - box.min;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static bool isLeaf(const BvhNode& node) {
+	return node.left == BVH_NULL;
+}
+
+static int32_t allocateNode(Bvh* bvh) {
+	if (bvh->freeList == BVH_NULL) {
+		bvh->nodes.emplace_back();
+		return static_cast<int32_t>(bvh->nodes.size() - 1);
+	}
+	int32_t node = bvh->freeList;
+	bvh->freeList = bvh->nodes[node].parent;
+	bvh->nodes[node] = BvhNode{};
+	return node;
+}
+
+static void freeNode(Bvh* bvh, int32_t node) {
+	bvh->nodes[node].parent = bvh->freeList;
+	bvh->nodes[node].height = -1;
+	bvh->freeList = node;
+}
+
+static void refit(Bvh* bvh, int32_t index) {
+	BvhNode& node = bvh->nodes[index];
+	const BvhNode& l = bvh->nodes[node.left];
+	const BvhNode& r = bvh->nodes[node.right];
+	node.fat = combine(l.fat, r.fat);
+	node.height = 1 + std::max(l.height, r.height);
+}
+
+static void replaceChild(Bvh* bvh, int32_t parent, int32_t oldChild, int32_t newChild) {
+	if (parent == BVH_NULL) {
+		bvh->root = newChild;
+		return;
+	}
+	BvhNode& p = bvh->nodes[parent];
+	if (p.left == oldChild) p.left = newChild;
+	else p.right = newChild;
+}
+
+// lifts the taller grandchild when the children of `a` differ in height by more than one
+static int32_t rotate(Bvh* bvh, int32_t a) {
+	std::vector<BvhNode>& n = bvh->nodes;
+	if (isLeaf(n[a]) || n[a].height < 2) return a;
+
+	int32_t b = n[a].left, c = n[a].right;
+	int32_t balance = n[c].height - n[b].height;
+	if (balance >= -1 && balance <= 1) return a;
+
+	// `up` takes a's place, `stay` remains a's child
+	int32_t up = balance > 1 ? c : b;
+	int32_t stay = balance > 1 ? b : c;
+	int32_t f = n[up].left, g = n[up].right;
+
+	n[up].parent = n[a].parent;
+	replaceChild(bvh, n[a].parent, a, up);
+	n[a].parent = up;
+
+	// the taller grandchild stays under `up`, the other moves to a
+	int32_t keep = n[f].height > n[g].height ? f : g;
+	int32_t move = keep == f ? g : f;
+
+	n[up].left = a;
+	n[up].right = keep;
+	if (balance > 1) n[a].right = move;
+	else n[a].left = move;
+	n[move].parent = a;
+
+	n[a].fat = combine(n[stay].fat, n[move].fat);
+	n[a].height = 1 + std::max(n[stay].height, n[move].height);
+	n[up].fat = combine(n[a].fat, n[keep].fat);
+	n[up].height = 1 + std::max(n[a].height, n[keep].height);
+	return up;
+}
+
+static void walkUp(Bvh* bvh, int32_t index) {
+	while (index != BVH_NULL) {
+		index = rotate(bvh, index);
+		refit(bvh, index);
+		index = bvh->nodes[index].parent;
+	}
+}
+
+static void insertLeaf(Bvh* bvh, int32_t leaf) {
+	if (bvh->root == BVH_NULL) {
+		bvh->root = leaf;
+		bvh->nodes[leaf].parent = BVH_NULL;
+		return;
+	}
+
+	// descend towards the sibling that grows the total surface area the least
+	Aabb box = bvh->nodes[leaf].fat;
+	int32_t index = bvh->root;
+	while (!isLeaf(bvh->nodes[index])) {
+		const BvhNode& node = bvh->nodes[index];
+		float combinedArea = area(combine(node.fat, box));
+		float cost = 2.0f * combinedArea;
+		float inheritance = 2.0f * (combinedArea - area(node.fat));
+
+		auto childCost = [&](int32_t child) {
+			const BvhNode& c = bvh->nodes[child];
+			float grown = area(combine(box, c.fat));
+			return (isLeaf(c) ? grown : grown - area(c.fat)) + inheritance;
+		};
+		float costLeft = childCost(node.left);
+		float costRight = childCost(node.right);
+
+		if (cost < costLeft && cost < costRight) break;
+		index = costLeft < costRight ? node.left : node.right;
+	}
+
+	int32_t sibling = index;
+	int32_t oldParent = bvh->nodes[sibling].parent;
+	int32_t newParent = allocateNode(bvh);
+
+	BvhNode& p = bvh->nodes[newParent];
+	p.parent = oldParent;
+	p.left = sibling;
+	p.right = leaf;
+	replaceChild(bvh, oldParent, sibling, newParent);
+	bvh->nodes[sibling].parent = newParent;
+	bvh->nodes[leaf].parent = newParent;
+
+	walkUp(bvh, newParent);
+}
+
+static void removeLeaf(Bvh* bvh, int32_t leaf) {
+	if (leaf == bvh->root) {
+		bvh->root = BVH_NULL;
+		return;
+	}
+
+	int32_t parent = bvh->nodes[leaf].parent;
+	int32_t grandParent = bvh->nodes[parent].parent;
+	int32_t sibling = bvh->nodes[parent].left == leaf ? bvh->nodes[parent].right : bvh->nodes[parent].left;
+
+	replaceChild(bvh, grandParent, parent, sibling);
+	bvh->nodes[sibling].parent = grandParent;
+	freeNode(bvh, parent);
+
+	walkUp(bvh, grandParent);
+}
+
+static Aabb fatten(const Bvh* bvh, const Aabb& box) {
+	glm::vec3 m(bvh->margin);
+	return { box.min - m, box.max + m };
+}
+
+int32_t insertBvhLeaf(Bvh* bvh, const Aabb& box, uint32_t value) {
+	int32_t leaf = allocateNode(bvh);
+	BvhNode& node = bvh->nodes[leaf];
+	node.tight = box;
+	node.fat = fatten(bvh, box);
+	node.value = value;
+	insertLeaf(bvh, leaf);
+	bvh->leafCount++;
+	return leaf;
+}
+
+void removeBvhLeaf(Bvh* bvh, int32_t leaf) {
+	removeLeaf(bvh, leaf);
+	freeNode(bvh, leaf);
+	bvh->leafCount--;
+}
+
+bool moveBvhLeaf(Bvh* bvh, int32_t leaf, const Aabb& box) {
+	bvh->nodes[leaf].tight = box;
+	if (contains(bvh->nodes[leaf].fat, box)) return false;
+
+	removeLeaf(bvh, leaf);
+	bvh->nodes[leaf].fat = fatten(bvh, box);
+	insertLeaf(bvh, leaf);
+	return true;
+}
+
+static void collectLeaves(const Bvh* bvh, int32_t index, std::vector<int32_t>& stack, std::vector<uint32_t>& out) {
+	size_t base = stack.size();
+	stack.push_back(index);
+	while (stack.size() > base) {
+		const BvhNode& node = bvh->nodes[stack.back()];
+		stack.pop_back();
+		if (isLeaf(node)) {
+			out.push_back(node.value);
+			continue;
+		}
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+}
+
+void queryBvhFrustum(const Bvh* bvh, const Frustum& frustum, std::vector<uint32_t>& out) {
+	if (bvh->root == BVH_NULL) return;
+
+	std::vector<int32_t> stack{ bvh->root };
+	while (!stack.empty()) {
+		int32_t index = stack.back();
+		stack.pop_back();
+		const BvhNode& node = bvh->nodes[index];
+
+		if (isLeaf(node)) {
+			if (aabbInFrustum(frustum, node.tight)) out.push_back(node.value);
+			continue;
+		}
+
+		FrustumOverlap overlap = classifyAabb(frustum, node.fat);
+		if (overlap == FrustumOverlap::Outside) continue;
+		if (overlap == FrustumOverlap::Inside) {
+			// nothing below can be outside, skip the plane tests for the whole subtree
+			collectLeaves(bvh, index, stack, out);
+			continue;
+		}
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+}
+
+// slab test, entry distance of the ray into the box or a negative value on a miss
+static float rayEntry(const Aabb& box, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance) {
+	float tMin = 0.0f, tMax = maxDistance;
+	for (int a = 0; a < 3; a++) {
+		float t0 = (box.min[a] - origin[a]) * invDirection[a];
+		float t1 = (box.max[a] - origin[a]) * invDirection[a];
+		if (t0 > t1) std::swap(t0, t1);
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+		if (tMin > tMax) return -1.0f;
+	}
+	return tMin;
+}
+
+bool raycastBvh(const Bvh* bvh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhHit* hit) {
+	if (bvh->root == BVH_NULL) return false;
+
+	// a zero component becomes infinity and the slab test still works
+	glm::vec3 inv(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float best = maxDistance;
+	bool found = false;
+
+	std::vector<int32_t> stack{ bvh->root };
+	while (!stack.empty()) {
+		const BvhNode& node = bvh->nodes[stack.back()];
+		stack.pop_back();
+
+		float t = rayEntry(isLeaf(node) ? node.tight : node.fat, origin, inv, best);
+		if (t < 0.0f) continue;
+
+		if (isLeaf(node)) {
+			best = t;
+			*hit = { node.value, t };
+			found = true;
+			continue;
+		}
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+	return found;
+}
+
+static float distance2(const Aabb& box, const glm::vec3& point) {
+	glm::vec3 d = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.0f));
+	return glm::dot(d, d);
+}
+
+void nearestBvh(const Bvh* bvh, const glm::vec3& point, size_t k, std::vector<BvhHit>& out) {
+	if (bvh->root == BVH_NULL || k == 0) return;
+
+	// best first, nodes are keyed by a lower bound and leaves by their exact box distance,
+	// so leaves leave the queue in order of distance
+	using Entry = std::pair<float, int32_t>;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+	const BvhNode& root = bvh->nodes[bvh->root];
+	open.push({ distance2(isLeaf(root) ? root.tight : root.fat, point), bvh->root });
+
+	size_t found = 0;
+	while (!open.empty() && found < k) {
+		auto [d2, index] = open.top();
+		open.pop();
+		const BvhNode& node = bvh->nodes[index];
+
+		if (isLeaf(node)) {
+			out.push_back({ node.value, std::sqrt(d2) });
+			found++;
+			continue;
+		}
+
+		for (int32_t child : { node.left, node.right }) {
+			const BvhNode& c = bvh->nodes[child];
+			open.push({ distance2(isLeaf(c) ? c.tight : c.fat, point), child });
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#include "clustered_lighting.hpp"
+#include "gl_state.hpp"
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// invocations per workgroup of light_cluster.glsl, also the lights it stages in shared memory per batch
+constexpr uint32_t CLUSTER_WORKGROUP_SIZE = 128;
+
+static uint32_t createStorage(size_t size) {
+	uint32_t buffer;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, static_cast<GLsizeiptr>(size), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	return buffer;
+}
+
+ClusteredLighting* createClusteredLighting(ShaderProgram* assignProgram) {
+	ClusteredLighting* lighting = new ClusteredLighting();
+	lighting->assignProgram = assignProgram;
+
+	lighting->lightCapacity = 1024;
+	lighting->lightBuffer = createStorage(lighting->lightCapacity * sizeof(PointLight));
+	lighting->paramsBuffer = createStorage(sizeof(ClusterParams));
+
+	lighting->indexCapacity = CLUSTER_COUNT * CLUSTER_AVERAGE_LIGHTS;
+	lighting->gridBuffer = createStorage(CLUSTER_COUNT * sizeof(glm::uvec2));
+	lighting->indexBuffer = createStorage(lighting->indexCapacity * sizeof(uint32_t));
+	lighting->counterBuffer = createStorage(sizeof(uint32_t));
+	return lighting;
+}
+
+static void bindLights(ClusteredLighting* lighting) {
+	size_t bytes = lighting->lights.size() * sizeof(PointLight);
+	countUpload(bytes);
+	if (lighting->transient != nullptr && bytes > 0) {
+		TransientAllocation alloc = allocateTransient(lighting->transient, bytes, lighting->transient->storageAlignment);
+		if (alloc.data != nullptr) {
+			memcpy(alloc.data, lighting->lights.data(), bytes);
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, lighting->transient->handle, static_cast<GLintptr>(alloc.offset), static_cast<GLsizeiptr>(bytes));
+			return;
+		}
+	}
+
+	// a full transient region falls back to the buffer of our own, synchronised like any subdata update
+	uint32_t n = static_cast<uint32_t>(lighting->lights.size());
+	if (n > lighting->lightCapacity) {
+		glDeleteBuffers(1, &lighting->lightBuffer);
+		lighting->lightCapacity = std::max(n, lighting->lightCapacity * 2);
+		lighting->lightBuffer = createStorage(lighting->lightCapacity * sizeof(PointLight));
+	}
+	if (bytes > 0) glNamedBufferSubData(lighting->lightBuffer, 0, static_cast<GLsizeiptr>(bytes), lighting->lights.data());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, lighting->lightBuffer);
+}
+
+void updateClusteredLighting(ClusteredLighting* lighting, Camera* camera, glm::ivec2 framebufferSize) {
+	PROFILE_SCOPE("light clusters");
+	glm::ivec2 size(std::max(framebufferSize.x, 1), std::max(framebufferSize.y, 1));
+	glm::mat4 projection = calcProjectionMatrix(camera);
+	float nearPlane = camera->nearPlane;
+	float farPlane = std::max(camera->farPlane, nearPlane * 2.0f);
+
+	// slice = log(depth / near) / log(far / near) * slices
+	ClusterParams& params = lighting->params;
+	float sliceScale = static_cast<float>(CLUSTER_GRID_Z) / std::log(farPlane / nearPlane);
+	params.grid = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0);
+	params.counts = glm::uvec4(static_cast<uint32_t>(lighting->lights.size()), lighting->indexCapacity, 0, 0);
+	params.scale = glm::vec4(static_cast<float>(CLUSTER_GRID_X) / size.x, static_cast<float>(CLUSTER_GRID_Y) / size.y, sliceScale, -std::log(nearPlane) * sliceScale);
+	params.depth = glm::vec4(nearPlane, farPlane, 1.0f / projection[0][0], 1.0f / projection[1][1]);
+	params.ambient = glm::vec4(lighting->ambient, 0.0f);
+
+	if (lighting->transient != nullptr) bindTransientUniforms(lighting->transient, CLUSTER_PARAMS_BINDING, &params, sizeof(params));
+	else {
+		glNamedBufferSubData(lighting->paramsBuffer, 0, sizeof(params), &params);
+		countUpload(sizeof(params));
+		glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_PARAMS_BINDING, lighting->paramsBuffer);
+	}
+	bindLights(lighting);
+
+	glClearNamedBufferData(lighting->counterBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_BINDING, lighting->indexBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_GRID_BINDING, lighting->gridBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_COUNTER_BINDING, lighting->counterBuffer);
+
+	bindProgram(&glState, lighting->assignProgram->handle);
+	glDispatchCompute((CLUSTER_COUNT + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE, 1, 1);
+	// the shading passes read the lists as storage buffers
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
@@ -0,0 +1,157 @@
+#include "culling.hpp"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+HiZBuffer* createHiZBuffer() {
+	HiZBuffer* hiz = new HiZBuffer();
+	glCreateBuffers(HIZ_READBACK_FRAMES, hiz->pbos.data());
+	return hiz;
+}
+
+void captureHiZ(HiZBuffer* hiz, glm::ivec2 size, const glm::mat4& viewProjection, bool reversedZ) {
+	if (size.x <= 0 || size.y <= 0) return;
+
+	uint32_t slot = hiz->next;
+	hiz->next = (hiz->next + 1) % HIZ_READBACK_FRAMES;
+
+	// a readback that was never picked up is simply dropped
+	if (hiz->fences[slot] != nullptr) glDeleteSync(hiz->fences[slot]);
+
+	if (hiz->sizes[slot] != size) {
+		glNamedBufferData(hiz->pbos[slot], static_cast<size_t>(size.x) * size.y * sizeof(float), nullptr, GL_STREAM_READ);
+		hiz->sizes[slot] = size;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, hiz->pbos[slot]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, size.x, size.y, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	hiz->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	hiz->viewProjections[slot] = viewProjection;
+	hiz->reversed[slot] = reversedZ;
+	hiz->serials[slot] = ++hiz->serial;
+}
+
+static void buildPyramid(HiZBuffer* hiz, const float* depth, glm::ivec2 size, bool reversedZ) {
+	hiz->levelSizes.clear();
+	hiz->levelSizes.push_back(size);
+	while (hiz->levelSizes.back() != glm::ivec2(1, 1)) {
+		glm::ivec2 s = hiz->levelSizes.back();
+		hiz->levelSizes.push_back({ std::max(1, (s.x + 1) / 2), std::max(1, (s.y + 1) / 2) });
+	}
+
+	hiz->levels.resize(hiz->levelSizes.size());
+	hiz->levels[0].assign(depth, depth + static_cast<size_t>(size.x) * size.y);
+
+	for (size_t l = 1; l < hiz->levels.size(); l++) {
+		glm::ivec2 src = hiz->levelSizes[l - 1], dst = hiz->levelSizes[l];
+		const std::vector<float>& below = hiz->levels[l - 1];
+		std::vector<float>& level = hiz->levels[l];
+		level.resize(static_cast<size_t>(dst.x) * dst.y);
+
+		for (int y = 0; y < dst.y; y++) {
+			int y0 = 2 * y, y1 = std::min(2 * y + 1, src.y - 1);
+			for (int x = 0; x < dst.x; x++) {
+				int x0 = 2 * x, x1 = std::min(2 * x + 1, src.x - 1);
+				float a = below[y0 * src.x + x0], b = below[y0 * src.x + x1], c = below[y1 * src.x + x0], d = below[y1 * src.x + x1];
+				level[y * dst.x + x] = reversedZ ? std::min(std::min(a, b), std::min(c, d)) : std::max(std::max(a, b), std::max(c, d));
+			}
+		}
+	}
+}
+
+void updateHiZ(HiZBuffer* hiz) {
+	int newest = -1;
+	for (uint32_t i = 0; i < HIZ_READBACK_FRAMES; i++) {
+		if (hiz->fences[i] == nullptr) continue;
+
+		GLenum r = glClientWaitSync(hiz->fences[i], 0, 0);
+		if (r != GL_ALREADY_SIGNALED && r != GL_CONDITION_SATISFIED) continue;
+		if (newest < 0 || hiz->serials[i] > hiz->serials[newest]) newest = static_cast<int>(i);
+	}
+	if (newest < 0) return;
+
+	// anything older than the one used is stale now
+	for (uint32_t i = 0; i < HIZ_READBACK_FRAMES; i++) {
+		if (hiz->fences[i] != nullptr && hiz->serials[i] <= hiz->serials[newest]) {
+			glDeleteSync(hiz->fences[i]);
+			hiz->fences[i] = nullptr;
+		}
+	}
+
+	glm::ivec2 size = hiz->sizes[newest];
+	size_t bytes = static_cast<size_t>(size.x) * size.y * sizeof(float);
+	const float* depth = static_cast<const float*>(glMapNamedBufferRange(hiz->pbos[newest], 0, bytes, GL_MAP_READ_BIT));
+	if (depth == nullptr) return;
+
+	buildPyramid(hiz, depth, size, hiz->reversed[newest]);
+	glUnmapNamedBuffer(hiz->pbos[newest]);
+
+	hiz->viewProjection = hiz->viewProjections[newest];
+	hiz->reversedZ = hiz->reversed[newest];
+	hiz->valid = true;
+}
+
+bool aabbOccluded(const HiZBuffer* hiz, const Aabb& box) {
+	if (!hiz->valid) return false;
+
+	glm::vec2 lo(1.0f), hi(-1.0f);
+	// window depth, reversed-Z captures use a 0..1 clip range where nearer is larger
+	float nearest = hiz->reversedZ ? 0.0f : 1.0f;
+	for (int c = 0; c < 8; c++) {
+		glm::vec3 corner(c & 1 ? box.max.x : box.min.x, c & 2 ? box.max.y : box.min.y, c & 4 ? box.max.z : box.min.z);
+		glm::vec4 clip = hiz->viewProjection * glm::vec4(corner, 1.0f);
+
+		// crosses the near plane, the projected rect is meaningless
+		if (clip.w <= 1e-5f) return false;
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		lo = glm::min(lo, glm::vec2(ndc));
+		hi = glm::max(hi, glm::vec2(ndc));
+		nearest = hiz->reversedZ ? std::max(nearest, ndc.z) : std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+
+	glm::ivec2 size = hiz->levelSizes[0];
+	float depth = nearest;
+	int x0 = std::clamp(static_cast<int>((lo.x * 0.5f + 0.5f) * size.x), 0, size.x - 1);
+	int x1 = std::clamp(static_cast<int>((hi.x * 0.5f + 0.5f) * size.x), 0, size.x - 1);
+	int y0 = std::clamp(static_cast<int>((lo.y * 0.5f + 0.5f) * size.y), 0, size.y - 1);
+	int y1 = std::clamp(static_cast<int>((hi.y * 0.5f + 0.5f) * size.y), 0, size.y - 1);
+
+	// the level where the rect spans about 2x2 texels
+	int extent = std::max(x1 - x0, y1 - y0);
+	size_t level = 0;
+	while ((extent >> level) > 1 && level + 1 < hiz->levels.size()) level++;
+
+	const std::vector<float>& texels = hiz->levels[level];
+	int w = hiz->levelSizes[level].x;
+	for (int y = y0 >> level; y <= (y1 >> level); y++) {
+		for (int x = x0 >> level; x <= (x1 >> level); x++) {
+			// in front of the farthest occluder of the texel
+			if (hiz->reversedZ ? depth >= texels[y * w + x] : depth <= texels[y * w + x]) return false;
+		}
+	}
+	return true;
+}
+
+void beginCulling(Culler* culler, const glm::mat4& viewProjection, bool reversedZ) {
+	culler->frustum = extractFrustum(viewProjection, reversedZ);
+	culler->stats = {};
+}
+
+bool cullBounds(Culler* culler, const Aabb& box) {
+	culler->stats.tested++;
+	if (!aabbInFrustum(culler->frustum, box)) {
+		culler->stats.frustumRejected++;
+		return true;
+	}
+	if (culler->hiz != nullptr && aabbOccluded(culler->hiz, box)) {
+		culler->stats.occlusionRejected++;
+		return true;
+	}
+	return false;
+}
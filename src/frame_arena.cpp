@@ -0,0 +1,42 @@
+#include "frame_arena.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+FrameArena frameArena;
+
+void* allocateFrame(FrameArena* arena, size_t size, size_t alignment) {
+	if (arena->block == nullptr) {
+		arena->capacity = std::max(arena->capacity, FRAME_ARENA_SIZE);
+		arena->block.reset(new std::byte[arena->capacity]);
+	}
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(arena->block.get());
+	size_t offset = ((base + arena->used + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1)) - base;
+	if (offset + size <= arena->capacity) {
+		arena->used = offset + size;
+		return arena->block.get() + offset;
+	}
+
+	// new[] only aligns to max_align_t, over-allocate for anything stricter
+	size_t padded = size + (alignment > alignof(std::max_align_t) ? alignment : 0);
+	std::byte* block = arena->overflow.emplace_back(new std::byte[std::max<size_t>(padded, 1)]).get();
+	arena->overflowBytes += padded;
+	uintptr_t p = reinterpret_cast<uintptr_t>(block);
+	return block + (((p + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1)) - p);
+}
+
+void resetFrameArena(FrameArena* arena) {
+	size_t total = arena->used + arena->overflowBytes;
+	arena->peak = std::max(arena->peak, total);
+	arena->used = 0;
+	if (arena->overflowBytes == 0) return;
+
+	// the old block is only dropped here, nothing allocated from it is alive any more
+	size_t capacity = std::max(arena->capacity * 2, total);
+	spdlog::warn("Frame arena overflowed by {} bytes, growing it to {} bytes", arena->overflowBytes, capacity);
+	arena->overflow.clear();
+	arena->overflowBytes = 0;
+	arena->capacity = capacity;
+	arena->block.reset(new std::byte[capacity]);
+}
@@ -0,0 +1,45 @@
+#include "frame_constants.hpp"
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+
+FrameConstantsBuffer* createFrameConstantsBuffer() {
+	FrameConstantsBuffer* buffer = new FrameConstantsBuffer();
+	glCreateBuffers(1, &buffer->handle);
+	glNamedBufferStorage(buffer->handle, sizeof(FrameConstants), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, buffer->handle);
+	return buffer;
+}
+
+void updateFrameConstants(FrameConstantsBuffer* buffer, Camera* camera, glm::ivec2 framebufferSize, double time, double delta, uint64_t frame) {
+	// a minimised window reports 0x0, keep the last aspect rather than dividing by zero
+	if (framebufferSize.x > 0 && framebufferSize.y > 0) {
+		camera->aspect = static_cast<float>(framebufferSize.x) / static_cast<float>(framebufferSize.y);
+	}
+
+	FrameConstants& fc = buffer->data;
+	fc.view = calcViewMatrix(camera);
+	fc.projection = calcProjectionMatrix(camera);
+	fc.viewProjection = fc.projection * fc.view;
+	fc.cameraPosition = glm::vec4(camera->position, 1.0f);
+	fc.time = glm::vec4(static_cast<float>(time), static_cast<float>(delta), static_cast<float>(frame), 0.0f);
+	fc.depthParams = glm::vec4(camera->nearPlane, camera->reversedZ ? 0.0f : camera->farPlane, camera->reversedZ ? 1.0f : 0.0f, 0.0f);
+
+	if (buffer->transient != nullptr) {
+		bindTransientUniforms(buffer->transient, FRAME_CONSTANTS_BINDING, &fc, sizeof(FrameConstants));
+		return;
+	}
+	glNamedBufferSubData(buffer->handle, 0, sizeof(FrameConstants), &fc);
+	countUpload(sizeof(FrameConstants));
+}
+
+void bindFrameConstants(uint32_t program, const UniformTable* uniforms) {
+	const UniformBlockInfo* block = findUniformBlock(uniforms, "FrameConstants");
+	if (block != nullptr) {
+		glUniformBlockBinding(program, block->index, FRAME_CONSTANTS_BINDING);
+	}
+	block = findUniformBlock(uniforms, "DrawConstants");
+	if (block != nullptr) {
+		glUniformBlockBinding(program, block->index, DRAW_CONSTANTS_BINDING);
+	}
+}
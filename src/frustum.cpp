@@ -0,0 +1,70 @@
+#include "frustum.hpp"
+
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+#include <cmath>
+
+Frustum extractFrustum(const glm::mat4& viewProjection, bool reversedZ) {
+	// Gribb/Hartmann: combine the rows of the clip matrix, glm is column major
+	const glm::mat4& m = viewProjection;
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Frustum f;
+	f.planes[0] = row3 + row0; // left
+	f.planes[1] = row3 - row0; // right
+	f.planes[2] = row3 + row1; // bottom
+	f.planes[3] = row3 - row1; // top
+	if (reversedZ) {
+		// 0 <= z <= w with the near plane at z = w
+		f.planes[4] = row3 - row2; // near
+		f.planes[5] = row2; // far
+	}
+	else {
+		f.planes[4] = row3 + row2; // near
+		f.planes[5] = row3 - row2; // far
+	}
+
+	for (glm::vec4& p : f.planes) {
+		float length = glm::length(glm::vec3(p));
+		// an infinite far plane has no normal, it becomes one that rejects nothing
+		p = length > 0.0f ? p / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+	return f;
+}
+
+bool sphereInFrustum(const Frustum& frustum, const glm::vec4& sphere) {
+	glm::vec3 center(sphere);
+	for (const glm::vec4& p : frustum.planes) {
+		if (glm::dot(glm::vec3(p), center) + p.w < -sphere.w) return false;
+	}
+	return true;
+}
+
+bool aabbInFrustum(const Frustum& frustum, const Aabb& box) {
+	for (const glm::vec4& p : frustum.planes) {
+		// the corner furthest along the plane normal
+		glm::vec3 v(p.x >= 0.0f ? box.max.x : box.min.x, p.y >= 0.0f ? box.max.y : box.min.y, p.z >= 0.0f ? box.max.z : box.min.z);
+		if (glm::dot(glm::vec3(p), v) + p.w < 0.0f) return false;
+	}
+	return true;
+}
+
+FrustumOverlap classifyAabb(const Frustum& frustum, const Aabb& box) {
+	FrustumOverlap result = FrustumOverlap::Inside;
+	for (const glm::vec4& p : frustum.planes) {
+		glm::vec3 outer(p.x >= 0.0f ? box.max.x : box.min.x, p.y >= 0.0f ? box.max.y : box.min.y, p.z >= 0.0f ? box.max.z : box.min.z);
+		glm::vec3 inner(p.x >= 0.0f ? box.min.x : box.max.x, p.y >= 0.0f ? box.min.y : box.max.y, p.z >= 0.0f ? box.min.z : box.max.z);
+		if (glm::dot(glm::vec3(p), outer) + p.w < 0.0f) return FrustumOverlap::Outside;
+		if (glm::dot(glm::vec3(p), inner) + p.w < 0.0f) result = FrustumOverlap::Intersecting;
+	}
+	return result;
+}
+
+glm::vec4 transformSphere(const glm::mat4& model, const glm::vec4& sphere) {
+	glm::vec3 center(model * glm::vec4(glm::vec3(sphere), 1.0f));
+	float scale2 = std::max(glm::length2(glm::vec3(model[0])), std::max(glm::length2(glm::vec3(model[1])), glm::length2(glm::vec3(model[2]))));
+	return glm::vec4(center, sphere.w * std::sqrt(scale2));
+}
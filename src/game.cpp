@@ -1,3 +1,12 @@
+#include "game.hpp"
+#include "profiler.hpp"
+#include "gl_state.hpp"
+#include "frame_constants.hpp"
+#include "shader_cache.hpp"
+#include "shader_preprocessor.hpp"
+#include "object_pool.hpp"
+#include "vertex_layout.hpp"
+
 #include <spdlog/spdlog.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -5,6 +14,8 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <string>
@@ -13,40 +24,8 @@
 #include <tuple>
 #include <iostream>
 #include <set>
-
-struct Vertex {
-	glm::vec4 position;
-	glm::vec4 color;
-	glm::vec2 textureCoords;
-	glm::vec4 normals;
-};
-
-enum class PrimitiveFormat {
-	Triangles = GL_TRIANGLES,
-	TriangleFan = GL_TRIANGLE_FAN,
-	TriangleStrip = GL_TRIANGLE_STRIP,
-	Lines = GL_LINES,
-	LineStrip = GL_LINE_STRIP
-};
-
-struct Mesh {
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-	PrimitiveFormat primitiveFormat;
-
-	uint32_t vao, vbo, ibo;
-};
-
-struct Texture {
-	uint32_t handle;
-
-	glm::ivec2 size;
-
-};
-
-struct ShaderProgram {
-	uint32_t handle;
-};
+#include <filesystem>
+#include <cmath>
 
 std::string readFile(std::string name) {
 	std::ifstream f(name);
@@ -54,96 +33,18 @@ std::string readFile(std::string name) {
 	return str;
 }
 
-constexpr std::string s2lower(std::string str) {
-	std::transform(str.begin(), str.end(), str.begin(),
-		[](unsigned char c) { return std::tolower(c); });
-	return str;
-}
-
-uint32_t sTypeFromName(std::string name) {
-	std::string ln = s2lower(name);
-	if (ln == "vertex") return GL_VERTEX_SHADER;
-	if (ln == "fragment") return GL_FRAGMENT_SHADER;
-	if (ln == "compute") return GL_COMPUTE_SHADER;
-	if (ln == "geometry") return GL_GEOMETRY_SHADER;
-	if (ln == "tess-control") return GL_TESS_CONTROL_SHADER;
-	if (ln == "tess-evaluation") return GL_TESS_EVALUATION_SHADER;
-	spdlog::error("Unknown shader type {}", name);
-	throw std::runtime_error("Unknown shader type " + name);
-}
-
-bool isWhiteSpace(char c) {
-	if (c == ' ' || c == '\n' || c == '\r' || c == '\t') return true;
-	return false;
-}
-
-std::string lStripNewlines(std::string text) {
-	size_t i = 0;
-	char c = text[0];
-	while (isWhiteSpace(c)) {
-		c = text[++i];
-		if (i >= text.size()) return "";
-	}
-
-	return text.substr(i);
-}
-
-std::tuple<std::string, std::string> splitAt(std::string text, size_t i) {
-	if (i == 0) return std::make_tuple("", text.substr(1));
-	if (i == std::string::npos) return std::make_tuple(text, "");
-	if (i + 1 == text.size()) return std::make_tuple(text.substr(0, i), "");
-	if (i + 1 > text.size()) return std::make_tuple(text, "");
-	return std::make_tuple(text.substr(0, i), text.substr(i + 1));
-}
-
-std::tuple<std::string, std::string> splitOnFirst(std::string text, char c) {
-	size_t i = text.find_first_of(c);
-	return splitAt(text, i);
-}
-
-std::tuple<std::string, std::string> splitFirstLine(std::string text) {
-	return splitOnFirst(text, '\n');
-}
-
-std::string stripWhitespace(std::string str) {
-	size_t start = 0;
-	char c = str[start];
-	while (isWhiteSpace(c)) {
-		c = str[++start];
-		if (start >= str.size()) return "";
-	}
-	std::string rem = str.substr(start);
-	size_t end = rem.size() - 1;
-	c = rem[end];
-	while (isWhiteSpace(c)) {
-		c = rem[--end];
-		if (end == 0 || end >= rem.size()) return "";
-	}
-
-	return rem.substr(0, end + 1);
-}
-
-uint32_t createShader(std::string path) {
-	std::string srcuf = lStripNewlines(readFile(path));
-	/* expect that the first non-blank line is in format
-	#type <name>
-	*/
-
-
-	std::string l, src;
-	std::tie(l, src) = splitFirstLine(srcuf);
-
-	if (!l.starts_with("#type ")) { spdlog::error("Failed to read shader file {}. Missing a type header.", path); throw std::runtime_error("Failed to read shader " + path); }
-
-	std::string type = stripWhitespace(l.substr(6));
-	uint32_t stype = sTypeFromName(type);
-
+// only queues the compile, the status is checked when the program is completed
+static uint32_t compileShader(uint32_t stype, const std::string& src) {
 	uint32_t sh = glCreateShader(stype);
 	const char* ssrc_czs = src.c_str();
 	glShaderSource(sh, 1, &ssrc_czs, nullptr);
 	
 	glCompileShader(sh);
+	return sh;
+}
 
+// `files` are the stage's source strings, the log refers to them by index
+static void checkShader(uint32_t sh, std::span<const std::string> files) {
 	int i;
 	glGetShaderiv(sh, GL_COMPILE_STATUS, &i);
 	if (!i) {
@@ -151,30 +52,94 @@ uint32_t createShader(std::string path) {
 		char* ilog = new char[i];
 
 		glGetShaderInfoLog(sh, i, &i, ilog);
-		spdlog::error("Failed to compile shader {}!", path);
+		spdlog::error("Failed to compile shader {}!", files[0]);
+		for (size_t f = 1; f < files.size(); f++) spdlog::error("  source string {} is {}", f, files[f]);
 		std::cerr << ilog;
 
 		delete[i] ilog;
-		throw std::runtime_error("Failed to compile shader " + path);
+		throw std::runtime_error("Failed to compile shader " + files[0]);
 	}
+}
 
+uint32_t createShader(std::string path) {
+	std::vector<ShaderStageSource> stages;
+	preprocessShader(&shaderSources, path, {}, &stages);
+	if (stages.size() != 1) {
+		spdlog::error("Shader file {} has {} stages, expected one", path, stages.size());
+		throw std::runtime_error("Failed to read shader " + path);
+	}
+	uint32_t sh = compileShader(stages[0].stage, stages[0].source);
+	checkShader(sh, stages[0].files);
 	return sh;
 }
 
-ShaderProgram* createShaderProgram(std::initializer_list<std::string> files) {
+struct PendingProgram {
 	std::vector<uint32_t> shaders;
-	for (std::string p : files) {
-		shaders.push_back(createShader(p));
+	std::vector<std::vector<std::string>> files;
+	ProgramCacheKey key;
+};
+
+// every long-lived engine object of these types comes from here, see ObjectPool
+static ObjectPool<ShaderProgram> shaderProgramPool;
+static ObjectPool<Mesh> meshPool;
+static ObjectPool<Material> materialPool;
+static ObjectPool<GameObject> gameObjectPool;
+
+// everything the engine reads back from a linked program
+static void reflectShaderProgram(ShaderProgram* sp) {
+	uint32_t pr = sp->handle;
+	reflectProgram(pr, &sp->uniforms);
+	sp->builtins.color = uniformLocation(&sp->uniforms, "uColor");
+	sp->builtins.model = uniformLocation(&sp->uniforms, "uModel");
+	sp->builtins.lodFade = uniformLocation(&sp->uniforms, "uLodFade");
+	sp->builtins.drawConstants = findUniformBlock(&sp->uniforms, "DrawConstants") != nullptr;
+	sp->vertexInputs = reflectVertexInputs(pr);
+	bindFrameConstants(pr, &sp->uniforms);
+}
+
+ShaderProgram* requestShaderProgram(std::initializer_list<std::string> files, std::initializer_list<ShaderDefine> defines) {
+	std::span<const ShaderDefine> defs(defines.begin(), defines.size());
+	std::vector<ShaderStageSource> stages;
+	for (const std::string& p : files) preprocessShader(&shaderSources, p, defs, &stages);
+
+	PendingProgram* pending = new PendingProgram();
+	pending->key = beginProgramCacheKey();
+	for (const ShaderStageSource& stage : stages) hashProgramSource(&pending->key, stage.stage, stage.source);
+
+	ShaderProgram* sp = allocateObject(&shaderProgramPool);
+	sp->handle = glCreateProgram();
+	sp->variantKey = shaderVariantKey(std::span<const std::string>(files.begin(), files.size()), defs);
+	if (loadProgramBinary(sp->handle, pending->key)) {
+		delete pending;
+		reflectShaderProgram(sp);
+		return sp;
 	}
-	uint32_t pr = glCreateProgram();
-	for (uint32_t s : shaders) {
-		glAttachShader(pr, s);
+	// a rejected binary can leave the program in any state, start over with a fresh object
+	glDeleteProgram(sp->handle);
+	sp->handle = glCreateProgram();
+
+	for (ShaderStageSource& stage : stages) {
+		uint32_t s = compileShader(stage.stage, stage.source);
+		glAttachShader(sp->handle, s);
+		pending->shaders.push_back(s);
+		pending->files.push_back(std::move(stage.files));
 	}
+	glProgramParameteri(sp->handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(sp->handle);
+
+	sp->pending = pending;
+	return sp;
+}
 
-	glLinkProgram(pr);
+static void completeShaderProgram(ShaderProgram* sp) {
+	PendingProgram* pending = sp->pending;
+	uint32_t pr = sp->handle;
 	int i;
 	glGetProgramiv(pr, GL_LINK_STATUS, &i);
 	if (!i) {
+		// a stage that failed to compile explains more than the link log
+		for (size_t s = 0; s < pending->shaders.size(); s++) checkShader(pending->shaders[s], pending->files[s]);
+
 		glGetProgramiv(pr, GL_INFO_LOG_LENGTH, &i);
 		char* ilog = new char[i];
 
@@ -186,49 +151,115 @@ ShaderProgram* createShaderProgram(std::initializer_list<std::string> files) {
 		throw std::runtime_error("Failed to link program");
 	}
 	
-	for (uint32_t s : shaders) {
+	for (uint32_t s : pending->shaders) {
+		glDetachShader(pr, s);
 		glDeleteShader(s);
 	}
 
-	return new ShaderProgram{pr};
+	storeProgramBinary(pr, pending->key);
+	delete pending;
+	sp->pending = nullptr;
+	reflectShaderProgram(sp);
 }
 
-struct Material {
-	ShaderProgram* shader;
-	std::array<Texture*, 32> textures;
-	glm::vec4 color;
-};
+bool pollShaderProgram(ShaderProgram* sp) {
+	if (sp->pending == nullptr) return true;
+	if (parallelShaderCompileEnabled()) {
+		int done;
+		glGetProgramiv(sp->handle, GL_COMPLETION_STATUS_KHR, &done);
+		if (!done) return false;
+	}
+	completeShaderProgram(sp);
+	return true;
+}
 
-struct MeshRenderer {
-	Mesh* mesh;
-	Material* material;
-};
+void finishShaderProgram(ShaderProgram* sp) {
+	if (sp->pending != nullptr) completeShaderProgram(sp);
+}
 
-struct Transform {
-	glm::vec3 position{0.0f, 0.0f, 0.0f};
-	glm::fquat rotation = glm::quat_identity<float, glm::packed_highp>();
-	glm::vec3 scale{1.0f, 1.0f, 1.0f};
-};
+ShaderProgram* createShaderProgram(std::initializer_list<std::string> files, std::initializer_list<ShaderDefine> defines) {
+	ShaderProgram* sp = requestShaderProgram(files, defines);
+	finishShaderProgram(sp);
+	return sp;
+}
 
-struct GameObject {
-	MeshRenderer meshRenderer;
-	Transform transform;
-};
+void destroyShaderProgram(ShaderProgram* sp) {
+	if (sp->pending != nullptr) {
+		for (uint32_t s : sp->pending->shaders) glDeleteShader(s);
+		delete sp->pending;
+	}
+	// a recycled name must not be mistaken for the bound program
+	if (glState.program == sp->handle) glState.program = GL_STATE_UNKNOWN;
+	glDeleteProgram(sp->handle);
+	freeObject(&shaderProgramPool, sp);
+}
+
+void destroyShaderVariants(ShaderVariantTable* table) {
+	for (auto& [key, sp] : table->programs) destroyShaderProgram(sp);
+	table->programs.clear();
+}
+
+ShaderProgram* requestShaderVariant(ShaderVariantTable* table, std::initializer_list<std::string> files, std::initializer_list<ShaderDefine> defines) {
+	uint64_t key = shaderVariantKey(std::span<const std::string>(files.begin(), files.size()), std::span<const ShaderDefine>(defines.begin(), defines.size()));
+	ShaderProgram*& sp = table->programs[key];
+	if (sp == nullptr) sp = requestShaderProgram(files, defines);
+	return sp;
+}
+
+Mesh* allocateMesh() {
+	return allocateObject(&meshPool);
+}
+
+void destroyMesh(Mesh* mesh) {
+	freeObject(&meshPool, mesh);
+}
+
+Material* createMaterial(ShaderProgram* shader) {
+	Material* mat = allocateObject(&materialPool);
+	mat->shader = shader;
+	return mat;
+}
+
+void destroyMaterial(Material* mat) {
+	if (glState.material == mat) glState.material = nullptr;
+	freeObject(&materialPool, mat);
+}
 
 GameObject* createGameObject(Mesh* mesh, Material* material) {
-	GameObject* go = new GameObject();
+	GameObject* go = allocateObject(&gameObjectPool);
 
 	go->meshRenderer.mesh = mesh;
 	go->meshRenderer.material = material;
+	checkVertexLayout(mesh, material);
 	return go;
 }
 
-glm::mat4 rotate_m4(glm::mat4 mat, glm::fquat quat) {
-	return glm::toMat4(quat) * mat;
+void destroyGameObject(GameObject* go) {
+	freeObject(&gameObjectPool, go);
+}
+
+glm::mat4 composeTRS(const glm::vec3& translation, const glm::fquat& rotation, const glm::vec3& scale) {
+	// T * R * S written out directly, the rotation columns scaled and the translation in the last column
+	glm::mat3 r = glm::mat3_cast(rotation);
+	return glm::mat4(
+		glm::vec4(r[0] * scale.x, 0.0f),
+		glm::vec4(r[1] * scale.y, 0.0f),
+		glm::vec4(r[2] * scale.z, 0.0f),
+		glm::vec4(translation, 1.0f));
+}
+
+Aabb transformAabb(const glm::mat4& model, const Aabb& box) {
+	glm::vec3 center = glm::vec3(model * glm::vec4((box.min + box.max) * 0.5f, 1.0f));
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+	glm::vec3 worldExtent =
+		glm::abs(glm::vec3(model[0])) * extent.x +
+		glm::abs(glm::vec3(model[1])) * extent.y +
+		glm::abs(glm::vec3(model[2])) * extent.z;
+	return { center - worldExtent, center + worldExtent };
 }
 
 glm::mat4 createModelMatrix(const Transform& transform) {
-	return glm::translate(rotate_m4(glm::scale(glm::identity<glm::mat4>(), transform.scale), transform.rotation), transform.position);
+	return composeTRS(transform.position, transform.rotation, transform.scale);
 }
 
 glm::mat4 createModelMatrix(const Transform* transform) {
@@ -239,73 +270,152 @@ glm::mat4 createModelMatrix(const Transform* transform) {
 	return glm::identity<glm::mat4>();
 }
 
-Mesh* createMesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, PrimitiveFormat fmt) {
-
-	Mesh* mesh = new Mesh();
-	glCreateVertexArrays(1, &mesh->vao);
-	glCreateBuffers(2, &mesh->vbo); // assume that the struct is contiguous
-
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
-
-	glNamedBufferData(mesh->vbo, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-	glNamedBufferData(mesh->ibo, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
-
-	glVertexArrayAttribBinding(mesh->vao, 0, 0);
-	glVertexArrayAttribBinding(mesh->vao, 1, 0);
-	glVertexArrayAttribBinding(mesh->vao, 2, 0);
-	glVertexArrayAttribBinding(mesh->vao, 3, 0);
-	glVertexArrayAttribFormat(mesh->vao, 0, 4, GL_FLOAT, false, 0);
-	glVertexArrayAttribFormat(mesh->vao, 1, 4, GL_FLOAT, false, 4 * sizeof(float));
-	glVertexArrayAttribFormat(mesh->vao, 2, 2, GL_FLOAT, false, 8 * sizeof(float));
-	glVertexArrayAttribFormat(mesh->vao, 3, 4, GL_FLOAT, false, 10 * sizeof(float));
-	glVertexArrayVertexBuffer(mesh->vao, 0, mesh->vbo, 0, sizeof(Vertex));
-	glVertexArrayElementBuffer(mesh->vao, mesh->ibo);
-	glEnableVertexArrayAttrib(mesh->vao, 0);
-	glEnableVertexArrayAttrib(mesh->vao, 1);
-	glEnableVertexArrayAttrib(mesh->vao, 2);
-	glEnableVertexArrayAttrib(mesh->vao, 3);
-	
+Aabb computeBounds(std::span<const Vertex> vertices) {
+	if (vertices.empty()) return { glm::vec3(0.0f), glm::vec3(0.0f) };
+
+	Aabb box{ glm::vec3(vertices[0].position), glm::vec3(vertices[0].position) };
+	for (const Vertex& v : vertices) {
+		box.min = glm::min(box.min, glm::vec3(v.position));
+		box.max = glm::max(box.max, glm::vec3(v.position));
+	}
+	return box;
+}
+
+glm::vec4 computeBoundingSphere(std::span<const Vertex> vertices) {
+	if (vertices.empty()) return glm::vec4(0.0f);
+
+	Aabb box = computeBounds(vertices);
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	float radius2 = 0.0f;
+	for (const Vertex& v : vertices) {
+		radius2 = std::max(radius2, glm::length2(glm::vec3(v.position) - center));
+	}
+	return glm::vec4(center, std::sqrt(radius2));
+}
+
+Mesh* createMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, PrimitiveFormat fmt, const VertexLayout& layout, bool retainCpuData) {
+
+	Mesh* mesh = allocateMesh();
+	// `layout` may be a temporary, the mesh points at the interned copy
+	const VertexLayout& stored = internVertexLayout(layout);
+	uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+	uint32_t indexCount = static_cast<uint32_t>(indices.size());
+	GeometryPool* pool = geometryPoolFor(stored, selectIndexType(vertexCount));
+
+	GeometryAllocation alloc = allocateGeometry(pool, vertexCount, indexCount);
+	if (layout.key == fullVertexLayout().key) {
+		// already in the buffer format, upload straight from the caller's memory
+		uploadGeometry(pool, alloc, vertices.data(), vertexCount, indices.data(), indexCount);
+	}
+	else {
+		std::vector<uint8_t> packed(vertices.size() * layout.stride);
+		packVertices(layout, vertices.data(), vertices.size(), packed.data());
+		uploadGeometry(pool, alloc, packed.data(), vertexCount, indices.data(), indexCount);
+	}
 
-	mesh->vertices = vertices;
-	mesh->indices = indices;
+	mesh->layout = &stored;
+	mesh->vao = pool->vao;
+	mesh->pool = pool;
+	mesh->baseVertex = alloc.baseVertex;
+	mesh->firstIndex = alloc.firstIndex;
+	mesh->indexCount = indexCount;
+	mesh->boundingSphere = computeBoundingSphere(vertices);
+	mesh->bounds = computeBounds(vertices);
+
+	if (retainCpuData) {
+		mesh->vertices.assign(vertices.begin(), vertices.end());
+		mesh->indices.assign(indices.begin(), indices.end());
+	}
 	mesh->primitiveFormat = fmt;
 	return mesh;
 }
 
-glm::mat4 pMatrix = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+Mesh* createMesh(std::vector<Vertex>&& vertices, std::vector<uint32_t>&& indices, PrimitiveFormat fmt, const VertexLayout& layout, bool retainCpuData) {
+	Mesh* mesh = createMesh(std::span<const Vertex>(vertices), std::span<const uint32_t>(indices), fmt, layout, false);
+	if (retainCpuData) {
+		mesh->vertices = std::move(vertices);
+		mesh->indices = std::move(indices);
+	}
+	return mesh;
+}
 
-struct Camera {
-	glm::vec3 position;
-	glm::fquat lookDirection = glm::angleAxis(0.f, glm::vec3(0.f,0.f,1.f));
-};
+uint32_t nextMeshSortId() {
+	static uint32_t next = 0;
+	return next++;
+}
+
+uint32_t nextMaterialSortId() {
+	static uint32_t next = 0;
+	return next++;
+}
+
+bool isTransparent(const Material* mat) {
+	return mat->color.a < 1.0f;
+}
+
+glm::mat4 calcViewMatrix(Camera* camera) {
+	return glm::translate(glm::toMat4(camera->lookDirection), -camera->position);
+}
+
+glm::mat4 calcProjectionMatrix(Camera* camera) {
+	if (!camera->reversedZ) return glm::perspective(glm::radians(camera->fov), camera->aspect, camera->nearPlane, camera->farPlane);
+
+	// infinite far plane for a 0..1 clip range, depth = nearPlane / distance
+	float f = 1.0f / std::tan(glm::radians(camera->fov) * 0.5f);
+	glm::mat4 p(0.0f);
+	p[0][0] = f / camera->aspect;
+	p[1][1] = f;
+	p[2][3] = -1.0f;
+	p[3][2] = camera->nearPlane;
+	return p;
+}
 
 glm::mat4 calcVPMatrix(Camera* camera) {
-	return pMatrix * glm::translate(glm::toMat4(camera->lookDirection), -camera->position);
+	return calcProjectionMatrix(camera) * calcViewMatrix(camera);
+}
+
+void applyDepthConvention(bool reversedZ) {
+	glClipControl(GL_LOWER_LEFT, reversedZ ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+	glClearDepth(reversedZ ? 0.0 : 1.0);
+	// or-equal so a depth pre-pass leaves the shading pass its own fragments
+	setDepthFunc(&glState, reversedZ ? GL_GEQUAL : GL_LEQUAL);
 }
 
 void applyMaterial(Material* mat) {
-	glUseProgram(mat->shader->handle);
-	glUniform4fv(glGetUniformLocation(mat->shader->handle, "uColor"), 1, reinterpret_cast<const float*>(&mat->color));
+	applyMaterial(mat, mat->shader);
 }
 
-void applyTransform(GameObject* go) {
-	const float* m = glm::value_ptr(createModelMatrix(go->transform));
-	glUniformMatrix4fv(glGetUniformLocation(go->meshRenderer.material->shader->handle, "uModel"), 1, false, m);
+void applyMaterial(Material* mat, ShaderProgram* program) {
+	bindProgram(&glState, program->handle);
+	for (uint32_t unit = 0; unit < mat->textures.size(); unit++) {
+		if (mat->textures[unit] != nullptr) bindTexture(&glState, unit, mat->textures[unit]->handle);
+	}
+
+	if (needsMaterialUpload(&glState, mat)) {
+		glUniform4fv(program->builtins.color, 1, reinterpret_cast<const float*>(&mat->color));
+	}
 }
 
-void applyCamera(Camera* camera, GameObject* go) {
-	const float* m = glm::value_ptr(calcVPMatrix(camera));
-	glUniformMatrix4fv(glGetUniformLocation(go->meshRenderer.material->shader->handle, "uViewProjection"), 1, false, m);
+void applyTransform(ShaderProgram* shader, const Transform& transform) {
+	applyTransform(shader, createModelMatrix(transform));
 }
 
-void renderGameObject(Camera* camera, GameObject* go) {
-	glBindVertexArray(go->meshRenderer.mesh->vao);
+void applyTransform(ShaderProgram* shader, const glm::mat4& model) {
+	glUniformMatrix4fv(shader->builtins.model, 1, false, glm::value_ptr(model));
+}
+
+void drawMesh(Mesh* mesh) {
+	const void* offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(mesh->firstIndex) * mesh->pool->indexSize);
+	glDrawElementsBaseVertex(static_cast<GLenum>(mesh->primitiveFormat), mesh->indexCount, mesh->pool->indexType, offset, mesh->baseVertex);
+	countDrawCall(primitiveTriangles(static_cast<GLenum>(mesh->primitiveFormat), mesh->indexCount));
+}
+
+void renderGameObject(GameObject* go) {
+	bindVertexArray(&glState, go->meshRenderer.mesh->vao);
 	applyMaterial(go->meshRenderer.material);
-	applyTransform(go);
-	applyCamera(camera, go);
+	applyTransform(go->meshRenderer.material->shader, go->transform);
 	
-	glDrawElements(static_cast<GLenum>(go->meshRenderer.mesh->primitiveFormat), go->meshRenderer.mesh->indices.size(), GL_UNSIGNED_INT, 0);
+	drawMesh(go->meshRenderer.mesh);
 }
 
 void updateCamera(GLFWwindow* win, Camera* camera) {
@@ -328,225 +438,12 @@ void updateCamera(GLFWwindow* win, Camera* camera) {
 
 }
 
-GameObject* clone(GameObject* go) {
-	GameObject *go2 = new GameObject(*go);
-	return go2;
-}
-
-std::vector<GameObject*> createGameObjects(GameObject* prefab, size_t count) {
-	std::vector<GameObject*> gos(count);
-	for (int i = 0; i < count; i++) {
-		gos[i] = clone(prefab);
-	}
-	return gos;
-}
-
-void renderGameObjects(Camera* camera, std::vector<GameObject*> objs) {
+void renderGameObjects(std::vector<GameObject*> objs) {
 	for (auto* go : objs) {
-		renderGameObject(camera, go);
+		renderGameObject(go);
 	}
 }
 
-void APIENTRY glDebugOutput(GLenum source,
-	GLenum type,
-	unsigned int id,
-	GLenum severity,
-	GLsizei length,
-	const char* message,
-	const void* userParam)
-{
-	// ignore non-significant error/warning codes
-	if (id == 131169 || id == 131185 || id == 131218 || id == 131204) return;
-
-	std::cout << "---------------" << std::endl;
-	std::cout << "Debug message (" << id << "): " << message << std::endl;
-
-	switch (source)
-	{
-	case GL_DEBUG_SOURCE_API:             std::cout << "Source: API"; break;
-	case GL_DEBUG_SOURCE_WINDOW_SYSTEM:   std::cout << "Source: Window System"; break;
-	case GL_DEBUG_SOURCE_SHADER_COMPILER: std::cout << "Source: Shader Compiler"; break;
-	case GL_DEBUG_SOURCE_THIRD_PARTY:     std::cout << "Source: Third Party"; break;
-	case GL_DEBUG_SOURCE_APPLICATION:     std::cout << "Source: Application"; break;
-	case GL_DEBUG_SOURCE_OTHER:           std::cout << "Source: Other"; break;
-	} std::cout << std::endl;
-
-	switch (type)
-	{
-	case GL_DEBUG_TYPE_ERROR:               std::cout << "Type: Error"; break;
-	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: std::cout << "Type: Deprecated Behaviour"; break;
-	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  std::cout << "Type: Undefined Behaviour"; break;
-	case GL_DEBUG_TYPE_PORTABILITY:         std::cout << "Type: Portability"; break;
-	case GL_DEBUG_TYPE_PERFORMANCE:         std::cout << "Type: Performance"; break;
-	case GL_DEBUG_TYPE_MARKER:              std::cout << "Type: Marker"; break;
-	case GL_DEBUG_TYPE_PUSH_GROUP:          std::cout << "Type: Push Group"; break;
-	case GL_DEBUG_TYPE_POP_GROUP:           std::cout << "Type: Pop Group"; break;
-	case GL_DEBUG_TYPE_OTHER:               std::cout << "Type: Other"; break;
-	} std::cout << std::endl;
-
-	switch (severity)
-	{
-	case GL_DEBUG_SEVERITY_HIGH:         std::cout << "Severity: high"; break;
-	case GL_DEBUG_SEVERITY_MEDIUM:       std::cout << "Severity: medium"; break;
-	case GL_DEBUG_SEVERITY_LOW:          std::cout << "Severity: low"; break;
-	case GL_DEBUG_SEVERITY_NOTIFICATION: std::cout << "Severity: notification"; break;
-	} std::cout << std::endl;
-	std::cout << std::endl;
-}
-
 float dist(Camera* cam, const GameObject* go) {
 	return glm::length2(cam->position - go->transform.position);
 }
-
-void renderGameObjectsSorted(Camera* cam, std::vector<GameObject*> objs) {
-	std::vector<GameObject*> sorted(objs);
-	std::sort(sorted.begin(), sorted.end(), [&](const GameObject* a, const GameObject* b) { return dist(cam, a) > dist(cam, b); });
-
-	for (const auto& p: sorted) {
-		renderGameObject(cam, p);
-	}
-}
-
-int main() {
-
-	glfwInit();
-	glfwDefaultWindowHints();
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
-//	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
-
-	GLFWwindow* win = glfwCreateWindow(800, 800, "Window", NULL, NULL);
-	glfwMakeContextCurrent(win);
-
-	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
-
-
-
-	int flags; glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
-	if (flags & GL_CONTEXT_FLAG_DEBUG_BIT) {
-		glEnable(GL_DEBUG_OUTPUT);
-		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-		glDebugMessageCallback(glDebugOutput, nullptr);
-		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_MEDIUM, 0, nullptr, GL_TRUE);
-	}
-
-	glClearColor(0, 1.0f, 0, 1.0f);
-
- 	glEnable(GL_DEPTH_TEST);
- 	glEnable(GL_BLEND);
- 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
- 	glBlendEquation(GL_FUNC_ADD);
-	glCullFace(GL_BACK);
-	glEnable(GL_CULL_FACE);
-	glFrontFace(GL_CCW);
-
-	ShaderProgram* sp = createShaderProgram({ "test.glsl", "testvert.glsl" });
-
-	Material* mat = new Material();
-	mat->color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-	mat->shader = sp;
-
-	Material* mat2 = new Material();
-	mat2->color = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
-	mat2->shader = sp;
-
-
-	std::vector<Vertex> vertices = {
-		{ { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
-		{ { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
-		{ { 1.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
-		{ { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
-
-		{ { 0.0f, 0.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
-		{ { 1.0f, 0.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
-		{ { 1.0f, 1.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
-		{ { 0.0f, 1.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
-	};
-
-	std::vector<uint32_t> indices = {
-		0, 2, 3,
-		0, 1, 2,
-
-		4, 7, 6,
-		4, 6, 5,
-
-		1, 5, 6,
-		1, 6, 2,
-
-		4, 3, 7,
-		4, 0, 3,
-
-		4, 1, 0,
-		4, 5, 1,
-
-		3, 6, 7,
-		3, 2, 6,
-	};
-
-	Mesh* mesh = createMesh(vertices, indices, PrimitiveFormat::Triangles);
-
-	mat->color.a = 0.4f;
-
-	GameObject* prefab = createGameObject(mesh, mat);
-
-	std::vector<GameObject*> testObjs = createGameObjects(prefab, 10);
-
-
-	testObjs[0]->meshRenderer.material = mat2;
-	testObjs[1]->meshRenderer.material = mat2;
-	testObjs[2]->meshRenderer.material = mat2;
-	testObjs[3]->meshRenderer.material = mat2;
-	testObjs[4]->meshRenderer.material = mat2;
-
-//	GameObject* testObj = createGameObject(mesh, mat);
-//	GameObject* testObj2 = createGameObject(mesh, mat);
-//	GameObject* testObj3 = createGameObject(mesh, mat);
-//	GameObject* testObj4 = createGameObject(mesh, mat);
-//	GameObject* testObj5 = createGameObject(mesh, mat);
-
-//	GameObject* testObj6 = createGameObject(mesh, mat);
-//	GameObject* testObj7 = createGameObject(mesh, mat);
-//	GameObject* testObj8 = createGameObject(mesh, mat);
-//	GameObject* testObj9 = createGameObject(mesh, mat);
-//	GameObject* testObj10 = createGameObject(mesh, mat);
-
-	testObjs[1]->transform.position.x = 1;
-	testObjs[2]->transform.position.x = -1;
-	testObjs[3]->transform.position.y = 1;
-	testObjs[4]->transform.position.y = -1;
-
-	testObjs[6]->transform.position.x = 1;
-	testObjs[7]->transform.position.x = -1;
-	testObjs[8]->transform.position.y = 1;
-	testObjs[9]->transform.position.y = -1;
-
-	testObjs[5]->transform.position.z = -2;
-	testObjs[6]->transform.position.z = -2;
-	testObjs[7]->transform.position.z = -2;
-	testObjs[8]->transform.position.z = -2;
-	testObjs[9]->transform.position.z = -2;
-
-
-	Camera* camera = new Camera();
-
-	spdlog::info("Hello!");
-
-
-
-	while (!glfwWindowShouldClose(win)) {
-		glfwPollEvents();
-
-
-		updateCamera(win, camera);
-
-
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-
-		renderGameObjectsSorted(camera, testObjs);
-
-
-		glfwSwapBuffers(win);
-	}
-}
\ No newline at end of file
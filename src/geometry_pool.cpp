@@ -0,0 +1,164 @@
+#include "geometry_pool.hpp"
+#include "profiler.hpp"
+#include "game.hpp"
+#include "gl_state.hpp"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+static uint32_t createPoolBuffer(size_t size, const void* data = nullptr) {
+	uint32_t buffer;
+	glCreateBuffers(1, &buffer);
+	// zero sized storage is an error, an empty pool still gets a buffer to grow from
+	if (size == 0) glNamedBufferStorage(buffer, 4, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	else glNamedBufferStorage(buffer, size, data, GL_DYNAMIC_STORAGE_BIT);
+	return buffer;
+}
+
+static uint32_t growBuffer(uint32_t old, size_t usedBytes, size_t newSize) {
+	uint32_t buffer = createPoolBuffer(newSize);
+	if (usedBytes > 0) glCopyNamedBufferSubData(old, buffer, 0, 0, usedBytes);
+	glDeleteBuffers(1, &old);
+	return buffer;
+}
+
+static uint32_t positionStride(const GeometryPool* pool) {
+	return pool->positionLayout->stride;
+}
+
+static std::vector<uint8_t> extractPositions(const GeometryPool* pool, const void* vertices, uint32_t vertexCount) {
+	uint32_t size = positionStride(pool);
+	uint32_t offset = pool->layout->offsets[static_cast<uint32_t>(VertexAttribute::Position)];
+	std::vector<uint8_t> positions(static_cast<size_t>(vertexCount) * size);
+	const uint8_t* src = static_cast<const uint8_t*>(vertices);
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		memcpy(&positions[static_cast<size_t>(v) * size], src + static_cast<size_t>(v) * pool->vertexStride + offset, size);
+	}
+	return positions;
+}
+
+// `positions` fill the position stream when given
+static void createDepthVao(GeometryPool* pool, const void* positions) {
+	AttributeFormat format = pool->layout->formats[static_cast<uint32_t>(VertexAttribute::Position)];
+	pool->positionLayout = &internVertexLayout(makeVertexLayout(format, AttributeFormat::None, AttributeFormat::None, AttributeFormat::None));
+	pool->positionVbo = createPoolBuffer(static_cast<size_t>(pool->vertexCapacity) * positionStride(pool), positions);
+
+	glCreateVertexArrays(1, &pool->depthVao);
+	glVertexArrayVertexBuffer(pool->depthVao, 0, pool->positionVbo, 0, positionStride(pool));
+	glVertexArrayElementBuffer(pool->depthVao, pool->ibo);
+	setupVertexLayout(pool->depthVao, *pool->positionLayout);
+}
+
+GeometryPool* createGeometryPool(const VertexLayout& layout, GLenum indexType, uint32_t vertexCapacity, uint32_t indexCapacity) {
+	GeometryPool* pool = new GeometryPool();
+	uint32_t vertexStride = layout.stride;
+	// callers may pass a temporary, the pool keeps the one long-lived copy
+	pool->layout = &internVertexLayout(layout);
+	pool->vertexStride = vertexStride;
+	pool->indexType = indexType;
+	pool->indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	pool->vertexCapacity = vertexCapacity;
+	pool->indexCapacity = indexCapacity;
+
+	glCreateVertexArrays(1, &pool->vao);
+	pool->vbo = createPoolBuffer(static_cast<size_t>(vertexCapacity) * vertexStride);
+	pool->ibo = createPoolBuffer(static_cast<size_t>(indexCapacity) * pool->indexSize);
+
+	glVertexArrayVertexBuffer(pool->vao, 0, pool->vbo, 0, vertexStride);
+	glVertexArrayElementBuffer(pool->vao, pool->ibo);
+	setupVertexLayout(pool->vao, layout);
+	createDepthVao(pool, nullptr);
+	return pool;
+}
+
+GeometryPool* createGeometryPool(const VertexLayout& layout, GLenum indexType, const void* vertices, const void* positions, uint32_t vertexCount, const void* indices, uint32_t indexCount) {
+	GeometryPool* pool = new GeometryPool();
+	pool->layout = &internVertexLayout(layout);
+	pool->vertexStride = layout.stride;
+	pool->indexType = indexType;
+	pool->indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	pool->vertexCapacity = pool->vertexCount = vertexCount;
+	pool->indexCapacity = pool->indexCount = indexCount;
+
+	glCreateVertexArrays(1, &pool->vao);
+	pool->vbo = createPoolBuffer(static_cast<size_t>(vertexCount) * layout.stride, vertices);
+	pool->ibo = createPoolBuffer(static_cast<size_t>(indexCount) * pool->indexSize, indices);
+
+	glVertexArrayVertexBuffer(pool->vao, 0, pool->vbo, 0, layout.stride);
+	glVertexArrayElementBuffer(pool->vao, pool->ibo);
+	setupVertexLayout(pool->vao, layout);
+	createDepthVao(pool, positions);
+	return pool;
+}
+
+void destroyGeometryPool(GeometryPool* pool) {
+	if (glState.vao == pool->vao || glState.vao == pool->depthVao) glState.vao = GL_STATE_UNKNOWN;
+	uint32_t vaos[] = { pool->vao, pool->depthVao };
+	glDeleteVertexArrays(2, vaos);
+	uint32_t buffers[] = { pool->vbo, pool->ibo, pool->positionVbo };
+	glDeleteBuffers(3, buffers);
+	delete pool;
+}
+
+GeometryPool* geometryPoolFor(const VertexLayout& layout, GLenum indexType) {
+	static std::unordered_map<uint64_t, GeometryPool*> pools;
+	GeometryPool*& pool = pools[(static_cast<uint64_t>(indexType) << 32) | layout.key];
+	if (pool == nullptr) pool = createGeometryPool(layout, indexType, 1 << 16, 1 << 18);
+	return pool;
+}
+
+GLenum selectIndexType(uint32_t vertexCount) {
+	return vertexCount <= 0xFFFF + 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+GeometryPool* sharedGeometryPool() {
+	return geometryPoolFor(fullVertexLayout());
+}
+
+GeometryAllocation allocateGeometry(GeometryPool* pool, uint32_t vertexCount, uint32_t indexCount) {
+	if (pool->vertexCount + vertexCount > pool->vertexCapacity) {
+		uint32_t capacity = std::max(pool->vertexCapacity * 2, pool->vertexCount + vertexCount);
+		pool->vbo = growBuffer(pool->vbo, static_cast<size_t>(pool->vertexCount) * pool->vertexStride, static_cast<size_t>(capacity) * pool->vertexStride);
+		pool->positionVbo = growBuffer(pool->positionVbo, static_cast<size_t>(pool->vertexCount) * positionStride(pool), static_cast<size_t>(capacity) * positionStride(pool));
+		pool->vertexCapacity = capacity;
+		glVertexArrayVertexBuffer(pool->vao, 0, pool->vbo, 0, pool->vertexStride);
+		glVertexArrayVertexBuffer(pool->depthVao, 0, pool->positionVbo, 0, positionStride(pool));
+	}
+
+	if (pool->indexCount + indexCount > pool->indexCapacity) {
+		uint32_t capacity = std::max(pool->indexCapacity * 2, pool->indexCount + indexCount);
+		pool->ibo = growBuffer(pool->ibo, static_cast<size_t>(pool->indexCount) * pool->indexSize, static_cast<size_t>(capacity) * pool->indexSize);
+		pool->indexCapacity = capacity;
+		glVertexArrayElementBuffer(pool->vao, pool->ibo);
+		glVertexArrayElementBuffer(pool->depthVao, pool->ibo);
+	}
+
+	GeometryAllocation alloc{ pool->vertexCount, pool->indexCount };
+	pool->vertexCount += vertexCount;
+	pool->indexCount += indexCount;
+	return alloc;
+}
+
+void uploadGeometry(GeometryPool* pool, GeometryAllocation alloc, const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+	countUpload(static_cast<uint64_t>(vertexCount) * pool->vertexStride + static_cast<uint64_t>(indexCount) * pool->indexSize);
+	glNamedBufferSubData(pool->vbo, static_cast<GLintptr>(alloc.baseVertex) * pool->vertexStride, static_cast<GLsizeiptr>(vertexCount) * pool->vertexStride, vertices);
+	uploadPositionStream(pool, alloc.baseVertex, vertices, vertexCount);
+	GLintptr indexOffset = static_cast<GLintptr>(alloc.firstIndex) * pool->indexSize;
+	if (pool->indexType == GL_UNSIGNED_INT) {
+		glNamedBufferSubData(pool->ibo, indexOffset, static_cast<GLsizeiptr>(indexCount) * sizeof(uint32_t), indices);
+		return;
+	}
+
+	std::vector<uint16_t> narrow(indices, indices + indexCount);
+	glNamedBufferSubData(pool->ibo, indexOffset, static_cast<GLsizeiptr>(indexCount) * sizeof(uint16_t), narrow.data());
+}
+
+void uploadPositionStream(GeometryPool* pool, uint32_t baseVertex, const void* vertices, uint32_t vertexCount) {
+	if (vertexCount == 0) return;
+	std::vector<uint8_t> positions = extractPositions(pool, vertices, vertexCount);
+	countUpload(positions.size());
+	glNamedBufferSubData(pool->positionVbo, static_cast<GLintptr>(baseVertex) * positionStride(pool), static_cast<GLsizeiptr>(positions.size()), positions.data());
+}
@@ -0,0 +1,177 @@
+#include "gl_debug.hpp"
+#include "profiler.hpp"
+
+#include <spdlog/spdlog.h>
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+static const char* sourceName(GLenum source) {
+	switch (source) {
+	case GL_DEBUG_SOURCE_API: return "API";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "Window System";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER: return "Shader Compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY: return "Third Party";
+	case GL_DEBUG_SOURCE_APPLICATION: return "Application";
+	default: return "Other";
+	}
+}
+
+static const char* typeName(GLenum type) {
+	switch (type) {
+	case GL_DEBUG_TYPE_ERROR: return "Error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "Deprecated Behaviour";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "Undefined Behaviour";
+	case GL_DEBUG_TYPE_PORTABILITY: return "Portability";
+	case GL_DEBUG_TYPE_PERFORMANCE: return "Performance";
+	case GL_DEBUG_TYPE_MARKER: return "Marker";
+	case GL_DEBUG_TYPE_PUSH_GROUP: return "Push Group";
+	case GL_DEBUG_TYPE_POP_GROUP: return "Pop Group";
+	default: return "Other";
+	}
+}
+
+static spdlog::level::level_enum severityLevel(GLenum severity) {
+	switch (severity) {
+	case GL_DEBUG_SEVERITY_HIGH: return spdlog::level::err;
+	case GL_DEBUG_SEVERITY_MEDIUM: return spdlog::level::warn;
+	case GL_DEBUG_SEVERITY_LOW: return spdlog::level::info;
+	default: return spdlog::level::debug;
+	}
+}
+
+static uint64_t repeatKey(const GlDebugMessage& m) {
+	return (static_cast<uint64_t>(m.source & 0xFFFF) << 48) | (static_cast<uint64_t>(m.type & 0xFFFF) << 32) | m.id;
+}
+
+// GL thread only, the ignore list, repeat counts and profiler counters are not shared
+static void handleMessage(GlDebugOutput* output, const GlDebugMessage& m, spdlog::logger* logger) {
+	if (output->ignoredIds.count(m.id) != 0) return;
+	if (m.type == GL_DEBUG_TYPE_PERFORMANCE) profiler.current.counters.performanceWarnings++;
+
+	GlDebugRepeat& repeat = output->repeats[repeatKey(m)];
+	if (repeat.count++ > 0) return;
+	repeat.reported = 1;
+	repeat.source = m.source;
+	repeat.type = m.type;
+	repeat.severity = m.severity;
+	logger->log(severityLevel(m.severity), "GL {} {} ({}): {}", sourceName(m.source), typeName(m.type), m.id, m.text.data());
+}
+
+static bool pushMessage(GlDebugOutput* output, const GlDebugMessage& m) {
+	uint32_t position = output->writePosition.load(std::memory_order_relaxed);
+	GlDebugSlot* slot;
+	while (true) {
+		slot = &output->ring[position & (GL_DEBUG_RING_SIZE - 1)];
+		uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+		int32_t diff = static_cast<int32_t>(sequence - position);
+		if (diff == 0) {
+			// claims the slot, a failed exchange reloads `position` for the next try
+			if (output->writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+		}
+		else if (diff < 0) return false; // the reader has not freed this slot yet, the ring is full
+		else position = output->writePosition.load(std::memory_order_relaxed);
+	}
+
+	slot->message = m;
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+static bool popMessage(GlDebugOutput* output, GlDebugMessage* m) {
+	uint32_t position = output->readPosition;
+	GlDebugSlot* slot = &output->ring[position & (GL_DEBUG_RING_SIZE - 1)];
+	if (slot->sequence.load(std::memory_order_acquire) != position + 1) return false;
+
+	*m = slot->message;
+	slot->sequence.store(position + GL_DEBUG_RING_SIZE, std::memory_order_release);
+	output->readPosition = position + 1;
+	return true;
+}
+
+static void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
+	GlDebugOutput* output = static_cast<GlDebugOutput*>(const_cast<void*>(userParam));
+
+	GlDebugMessage m;
+	m.source = source;
+	m.type = type;
+	m.severity = severity;
+	m.id = id;
+	size_t n = length >= 0 ? static_cast<size_t>(length) : strlen(message);
+	n = std::min(n, GL_DEBUG_MESSAGE_LENGTH - 1);
+	memcpy(m.text.data(), message, n);
+	m.text[n] = '\0';
+
+	// a message raised on a driver thread just before the switch to sync mode still goes through the ring
+	if (output->synchronous.load(std::memory_order_relaxed) && std::this_thread::get_id() == output->glThread) handleMessage(output, m, output->syncLogger.get());
+	else if (!pushMessage(output, m)) output->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+GlDebugOutput* createGlDebugOutput(bool synchronous) {
+	GLint flags;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) return nullptr;
+
+	GlDebugOutput* output = new GlDebugOutput();
+	for (uint32_t i = 0; i < GL_DEBUG_RING_SIZE; i++) output->ring[i].sequence.store(i, std::memory_order_relaxed);
+
+	if (spdlog::thread_pool() == nullptr) spdlog::init_thread_pool(8192, 1);
+	auto sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+	output->syncLogger = std::make_shared<spdlog::logger>("gl", sink);
+	// a full log queue overwrites its oldest entry instead of blocking the GL thread
+	output->asyncLogger = std::make_shared<spdlog::async_logger>("gl", sink, spdlog::thread_pool(), spdlog::async_overflow_policy::overrun_oldest);
+	for (auto& logger : { output->syncLogger, output->asyncLogger }) logger->set_level(spdlog::level::debug);
+
+	// non-significant driver chatter, buffer placement and texture state notes
+	for (uint32_t id : { 131169u, 131185u, 131218u, 131204u }) output->ignoredIds.insert(id);
+
+	output->glThread = std::this_thread::get_id();
+	output->synchronous = synchronous;
+	if (synchronous) glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glDebugMessageCallback(debugCallback, output);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_MEDIUM, 0, nullptr, GL_TRUE);
+	glEnable(GL_DEBUG_OUTPUT);
+	return output;
+}
+
+void destroyGlDebugOutput(GlDebugOutput* output) {
+	glDisable(GL_DEBUG_OUTPUT);
+	glDebugMessageCallback(nullptr, nullptr);
+	pumpGlDebugOutput(output);
+	output->asyncLogger->flush();
+	delete output;
+}
+
+void setGlDebugSynchronous(GlDebugOutput* output, bool synchronous) {
+	if (output->synchronous == synchronous) return;
+	pumpGlDebugOutput(output);
+	output->synchronous = synchronous;
+	if (synchronous) glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+}
+
+void ignoreGlDebugMessage(GlDebugOutput* output, uint32_t id) {
+	output->ignoredIds.insert(id);
+}
+
+void pumpGlDebugOutput(GlDebugOutput* output) {
+	PROFILE_SCOPE("gl debug output");
+	GlDebugMessage m;
+	while (popMessage(output, &m)) handleMessage(output, m, output->asyncLogger.get());
+
+	spdlog::logger* logger = output->synchronous.load(std::memory_order_relaxed) ? output->syncLogger.get() : output->asyncLogger.get();
+	uint64_t dropped = output->dropped.exchange(0, std::memory_order_relaxed);
+	if (dropped > 0) logger->warn("GL debug output dropped {} messages, the ring was full", dropped);
+
+	uint64_t now = profilerNow();
+	if ((now - output->lastRepeatReport) / 1e9 < GL_DEBUG_REPEAT_INTERVAL) return;
+	output->lastRepeatReport = now;
+	for (auto& [key, repeat] : output->repeats) {
+		if (repeat.count == repeat.reported) continue;
+		logger->log(severityLevel(repeat.severity), "GL {} {} ({}) repeated {} more times", sourceName(repeat.source), typeName(repeat.type), static_cast<uint32_t>(key), repeat.count - repeat.reported);
+		repeat.reported = repeat.count;
+	}
+}
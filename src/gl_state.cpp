@@ -0,0 +1,107 @@
+#include "gl_state.hpp"
+
+GLStateCache glState;
+
+static bool changed(GLStateCache* cache, uint32_t& slot, uint32_t value) {
+	if (slot == value) {
+		cache->counters.skipped++;
+		return false;
+	}
+	slot = value;
+	cache->counters.issued++;
+	return true;
+}
+
+static void setCapability(GLenum cap, bool enabled) {
+	if (enabled) glEnable(cap);
+	else glDisable(cap);
+}
+
+void invalidateStateCache(GLStateCache* cache) {
+	GLStateCounters counters = cache->counters;
+	*cache = GLStateCache();
+	cache->counters = counters;
+}
+
+void beginStateCacheFrame(GLStateCache* cache) {
+	cache->counters = {};
+	cache->material = nullptr;
+}
+
+bool bindProgram(GLStateCache* cache, uint32_t program) {
+	if (!changed(cache, cache->program, program)) return false;
+	// uniforms live in the program object, so whatever we tracked belongs to the old one
+	cache->material = nullptr;
+	glUseProgram(program);
+	return true;
+}
+
+bool bindVertexArray(GLStateCache* cache, uint32_t vao) {
+	if (!changed(cache, cache->vao, vao)) return false;
+	glBindVertexArray(vao);
+	return true;
+}
+
+bool bindTexture(GLStateCache* cache, uint32_t unit, uint32_t texture) {
+	if (!changed(cache, cache->textures[unit], texture)) return false;
+	glBindTextureUnit(unit, texture);
+	return true;
+}
+
+void forgetTexture(GLStateCache* cache, uint32_t texture) {
+	for (uint32_t& bound : cache->textures) {
+		if (bound == texture) bound = GL_STATE_UNKNOWN;
+	}
+}
+
+bool setBlend(GLStateCache* cache, bool enabled) {
+	if (!changed(cache, cache->blend, enabled)) return false;
+	setCapability(GL_BLEND, enabled);
+	return true;
+}
+
+bool setBlendFunc(GLStateCache* cache, GLenum src, GLenum dst) {
+	if (cache->blendSrc == src && cache->blendDst == dst) {
+		cache->counters.skipped++;
+		return false;
+	}
+	cache->blendSrc = src;
+	cache->blendDst = dst;
+	cache->counters.issued++;
+	glBlendFunc(src, dst);
+	return true;
+}
+
+bool setDepthTest(GLStateCache* cache, bool enabled) {
+	if (!changed(cache, cache->depthTest, enabled)) return false;
+	setCapability(GL_DEPTH_TEST, enabled);
+	return true;
+}
+
+bool setDepthWrite(GLStateCache* cache, bool enabled) {
+	if (!changed(cache, cache->depthWrite, enabled)) return false;
+	glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	return true;
+}
+
+bool setDepthFunc(GLStateCache* cache, GLenum func) {
+	if (!changed(cache, cache->depthFunc, func)) return false;
+	glDepthFunc(func);
+	return true;
+}
+
+bool setCullFace(GLStateCache* cache, bool enabled) {
+	if (!changed(cache, cache->cullFace, enabled)) return false;
+	setCapability(GL_CULL_FACE, enabled);
+	return true;
+}
+
+bool needsMaterialUpload(GLStateCache* cache, const Material* mat) {
+	if (cache->material == mat) {
+		cache->counters.skipped++;
+		return false;
+	}
+	cache->material = mat;
+	cache->counters.issued++;
+	return true;
+}
@@ -0,0 +1,165 @@
+#include "gpu_scene.hpp"
+#include "profiler.hpp"
+#include "gl_state.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+static uint32_t createStorage(size_t size) {
+	uint32_t buffer;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	return buffer;
+}
+
+static void replaceStorage(uint32_t& buffer, size_t size) {
+	if (buffer != 0) glDeleteBuffers(1, &buffer);
+	buffer = createStorage(size);
+}
+
+GpuScene* createGpuScene(ShaderProgram* cullProgram, ShaderProgram* drawProgram) {
+	GpuScene* scene = new GpuScene();
+	scene->cullProgram = cullProgram;
+	scene->drawProgram = drawProgram;
+	scene->compact = GLAD_GL_VERSION_4_6;
+	scene->parameterBuffer = createStorage(sizeof(uint32_t));
+	return scene;
+}
+
+uint32_t addGpuSceneObject(GpuScene* scene, Mesh* mesh, Material* material, const Transform& transform) {
+	if (scene->geometry == nullptr) scene->geometry = mesh->pool;
+
+	if (mesh->pool != scene->geometry || mesh->primitiveFormat != PrimitiveFormat::Triangles) {
+		spdlog::error("GPU scene objects must be triangle meshes from one geometry pool");
+		throw std::runtime_error("GPU scene objects must be triangle meshes from one geometry pool");
+	}
+	if (isTransparent(material)) {
+		spdlog::error("GPU scene objects must be opaque, blended objects go through the render queue");
+		throw std::runtime_error("GPU scene objects must be opaque");
+	}
+
+	auto [it, inserted] = scene->drawIndex.try_emplace(mesh, static_cast<uint32_t>(scene->draws.size()));
+	if (inserted) {
+		scene->draws.push_back({ mesh->indexCount, mesh->firstIndex, static_cast<int32_t>(mesh->baseVertex), 0 });
+		scene->drawMeshes.push_back(mesh);
+	}
+
+	glm::mat4 model = createModelMatrix(transform);
+	scene->objects.push_back({ model, material->color, transformSphere(model, mesh->boundingSphere), it->second, material->sortId, {} });
+	scene->dirty = true;
+	return static_cast<uint32_t>(scene->objects.size() - 1);
+}
+
+void updateGpuSceneObject(GpuScene* scene, uint32_t index, const Transform& transform) {
+	GpuObject& obj = scene->objects[index];
+	obj.model = createModelMatrix(transform);
+	obj.sphere = transformSphere(obj.model, scene->drawMeshes[obj.draw]->boundingSphere);
+
+	// a pending full upload picks this up anyway
+	if (!scene->dirty) {
+		glNamedBufferSubData(scene->objectBuffer, static_cast<GLintptr>(index) * sizeof(GpuObject), sizeof(GpuObject), &obj);
+		countUpload(sizeof(GpuObject));
+	}
+}
+
+static void attachGeometry(GpuScene* scene) {
+	if (scene->vao == 0) {
+		glCreateVertexArrays(1, &scene->vao);
+		setupVertexLayout(scene->vao, *scene->geometry->layout);
+
+		glVertexArrayAttribBinding(scene->vao, GPU_SCENE_OBJECT_ID_ATTRIB, GPU_SCENE_OBJECT_ID_BINDING);
+		glVertexArrayAttribIFormat(scene->vao, GPU_SCENE_OBJECT_ID_ATTRIB, 1, GL_UNSIGNED_INT, 0);
+		glVertexArrayBindingDivisor(scene->vao, GPU_SCENE_OBJECT_ID_BINDING, 1);
+		glEnableVertexArrayAttrib(scene->vao, GPU_SCENE_OBJECT_ID_ATTRIB);
+	}
+
+	// the pool replaces its buffers when it grows
+	GeometryPool* pool = scene->geometry;
+	if (scene->boundVbo != pool->vbo) {
+		glVertexArrayVertexBuffer(scene->vao, 0, pool->vbo, 0, pool->vertexStride);
+		scene->boundVbo = pool->vbo;
+	}
+	if (scene->boundIbo != pool->ibo) {
+		glVertexArrayElementBuffer(scene->vao, pool->ibo);
+		scene->boundIbo = pool->ibo;
+	}
+}
+
+void uploadGpuScene(GpuScene* scene) {
+	if (scene->geometry != nullptr) attachGeometry(scene);
+	if (!scene->dirty) return;
+
+	uint32_t n = static_cast<uint32_t>(scene->objects.size());
+	if (n > scene->capacity) {
+		uint32_t capacity = std::max(n, scene->capacity * 2);
+		replaceStorage(scene->objectBuffer, static_cast<size_t>(capacity) * sizeof(GpuObject));
+		replaceStorage(scene->commandBuffer, static_cast<size_t>(capacity) * sizeof(DrawElementsIndirectCommand));
+
+		std::vector<uint32_t> ids(capacity);
+		std::iota(ids.begin(), ids.end(), 0u);
+		replaceStorage(scene->objectIdBuffer, ids.size() * sizeof(uint32_t));
+		glNamedBufferSubData(scene->objectIdBuffer, 0, ids.size() * sizeof(uint32_t), ids.data());
+		countUpload(ids.size() * sizeof(uint32_t));
+		glVertexArrayVertexBuffer(scene->vao, GPU_SCENE_OBJECT_ID_BINDING, scene->objectIdBuffer, 0, sizeof(uint32_t));
+
+		scene->capacity = capacity;
+	}
+
+	uint32_t d = static_cast<uint32_t>(scene->draws.size());
+	if (d > scene->drawCapacity) {
+		uint32_t capacity = std::max(d, scene->drawCapacity * 2);
+		replaceStorage(scene->drawBuffer, static_cast<size_t>(capacity) * sizeof(GpuMeshDraw));
+		scene->drawCapacity = capacity;
+	}
+
+	if (n > 0) glNamedBufferSubData(scene->objectBuffer, 0, static_cast<size_t>(n) * sizeof(GpuObject), scene->objects.data());
+	if (d > 0) glNamedBufferSubData(scene->drawBuffer, 0, static_cast<size_t>(d) * sizeof(GpuMeshDraw), scene->draws.data());
+	countUpload(static_cast<size_t>(n) * sizeof(GpuObject) + static_cast<size_t>(d) * sizeof(GpuMeshDraw));
+	scene->dirty = false;
+}
+
+void cullGpuScene(GpuScene* scene, const Frustum& frustum) {
+	uint32_t n = static_cast<uint32_t>(scene->objects.size());
+	if (n == 0) return;
+
+	const UniformTable* u = &scene->cullProgram->uniforms;
+	bindProgram(&glState, scene->cullProgram->handle);
+	glUniform4fv(uniformLocation(u, "uFrustumPlanes"), 6, glm::value_ptr(frustum.planes[0]));
+	glUniform1ui(uniformLocation(u, "uObjectCount"), n);
+	glUniform1i(uniformLocation(u, "uCompact"), scene->compact);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_SCENE_OBJECT_BINDING, scene->objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_SCENE_DRAW_BINDING, scene->drawBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_SCENE_COMMAND_BINDING, scene->commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_SCENE_PARAMETER_BINDING, scene->parameterBuffer);
+
+	glClearNamedBufferSubData(scene->parameterBuffer, GL_R32UI, 0, sizeof(uint32_t), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glDispatchCompute((n + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void drawGpuScene(GpuScene* scene) {
+	uint32_t n = static_cast<uint32_t>(scene->objects.size());
+	if (n == 0) return;
+
+	setBlend(&glState, false);
+	setDepthWrite(&glState, true);
+	bindVertexArray(&glState, scene->vao);
+	bindProgram(&glState, scene->drawProgram->handle);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_SCENE_OBJECT_BINDING, scene->objectBuffer);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene->commandBuffer);
+	if (scene->compact) {
+		glBindBuffer(GL_PARAMETER_BUFFER, scene->parameterBuffer);
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, scene->geometry->indexType, nullptr, 0, n, 0);
+	}
+	else {
+		glMultiDrawElementsIndirect(GL_TRIANGLES, scene->geometry->indexType, nullptr, n, 0);
+	}
+	// the GPU decides how many triangles these are
+	countDrawCall(0);
+}
@@ -0,0 +1,97 @@
+#include "instancing.hpp"
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include <cstddef>
+#include <stdexcept>
+
+InstanceBuffer* createInstanceBuffer(uint32_t capacity) {
+	InstanceBuffer* buffer = new InstanceBuffer();
+	buffer->capacity = capacity;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = static_cast<GLsizeiptr>(capacity) * INSTANCE_BUFFER_FRAMES * sizeof(InstanceData);
+
+	glCreateBuffers(1, &buffer->handle);
+	glNamedBufferStorage(buffer->handle, size, nullptr, flags);
+	buffer->mapped = static_cast<InstanceData*>(glMapNamedBufferRange(buffer->handle, 0, size, flags));
+	if (buffer->mapped == nullptr) {
+		spdlog::error("Failed to map instance buffer");
+		throw std::runtime_error("Failed to map instance buffer");
+	}
+
+	return buffer;
+}
+
+void beginInstanceFrame(InstanceBuffer* buffer) {
+	buffer->region = (buffer->region + 1) % INSTANCE_BUFFER_FRAMES;
+	buffer->used = 0;
+
+	GLsync& fence = buffer->fences[buffer->region];
+	if (fence == nullptr) return;
+
+	while (true) {
+		GLenum r = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		if (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED || r == GL_WAIT_FAILED) break;
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void endInstanceFrame(InstanceBuffer* buffer) {
+	GLsync& fence = buffer->fences[buffer->region];
+	if (fence != nullptr) glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+InstanceAllocation allocateInstances(InstanceBuffer* buffer, uint32_t count) {
+	if (buffer->used + count > buffer->capacity) {
+		return { nullptr, 0 };
+	}
+
+	uint32_t first = buffer->region * buffer->capacity + buffer->used;
+	buffer->used += count;
+	return { buffer->mapped + first, first };
+}
+
+static void attachModelAttributes(uint32_t vao, InstanceBuffer* buffer) {
+	glVertexArrayVertexBuffer(vao, INSTANCE_BINDING, buffer->handle, 0, sizeof(InstanceData));
+	glVertexArrayBindingDivisor(vao, INSTANCE_BINDING, 1);
+
+	for (uint32_t c = 0; c < 4; c++) {
+		uint32_t loc = INSTANCE_ATTRIB_MODEL + c;
+		glVertexArrayAttribBinding(vao, loc, INSTANCE_BINDING);
+		glVertexArrayAttribFormat(vao, loc, 4, GL_FLOAT, false, offsetof(InstanceData, model) + c * sizeof(glm::vec4));
+		glEnableVertexArrayAttrib(vao, loc);
+	}
+}
+
+void attachInstanceBuffer(Mesh* mesh, InstanceBuffer* buffer) {
+	if (mesh->instanceBuffer == buffer->handle) return;
+
+	uint32_t vao = mesh->vao;
+	attachModelAttributes(vao, buffer);
+
+	glVertexArrayAttribBinding(vao, INSTANCE_ATTRIB_COLOR, INSTANCE_BINDING);
+	glVertexArrayAttribFormat(vao, INSTANCE_ATTRIB_COLOR, 4, GL_FLOAT, false, offsetof(InstanceData, color));
+	glEnableVertexArrayAttrib(vao, INSTANCE_ATTRIB_COLOR);
+
+	glVertexArrayAttribBinding(vao, INSTANCE_ATTRIB_MATERIAL, INSTANCE_BINDING);
+	glVertexArrayAttribIFormat(vao, INSTANCE_ATTRIB_MATERIAL, 1, GL_UNSIGNED_INT, offsetof(InstanceData, material));
+	glEnableVertexArrayAttrib(vao, INSTANCE_ATTRIB_MATERIAL);
+
+	mesh->instanceBuffer = buffer->handle;
+}
+
+void attachDepthInstanceBuffer(GeometryPool* pool, InstanceBuffer* buffer) {
+	if (pool->depthInstanceBuffer == buffer->handle) return;
+	attachModelAttributes(pool->depthVao, buffer);
+	pool->depthInstanceBuffer = buffer->handle;
+}
+
+void drawMeshInstanced(Mesh* mesh, uint32_t count, uint32_t baseInstance) {
+	const void* offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(mesh->firstIndex) * mesh->pool->indexSize);
+	glDrawElementsInstancedBaseVertexBaseInstance(static_cast<GLenum>(mesh->primitiveFormat), mesh->indexCount, mesh->pool->indexType, offset, count, mesh->baseVertex, baseInstance);
+	countDrawCall(primitiveTriangles(static_cast<GLenum>(mesh->primitiveFormat), mesh->indexCount) * count);
+}
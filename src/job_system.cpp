@@ -0,0 +1,128 @@
+#include "job_system.hpp"
+
+#include <algorithm>
+
+static thread_local uint32_t threadIndex = 0;
+
+static bool popJob(JobSystem* jobs, uint32_t self, Job* job) {
+	{
+		JobQueue* own = jobs->queues[self].get();
+		std::lock_guard<std::mutex> lock(own->mutex);
+		if (!own->jobs.empty()) {
+			// newest first, its data is the most likely to still be in cache
+			*job = std::move(own->jobs.back());
+			own->jobs.pop_back();
+			jobs->queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	uint32_t n = static_cast<uint32_t>(jobs->queues.size());
+	for (uint32_t i = 1; i < n; i++) {
+		JobQueue* victim = jobs->queues[(self + i) % n].get();
+		std::lock_guard<std::mutex> lock(victim->mutex);
+		if (victim->jobs.empty()) continue;
+		// oldest first, usually the biggest piece left of whatever the victim split up
+		*job = std::move(victim->jobs.front());
+		victim->jobs.pop_front();
+		jobs->queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+static void execute(Job& job) {
+	job.run();
+	job.counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+static void workerLoop(JobSystem* jobs, uint32_t index) {
+	threadIndex = index;
+	while (true) {
+		Job job;
+		if (popJob(jobs, index, &job)) {
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(jobs->sleepMutex);
+		jobs->wake.wait(lock, [jobs] { return jobs->stopping || jobs->queued.load(std::memory_order_relaxed) > 0; });
+		if (jobs->stopping) return;
+	}
+}
+
+JobSystem* createJobSystem(uint32_t workerCount) {
+	if (workerCount == 0) workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	JobSystem* jobs = new JobSystem();
+	for (uint32_t i = 0; i <= workerCount; i++) jobs->queues.push_back(std::make_unique<JobQueue>());
+	for (uint32_t i = 1; i <= workerCount; i++) jobs->workers.emplace_back(workerLoop, jobs, i);
+	return jobs;
+}
+
+void destroyJobSystem(JobSystem* jobs) {
+	{
+		std::lock_guard<std::mutex> lock(jobs->sleepMutex);
+		jobs->stopping = true;
+	}
+	jobs->wake.notify_all();
+	for (std::thread& worker : jobs->workers) worker.join();
+	delete jobs;
+}
+
+uint32_t jobThreadCount(const JobSystem* jobs) {
+	return static_cast<uint32_t>(jobs->queues.size());
+}
+
+uint32_t jobThreadIndex() {
+	return threadIndex;
+}
+
+static void pushJob(JobSystem* jobs, JobCounter* counter, std::function<void()> run) {
+	counter->pending.fetch_add(1, std::memory_order_relaxed);
+	JobQueue* own = jobs->queues[threadIndex].get();
+	{
+		std::lock_guard<std::mutex> lock(own->mutex);
+		// counted before it can be popped, so `queued` never drops below zero
+		jobs->queued.fetch_add(1, std::memory_order_relaxed);
+		own->jobs.push_back({ std::move(run), counter });
+	}
+}
+
+void runJob(JobSystem* jobs, JobCounter* counter, std::function<void()> job) {
+	pushJob(jobs, counter, std::move(job));
+	// taking the lock orders the push before a worker's check of `queued`, so the wakeup is never lost
+	std::lock_guard<std::mutex> lock(jobs->sleepMutex);
+	jobs->wake.notify_one();
+}
+
+void waitForJobs(JobSystem* jobs, JobCounter* counter) {
+	uint32_t self = threadIndex;
+	while (counter->pending.load(std::memory_order_acquire) > 0) {
+		Job job;
+		if (popJob(jobs, self, &job)) execute(job);
+		else std::this_thread::yield();
+	}
+}
+
+void parallelFor(JobSystem* jobs, size_t count, size_t grain, const std::function<void(size_t, size_t, uint32_t)>& fn) {
+	grain = std::max<size_t>(grain, 1);
+	if (jobs == nullptr || count <= grain) {
+		if (count > 0) fn(0, count, jobThreadIndex());
+		return;
+	}
+
+	size_t chunks = std::max<size_t>(jobThreadCount(jobs) * JOB_CHUNKS_PER_THREAD, 1);
+	size_t chunk = std::max(grain, (count + chunks - 1) / chunks);
+
+	JobCounter counter;
+	for (size_t begin = 0; begin < count; begin += chunk) {
+		size_t end = std::min(begin + chunk, count);
+		pushJob(jobs, &counter, [&fn, begin, end] { fn(begin, end, jobThreadIndex()); });
+	}
+	{
+		std::lock_guard<std::mutex> lock(jobs->sleepMutex);
+		jobs->wake.notify_all();
+	}
+	waitForJobs(jobs, &counter);
+}
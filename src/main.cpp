@@ -0,0 +1,389 @@
+#include "game.hpp"
+#include "profiler.hpp"
+#include "render_queue.hpp"
+#include "gl_state.hpp"
+#include "gl_debug.hpp"
+#include "frame_constants.hpp"
+#include "instancing.hpp"
+#include "gpu_scene.hpp"
+#include "registry.hpp"
+#include "culling.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_lod.hpp"
+#include "asset_streamer.hpp"
+#include "texture_streamer.hpp"
+#include "material_table.hpp"
+#include "shader_cache.hpp"
+#include "job_system.hpp"
+#include "transient_buffer.hpp"
+#include "render_target.hpp"
+#include "frame_arena.hpp"
+#include "clustered_lighting.hpp"
+#include <spdlog/spdlog.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <filesystem>
+#include <random>
+#include <cmath>
+
+void framebufferSizeCallback(GLFWwindow*, int width, int height) {
+	glViewport(0, 0, width, height);
+}
+
+int main() {
+
+	glfwInit();
+	glfwDefaultWindowHints();
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+//	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+
+	GLFWwindow* win = glfwCreateWindow(800, 800, "Window", NULL, NULL);
+	glfwMakeContextCurrent(win);
+
+	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+	enableParallelShaderCompile();
+
+
+
+	// queued and logged off the GL thread, F5 switches to synchronous output for breaking on the offending call
+	GlDebugOutput* debugOutput = createGlDebugOutput();
+
+	glClearColor(0, 1.0f, 0, 1.0f);
+
+ 	setDepthTest(&glState, true);
+ 	setBlend(&glState, true);
+ 	setBlendFunc(&glState, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+ 	glBlendEquation(GL_FUNC_ADD);
+	glCullFace(GL_BACK);
+	setCullFace(&glState, true);
+	glFrontFace(GL_CCW);
+
+	// every program is requested before any is waited on, so the driver compiles them side by side while the mesh is built
+	ShaderVariantTable shaderVariants;
+	// per-draw values are bound by offset from the transient buffer, see RenderQueue::transient.
+	// everything is shaded by the clustered lights, see ClusteredLighting
+	ShaderProgram* sp = requestShaderVariant(&shaderVariants, { "test.glsl" }, { { "DRAW_CONSTANTS_BLOCK" }, { "CLUSTERED_LIGHTING" } });
+	ShaderProgram* spInstanced = requestShaderVariant(&shaderVariants, { "instanced.glsl" }, { { "CLUSTERED_LIGHTING" } });
+	ShaderProgram* spCull = requestShaderProgram({ "cull.glsl" });
+	ShaderProgram* spIndirect = requestShaderVariant(&shaderVariants, { "instanced.glsl" }, { { "INDIRECT_DRAW" }, { "CLUSTERED_LIGHTING" } });
+	ShaderProgram* spBindless = bindlessTexturesSupported() ? requestShaderVariant(&shaderVariants, { "instanced.glsl" }, { { "BINDLESS_MATERIALS" }, { "CLUSTERED_LIGHTING" } }) : nullptr;
+	// blended materials accumulate into an OitTarget with these instead of being depth sorted
+	ShaderProgram* spOit = requestShaderVariant(&shaderVariants, { "test.glsl" }, { { "DRAW_CONSTANTS_BLOCK" }, { "OIT_ACCUMULATE" }, { "CLUSTERED_LIGHTING" } });
+	ShaderProgram* spOitInstanced = requestShaderVariant(&shaderVariants, { "instanced.glsl" }, { { "OIT_ACCUMULATE" }, { "CLUSTERED_LIGHTING" } });
+	ShaderProgram* spOitComposite = requestShaderProgram({ "oit_composite.glsl" });
+	ShaderProgram* spDepthOnly = requestShaderProgram({ "depth_only.glsl" });
+	ShaderProgram* spLightCluster = requestShaderProgram({ "light_cluster.glsl" });
+
+	Material* mat = createMaterial(sp);
+	mat->color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+	mat->instancedShader = spInstanced;
+	mat->oitShader = spOit;
+	mat->oitInstancedShader = spOitInstanced;
+
+	Material* mat2 = createMaterial(sp);
+	mat2->color = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	mat2->instancedShader = spInstanced;
+	mat2->oitShader = spOit;
+	mat2->oitInstancedShader = spOitInstanced;
+
+	// with bindless textures both materials share instanced batches, their differences live in the table
+	MaterialTable* materialTable = nullptr;
+	if (spBindless != nullptr) {
+		materialTable = createMaterialTable();
+		for (Material* m : { mat, mat2 }) {
+			m->bindlessShader = spBindless;
+			registerMaterial(materialTable, m);
+		}
+	}
+
+	std::vector<Vertex> vertices = {
+		{ { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+		{ { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+		{ { 1.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+		{ { 0.0f, 1.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+
+		{ { 0.0f, 0.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+		{ { 1.0f, 0.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+		{ { 1.0f, 1.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+		{ { 0.0f, 1.0f, -1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f }},
+	};
+
+	std::vector<uint32_t> indices = {
+		0, 2, 3,
+		0, 1, 2,
+
+		4, 7, 6,
+		4, 6, 5,
+
+		1, 5, 6,
+		1, 6, 2,
+
+		4, 3, 7,
+		4, 0, 3,
+
+		4, 1, 0,
+		4, 5, 1,
+
+		3, 6, 7,
+		3, 2, 6,
+	};
+
+	optimizeMesh(vertices, indices);
+	Mesh* mesh = createMesh(vertices, indices, PrimitiveFormat::Triangles, compactVertexLayout());
+
+	mat->color.a = 0.4f;
+
+	// linked before any object takes a material, the vertex layout checks need the programs' reflected inputs
+	for (ShaderProgram* p : { sp, spInstanced, spCull, spIndirect, spBindless, spOit, spOitInstanced, spOitComposite, spDepthOnly, spLightCluster }) {
+		if (p != nullptr) finishShaderProgram(p);
+	}
+
+	GameObject* prefab = createGameObject(mesh, mat);
+
+	Registry registry;
+	Bvh spatial;
+	setSpatialIndex(&registry, &spatial);
+	std::vector<Entity> testObjs = createEntities(&registry, prefab, 10);
+	// the entities copied what they need from it
+	destroyGameObject(prefab);
+
+
+	setMaterial(&registry, testObjs[0], mat2);
+	setMaterial(&registry, testObjs[1], mat2);
+	setMaterial(&registry, testObjs[2], mat2);
+	setMaterial(&registry, testObjs[3], mat2);
+	setMaterial(&registry, testObjs[4], mat2);
+
+	setPosition(&registry, testObjs[1], { 1, 0, 0 });
+	setPosition(&registry, testObjs[2], { -1, 0, 0 });
+	setPosition(&registry, testObjs[3], { 0, 1, 0 });
+	setPosition(&registry, testObjs[4], { 0, -1, 0 });
+
+	setPosition(&registry, testObjs[5], { 0, 0, -2 });
+	setPosition(&registry, testObjs[6], { 1, 0, -2 });
+	setPosition(&registry, testObjs[7], { -1, 0, -2 });
+	setPosition(&registry, testObjs[8], { 0, 1, -2 });
+	setPosition(&registry, testObjs[9], { 0, -1, -2 });
+	updateWorldMatrices(&registry);
+
+
+	// opaque objects are static here, so they can be culled and drawn on the GPU
+	GpuScene* gpuScene = createGpuScene(spCull, spIndirect);
+	// blended objects, and streamed ones that live outside the GPU scene's pool, go through the render queue
+	std::vector<Entity> queuedObjs;
+	for (Entity e : testObjs) {
+		if (isTransparent(materialOf(&registry, e))) queuedObjs.push_back(e);
+		else addGpuSceneObject(gpuScene, meshOf(&registry, e), materialOf(&registry, e), getTransform(&registry, e));
+	}
+	bool gpuDriven = true;
+	bool toggleHeld = false;
+	bool occlusionHeld = false;
+	bool oitHeld = false;
+	bool prepassHeld = false;
+	bool captureHeld = false;
+	bool overlayHeld = false;
+	bool debugSyncHeld = false;
+	double lastSummary = 0.0;
+
+	Camera* camera = new Camera();
+	// reversed-Z into the float depth of sceneTarget, see RenderTarget
+	camera->reversedZ = true;
+	applyDepthConvention(camera->reversedZ);
+
+	spdlog::info("Hello!");
+
+	RenderQueue queue;
+	queue.instances = createInstanceBuffer(1 << 16);
+	Culler culler;
+	HiZBuffer* hiz = createHiZBuffer();
+	culler.hiz = hiz;
+	queue.culling = &culler;
+	queue.materials = materialTable;
+	RenderTarget* sceneTarget = createRenderTarget();
+	OitTarget* oit = createOitTarget(spOitComposite);
+	// tests against the scene's depth in place, no copy
+	oit->target = sceneTarget;
+	queue.oit = oit;
+	// the GPU scene draws without it, it only helps the queued draws shade fewer hidden pixels
+	queue.depthPrepass = spDepthOnly;
+	// frame stages fan out over every core, GL calls stay on this thread
+	JobSystem* jobs = createJobSystem();
+	queue.jobs = jobs;
+	// constants and per-draw values of the frames in flight, so recording never waits on a buffer the GPU reads
+	TransientBuffer* transient = createTransientBuffer();
+	queue.transient = transient;
+	FrameConstantsBuffer* frameConstants = createFrameConstantsBuffer();
+	frameConstants->transient = transient;
+
+	// a cloud of small lights drifting through the test objects
+	ClusteredLighting* lighting = createClusteredLighting(spLightCluster);
+	lighting->transient = transient;
+	std::vector<glm::vec4> lightOrbits;
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (uint32_t i = 0; i < 2048; i++) {
+			glm::vec3 position = glm::vec3(unit(rng), unit(rng), unit(rng)) * 6.0f - glm::vec3(3.0f, 3.0f, 4.0f);
+			lighting->lights.push_back({ position, 1.0f, glm::vec3(unit(rng), unit(rng), unit(rng)), 0.1f });
+			// xyz the resting position, w the phase of its bobbing
+			lightOrbits.push_back(glm::vec4(position, unit(rng) * 6.2831853f));
+		}
+	}
+
+	// streamed in the background, its entities are added once the geometry is resident
+	AssetStreamer* streamer = createAssetStreamer();
+	StreamedScene* streamedScene = std::filesystem::exists("scene.pscn") ? streamSceneAsset(streamer, "scene.pscn") : nullptr;
+	TextureStreamer* textureStreamer = createTextureStreamer(TEXTURE_VRAM_BUDGET, streamer->staging);
+	queue.textureFootprints = true;
+	glfwSetFramebufferSizeCallback(win, framebufferSizeCallback);
+
+	uint64_t frame = 0;
+	double lastTime = glfwGetTime();
+
+
+	while (!glfwWindowShouldClose(win)) {
+		glfwPollEvents();
+		beginProfilerFrame(&profiler);
+		if (debugOutput != nullptr) pumpGlDebugOutput(debugOutput);
+		beginStateCacheFrame(&glState);
+		beginInstanceFrame(queue.instances);
+		beginTransientFrame(transient);
+		{
+			PROFILE_SCOPE("streaming");
+			pumpAssetStreamer(streamer);
+			if (streamedScene != nullptr && isResident(streamedScene)) {
+				std::vector<Entity> streamed = instantiateSceneAsset(&registry, streamedScene->asset, mat2);
+				queuedObjs.insert(queuedObjs.end(), streamed.begin(), streamed.end());
+				streamedScene = nullptr;
+			}
+		}
+
+		updateCamera(win, camera);
+		updateWorldMatrices(&registry, jobs);
+
+		bool togglePressed = glfwGetKey(win, GLFW_KEY_F1);
+		if (togglePressed && !toggleHeld) {
+			gpuDriven = !gpuDriven;
+			spdlog::info("GPU driven rendering {}", gpuDriven ? "on" : "off");
+		}
+		toggleHeld = togglePressed;
+
+		bool occlusionPressed = glfwGetKey(win, GLFW_KEY_F2);
+		if (occlusionPressed && !occlusionHeld) {
+			culler.hiz = culler.hiz != nullptr ? nullptr : hiz;
+			spdlog::info("Occlusion culling {}", culler.hiz != nullptr ? "on" : "off");
+		}
+		occlusionHeld = occlusionPressed;
+
+		bool oitPressed = glfwGetKey(win, GLFW_KEY_F6);
+		if (oitPressed && !oitHeld) {
+			queue.oit = queue.oit != nullptr ? nullptr : oit;
+			spdlog::info("Order-independent transparency {}", queue.oit != nullptr ? "on" : "off");
+		}
+		oitHeld = oitPressed;
+
+		bool prepassPressed = glfwGetKey(win, GLFW_KEY_F7);
+		if (prepassPressed && !prepassHeld) {
+			queue.depthPrepass = queue.depthPrepass != nullptr ? nullptr : spDepthOnly;
+			spdlog::info("Depth pre-pass {}", queue.depthPrepass != nullptr ? "on" : "off");
+		}
+		prepassHeld = prepassPressed;
+
+		bool capturePressed = glfwGetKey(win, GLFW_KEY_F3);
+		if (capturePressed && !captureHeld) {
+			startProfilerCapture(&profiler, 120, "trace.json");
+			spdlog::info("Capturing 120 frames to trace.json");
+		}
+		captureHeld = capturePressed;
+
+		bool overlayPressed = glfwGetKey(win, GLFW_KEY_F4);
+		if (overlayPressed && !overlayHeld) {
+			profiler.overlay = !profiler.overlay;
+			if (!profiler.overlay) glfwSetWindowTitle(win, "Window");
+		}
+		overlayHeld = overlayPressed;
+
+		bool debugSyncPressed = glfwGetKey(win, GLFW_KEY_F5);
+		if (debugSyncPressed && !debugSyncHeld && debugOutput != nullptr) {
+			setGlDebugSynchronous(debugOutput, !debugOutput->synchronous);
+			spdlog::info("Synchronous GL debug output {}", debugOutput->synchronous ? "on" : "off");
+		}
+		debugSyncHeld = debugSyncPressed;
+
+		double now = glfwGetTime();
+		glm::ivec2 fbSize;
+		glfwGetFramebufferSize(win, &fbSize.x, &fbSize.y);
+		updateFrameConstants(frameConstants, camera, fbSize, now, now - lastTime, frame++);
+		lastTime = now;
+		queue.lodProjectionScale = lodProjectionScale(camera, static_cast<float>(fbSize.y));
+		resizeRenderTarget(sceneTarget, fbSize);
+		resizeOitTarget(oit, fbSize);
+
+		{
+			PROFILE_SCOPE("hiz readback");
+			updateHiZ(hiz);
+		}
+		if (materialTable != nullptr) uploadMaterialTable(materialTable);
+		beginCulling(&culler, frameConstants->data.viewProjection, camera->reversedZ);
+		{
+			PROFILE_PASS("light clusters");
+			for (size_t l = 0; l < lighting->lights.size(); l++) {
+				glm::vec4 orbit = lightOrbits[l];
+				lighting->lights[l].position = glm::vec3(orbit) + glm::vec3(0.0f, 0.5f * std::sin(static_cast<float>(now) + orbit.w), 0.0f);
+			}
+			updateClusteredLighting(lighting, camera, fbSize);
+		}
+
+
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneTarget->framebuffer);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+		if (gpuDriven) {
+			{
+				PROFILE_PASS("gpu scene");
+				uploadGpuScene(gpuScene);
+				cullGpuScene(gpuScene, culler.frustum);
+				drawGpuScene(gpuScene);
+			}
+			PROFILE_PASS("render queue");
+			clearRenderQueue(&queue);
+			submitEntities(&queue, camera, &registry, queuedObjs);
+			sortRenderQueue(&queue);
+			flushRenderQueue(&queue);
+		}
+		else {
+			PROFILE_PASS("render queue");
+			renderRegistryQueued(&queue, camera, &registry);
+		}
+		{
+			PROFILE_SCOPE("texture streaming");
+			updateTextureStreaming(textureStreamer);
+		}
+		{
+			PROFILE_PASS("hiz capture");
+			// blended draws leave depth untouched, so this is the opaque depth the next frames test against
+			captureHiZ(hiz, fbSize, frameConstants->data.viewProjection, camera->reversedZ);
+		}
+		endInstanceFrame(queue.instances);
+		endTransientFrame(transient);
+		presentRenderTarget(sceneTarget);
+
+		if (profiler.overlay) {
+			drawProfilerOverlay(&profiler, fbSize);
+			if (now - lastSummary > 0.5) {
+				glfwSetWindowTitle(win, profilerSummary(&profiler).c_str());
+				lastSummary = now;
+			}
+		}
+		endProfilerFrame(&profiler);
+
+		// nothing recorded this frame is read after the swap
+		resetFrameArena(&frameArena);
+		glfwSwapBuffers(win);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "mapped_file.hpp"
+
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static void mapFailed(const std::string& path) {
+	spdlog::error("Failed to map {}", path);
+	throw std::runtime_error("Failed to map " + path);
+}
+
+#ifdef _WIN32
+
+MappedFile* mapFile(const std::string& path) {
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) mapFailed(path);
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		mapFailed(path);
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (view == nullptr) {
+		if (mapping != nullptr) CloseHandle(mapping);
+		CloseHandle(file);
+		mapFailed(path);
+	}
+
+	MappedFile* mapped = new MappedFile();
+	mapped->data = static_cast<const uint8_t*>(view);
+	mapped->size = static_cast<size_t>(size.QuadPart);
+	mapped->file = file;
+	mapped->mapping = mapping;
+	return mapped;
+}
+
+void unmapFile(MappedFile* file) {
+	UnmapViewOfFile(file->data);
+	CloseHandle(file->mapping);
+	CloseHandle(file->file);
+	delete file;
+}
+
+#else
+
+MappedFile* mapFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) mapFailed(path);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		mapFailed(path);
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED) {
+		close(fd);
+		mapFailed(path);
+	}
+	// the whole file is about to be read front to back by the upload
+	madvise(view, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+	madvise(view, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+
+	MappedFile* mapped = new MappedFile();
+	mapped->data = static_cast<const uint8_t*>(view);
+	mapped->size = static_cast<size_t>(st.st_size);
+	mapped->fd = fd;
+	return mapped;
+}
+
+void unmapFile(MappedFile* file) {
+	munmap(const_cast<uint8_t*>(file->data), file->size);
+	close(file->fd);
+	delete file;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "material_table.hpp"
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+
+bool bindlessTexturesSupported() {
+	return GLAD_GL_ARB_bindless_texture != 0;
+}
+
+MaterialTable* createMaterialTable() {
+	return new MaterialTable();
+}
+
+void registerMaterial(MaterialTable* table, const Material* material) {
+	if (material->sortId >= table->materials.size()) {
+		table->materials.resize(material->sortId + 1, nullptr);
+		table->data.resize(material->sortId + 1, GpuMaterial{});
+	}
+	table->materials[material->sortId] = material;
+	table->dirty = true;
+}
+
+bool isRegistered(const MaterialTable* table, const Material* material) {
+	return material->sortId < table->materials.size() && table->materials[material->sortId] == material;
+}
+
+// a handle belongs to one texture object, streaming replaces the object and so needs a new handle
+static uint64_t residentHandle(Texture* texture) {
+	if (texture->bindlessOf != texture->handle) {
+		texture->bindlessHandle = glGetTextureHandleARB(texture->handle);
+		glMakeTextureHandleResidentARB(texture->bindlessHandle);
+		texture->bindlessOf = texture->handle;
+	}
+	return texture->bindlessHandle;
+}
+
+void uploadMaterialTable(MaterialTable* table) {
+	for (size_t i = 0; i < table->materials.size(); i++) {
+		const Material* material = table->materials[i];
+		if (material == nullptr) continue;
+
+		GpuMaterial entry{};
+		entry.color = material->color;
+		for (uint32_t t = 0; t < MATERIAL_TABLE_TEXTURES; t++) {
+			if (material->textures[t] != nullptr) entry.textures[t] = residentHandle(material->textures[t]);
+		}
+		if (std::memcmp(&entry, &table->data[i], sizeof(GpuMaterial)) == 0) continue;
+		table->data[i] = entry;
+		table->dirty = true;
+	}
+	if (!table->dirty) return;
+
+	uint32_t count = static_cast<uint32_t>(table->data.size());
+	if (count > table->capacity) {
+		if (table->buffer != 0) glDeleteBuffers(1, &table->buffer);
+		table->capacity = std::max(count, table->capacity * 2);
+		glCreateBuffers(1, &table->buffer);
+		glNamedBufferStorage(table->buffer, static_cast<GLsizeiptr>(table->capacity) * sizeof(GpuMaterial), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+	if (count > 0) glNamedBufferSubData(table->buffer, 0, static_cast<GLsizeiptr>(count) * sizeof(GpuMaterial), table->data.data());
+	countUpload(static_cast<uint64_t>(count) * sizeof(GpuMaterial));
+	table->dirty = false;
+}
+
+void bindMaterialTable(const MaterialTable* table) {
+	if (table->buffer != 0) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_TABLE_BINDING, table->buffer);
+}
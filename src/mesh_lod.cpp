@@ -0,0 +1,226 @@
+#include "mesh_lod.hpp"
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <unordered_map>
+
+// symmetric 4x4, upper triangle row by row
+struct Quadric {
+	double a[10] = {};
+};
+
+static Quadric planeQuadric(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+	glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+	float length = glm::length(n);
+	Quadric q;
+	if (length <= 0.0f) return q;
+
+	double x = n.x / length, y = n.y / length, z = n.z / length;
+	double d = -(x * p0.x + y * p0.y + z * p0.z);
+	double v[10] = { x * x, x * y, x * z, x * d, y * y, y * z, y * d, z * z, z * d, d * d };
+	std::copy(v, v + 10, q.a);
+	return q;
+}
+
+static void accumulate(Quadric& q, const Quadric& o) {
+	for (int i = 0; i < 10; i++) q.a[i] += o.a[i];
+}
+
+// summed squared distance of p to every plane in the quadric
+static double evaluate(const Quadric& q, const glm::vec3& p) {
+	const double* a = q.a;
+	double x = p.x, y = p.y, z = p.z;
+	return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+		+ a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+		+ a[7] * z * z + 2 * a[8] * z
+		+ a[9];
+}
+
+struct Collapse {
+	double cost;
+	uint32_t from, to;
+	uint32_t fromStamp, toStamp;
+
+	bool operator>(const Collapse& o) const { return cost > o.cost; }
+};
+
+std::vector<uint32_t> simplifyMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices, size_t targetIndexCount, float* error) {
+	size_t vertexCount = vertices.size();
+	size_t triangleCount = indices.size() / 3;
+
+	std::vector<glm::vec3> positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) positions[v] = glm::vec3(vertices[v].position);
+
+	std::vector<uint32_t> tris(indices.begin(), indices.begin() + triangleCount * 3);
+	std::vector<bool> triAlive(triangleCount, true);
+	std::vector<std::vector<uint32_t>> vertexTris(vertexCount);
+	std::vector<Quadric> quadrics(vertexCount);
+
+	// an edge used by one triangle is on a border or a seam between unwelded vertices
+	std::unordered_map<uint64_t, uint32_t> edgeUse;
+	auto edgeKey = [](uint32_t a, uint32_t b) { return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b); };
+
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		uint32_t i0 = tris[t * 3], i1 = tris[t * 3 + 1], i2 = tris[t * 3 + 2];
+		Quadric q = planeQuadric(positions[i0], positions[i1], positions[i2]);
+		for (int c = 0; c < 3; c++) {
+			uint32_t v = tris[t * 3 + c];
+			vertexTris[v].push_back(t);
+			accumulate(quadrics[v], q);
+			edgeUse[edgeKey(v, tris[t * 3 + (c + 1) % 3])]++;
+		}
+	}
+
+	std::vector<bool> locked(vertexCount, false);
+	for (const auto& [key, count] : edgeUse) {
+		if (count != 1) continue;
+		locked[static_cast<uint32_t>(key >> 32)] = true;
+		locked[static_cast<uint32_t>(key)] = true;
+	}
+
+	std::vector<bool> vertexAlive(vertexCount, true);
+	std::vector<uint32_t> stamps(vertexCount, 0);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+	auto push = [&](uint32_t from, uint32_t to) {
+		if (locked[from]) return;
+		Quadric q = quadrics[from];
+		accumulate(q, quadrics[to]);
+		heap.push({ evaluate(q, positions[to]), from, to, stamps[from], stamps[to] });
+	};
+
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		for (int c = 0; c < 3; c++) {
+			uint32_t a = tris[t * 3 + c], b = tris[t * 3 + (c + 1) % 3];
+			push(a, b);
+			push(b, a);
+		}
+	}
+
+	auto contains = [&](uint32_t t, uint32_t v) {
+		return tris[t * 3] == v || tris[t * 3 + 1] == v || tris[t * 3 + 2] == v;
+	};
+
+	// rejects collapses that fold a remaining triangle over
+	auto flips = [&](uint32_t from, uint32_t to) {
+		for (uint32_t t : vertexTris[from]) {
+			if (!triAlive[t] || contains(t, to)) continue;
+
+			glm::vec3 p[3], moved[3];
+			for (int c = 0; c < 3; c++) {
+				uint32_t v = tris[t * 3 + c];
+				p[c] = positions[v];
+				moved[c] = v == from ? positions[to] : p[c];
+			}
+			glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			if (glm::dot(before, after) <= 0.0f) return true;
+		}
+		return false;
+	};
+
+	size_t liveTriangles = triangleCount;
+	double maxCost = 0.0;
+
+	while (liveTriangles * 3 > targetIndexCount && !heap.empty()) {
+		Collapse c = heap.top();
+		heap.pop();
+
+		if (!vertexAlive[c.from] || !vertexAlive[c.to]) continue;
+		if (stamps[c.from] != c.fromStamp || stamps[c.to] != c.toStamp) continue;
+
+		bool adjacent = false;
+		for (uint32_t t : vertexTris[c.from]) {
+			if (triAlive[t] && contains(t, c.to)) {
+				adjacent = true;
+				break;
+			}
+		}
+		if (!adjacent || flips(c.from, c.to)) continue;
+
+		for (uint32_t t : vertexTris[c.from]) {
+			if (!triAlive[t]) continue;
+			if (contains(t, c.to)) {
+				triAlive[t] = false;
+				liveTriangles--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++) {
+				if (tris[t * 3 + k] == c.from) tris[t * 3 + k] = c.to;
+			}
+			vertexTris[c.to].push_back(t);
+		}
+
+		vertexAlive[c.from] = false;
+		accumulate(quadrics[c.to], quadrics[c.from]);
+		stamps[c.to]++;
+		maxCost = std::max(maxCost, c.cost);
+
+		for (uint32_t t : vertexTris[c.to]) {
+			if (!triAlive[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				uint32_t w = tris[t * 3 + k];
+				if (w == c.to) continue;
+				push(c.to, w);
+				push(w, c.to);
+			}
+		}
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(liveTriangles * 3);
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		if (triAlive[t]) result.insert(result.end(), tris.begin() + t * 3, tris.begin() + t * 3 + 3);
+	}
+
+	if (error != nullptr) *error = static_cast<float>(std::sqrt(maxCost));
+	return result;
+}
+
+LodChain* generateLodChain(std::span<const Vertex> vertices, std::span<const uint32_t> indices, const VertexLayout& layout, uint32_t maxLevels, float ratio) {
+	LodChain* chain = new LodChain();
+	chain->levels.push_back({ createMesh(vertices, indices, PrimitiveFormat::Triangles, layout), 0.0f });
+
+	size_t previous = indices.size();
+	for (uint32_t level = 1; level < maxLevels; level++) {
+		size_t target = static_cast<size_t>(static_cast<float>(previous) * ratio) / 3 * 3;
+		float error = 0.0f;
+		std::vector<uint32_t> lod = simplifyMesh(vertices, indices, target, &error);
+
+		// under 10% fewer triangles is not worth another level
+		if (lod.empty() || lod.size() * 10 > previous * 9) break;
+		previous = lod.size();
+
+		std::vector<Vertex> compact(vertices.begin(), vertices.end());
+		optimizeVertexFetch(compact, lod);
+		error = std::max(error, chain->levels.back().error);
+		chain->levels.push_back({ createMesh(std::move(compact), std::move(lod), PrimitiveFormat::Triangles, layout), error });
+	}
+	return chain;
+}
+
+float lodProjectionScale(const Camera* camera, float viewportHeight) {
+	return viewportHeight / (2.0f * std::tan(glm::radians(camera->fov) * 0.5f));
+}
+
+LodSelection selectLod(const LodChain* chain, float distance, float scale, float projectionScale) {
+	uint32_t count = static_cast<uint32_t>(chain->levels.size());
+	float pixelsPerUnit = projectionScale * scale / std::max(distance, 1e-4f);
+
+	uint32_t level = 0;
+	while (level + 1 < count && chain->levels[level + 1].error * pixelsPerUnit <= LOD_PIXEL_ERROR) level++;
+
+	LodSelection selection{ level, level, 0.0f };
+	if (level + 1 < count) {
+		// the next level is acceptable from switchDistance on, dither towards it just before
+		float switchDistance = chain->levels[level + 1].error * projectionScale * scale / LOD_PIXEL_ERROR;
+		float fadeStart = switchDistance * (1.0f - LOD_FADE_BAND);
+		if (distance > fadeStart && switchDistance > fadeStart) {
+			selection.next = level + 1;
+			selection.fade = (distance - fadeStart) / (switchDistance - fadeStart);
+		}
+	}
+	return selection;
+}
@@ -0,0 +1,206 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+#include <unordered_map>
+
+void deduplicateVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	// Vertex has no padding, so equal bytes means equal vertex
+	std::unordered_map<std::string_view, uint32_t> unique;
+	unique.reserve(vertices.size());
+
+	std::vector<uint32_t> remap(vertices.size());
+	std::vector<Vertex> merged;
+	merged.reserve(vertices.size());
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		std::string_view bytes(reinterpret_cast<const char*>(&vertices[i]), sizeof(Vertex));
+		auto [it, inserted] = unique.try_emplace(bytes, static_cast<uint32_t>(merged.size()));
+		if (inserted) merged.push_back(vertices[i]);
+		remap[i] = it->second;
+	}
+
+	for (uint32_t& index : indices) index = remap[index];
+	vertices = std::move(merged);
+}
+
+struct Adjacency {
+	std::vector<uint32_t> offsets; // per vertex, into triangles
+	std::vector<uint32_t> triangles;
+};
+
+static Adjacency buildAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount) {
+	Adjacency adj;
+	adj.offsets.assign(vertexCount + 1, 0);
+	for (uint32_t v : indices) adj.offsets[v + 1]++;
+	for (size_t v = 1; v <= vertexCount; v++) adj.offsets[v] += adj.offsets[v - 1];
+
+	adj.triangles.resize(indices.size());
+	std::vector<uint32_t> fill(adj.offsets.begin(), adj.offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adj.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+	return adj;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>* clusters) {
+	// Sander et al. 2007, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) return;
+
+	Adjacency adj = buildAdjacency(indices, vertexCount);
+	std::vector<uint32_t> live(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) live[v] = adj.offsets[v + 1] - adj.offsets[v];
+
+	constexpr uint32_t k = MESH_VERTEX_CACHE_SIZE;
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	uint32_t time = k + 1;
+	uint32_t cursor = 0;
+	int64_t fan = 0;
+	if (clusters != nullptr) clusters->assign(1, 0);
+
+	while (fan >= 0) {
+		candidates.clear();
+		for (uint32_t a = adj.offsets[fan]; a < adj.offsets[fan + 1]; a++) {
+			uint32_t t = adj.triangles[a];
+			if (emitted[t]) continue;
+
+			for (int c = 0; c < 3; c++) {
+				uint32_t v = indices[t * 3 + c];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > k) cacheTime[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// the candidate that is still in the cache and has the fewest triangles left
+		int64_t next = -1;
+		int64_t best = -1;
+		for (uint32_t v : candidates) {
+			if (live[v] == 0) continue;
+			int64_t priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= k) priority = time - cacheTime[v];
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next < 0) {
+			// dead end, back up through recently used vertices and then scan in input order
+			while (!deadEnd.empty() && next < 0) {
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0) next = v;
+			}
+			while (next < 0 && cursor < vertexCount) {
+				if (live[cursor] > 0) next = cursor;
+				cursor++;
+			}
+			if (next >= 0 && clusters != nullptr && result.size() < indices.size()) {
+				clusters->push_back(static_cast<uint32_t>(result.size()));
+			}
+		}
+		fan = next;
+	}
+
+	indices = std::move(result);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters) {
+	// clusters facing away from the mesh center are likely to occlude the rest, draw them first
+	if (clusters.size() < 2) return;
+
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+
+	struct Cluster {
+		uint32_t begin, end;
+		glm::vec3 center;
+		glm::vec3 normal;
+		float area;
+		float sortKey;
+	};
+	std::vector<Cluster> list;
+	list.reserve(clusters.size());
+
+	for (size_t c = 0; c < clusters.size(); c++) {
+		Cluster cluster{ clusters[c], c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(indices.size()), glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f };
+		for (uint32_t i = cluster.begin; i < cluster.end; i += 3) {
+			glm::vec3 a(vertices[indices[i]].position), b(vertices[indices[i + 1]].position), d(vertices[indices[i + 2]].position);
+			glm::vec3 n = glm::cross(b - a, d - a);
+			float area = glm::length(n);
+			cluster.center += (a + b + d) * (area / 3.0f);
+			cluster.normal += n;
+			cluster.area += area;
+		}
+		meshCenter += cluster.center;
+		meshArea += cluster.area;
+		if (cluster.area > 0.0f) cluster.center /= cluster.area;
+		list.push_back(cluster);
+	}
+	if (meshArea > 0.0f) meshCenter /= meshArea;
+
+	for (Cluster& cluster : list) {
+		float length = glm::length(cluster.normal);
+		cluster.sortKey = length > 0.0f ? glm::dot(cluster.center - meshCenter, cluster.normal / length) : 0.0f;
+	}
+	std::stable_sort(list.begin(), list.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (const Cluster& cluster : list) {
+		result.insert(result.end(), indices.begin() + cluster.begin, indices.begin() + cluster.end);
+	}
+	indices = std::move(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	constexpr uint32_t unused = 0xFFFFFFFF;
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<Vertex> ordered;
+	ordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == unused) {
+			remap[index] = static_cast<uint32_t>(ordered.size());
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices = std::move(ordered);
+}
+
+void optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	deduplicateVertices(vertices, indices);
+
+	std::vector<uint32_t> clusters;
+	optimizeVertexCache(indices, vertices.size(), &clusters);
+	optimizeOverdraw(indices, vertices, clusters);
+	optimizeVertexFetch(vertices, indices);
+}
+
+float averageCacheMissRatio(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+	if (indices.size() < 3) return 0.0f;
+
+	// a vertex is cached while fewer than cacheSize misses happened since it was loaded
+	std::vector<uint64_t> loadedAt(vertexCount, 0);
+	uint64_t misses = 0;
+	for (uint32_t v : indices) {
+		if (loadedAt[v] == 0 || misses + 1 - loadedAt[v] > cacheSize) {
+			misses++;
+			loadedAt[v] = misses;
+		}
+	}
+	return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+}
@@ -0,0 +1,113 @@
+#include "oit.hpp"
+#include "gl_state.hpp"
+#include "profiler.hpp"
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+OitTarget* createOitTarget(ShaderProgram* compositeProgram, GLenum depthFormat) {
+	OitTarget* oit = new OitTarget();
+	oit->compositeProgram = compositeProgram;
+	oit->depthFormat = depthFormat;
+	glCreateVertexArrays(1, &oit->vao);
+	return oit;
+}
+
+static uint32_t createTarget(GLenum internalFormat, glm::ivec2 size) {
+	uint32_t handle;
+	glCreateTextures(GL_TEXTURE_2D, 1, &handle);
+	glTextureStorage2D(handle, 1, internalFormat, size.x, size.y);
+	glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	return handle;
+}
+
+void resizeOitTarget(OitTarget* oit, glm::ivec2 size) {
+	if (size == oit->size || size.x <= 0 || size.y <= 0) return;
+
+	if (oit->framebuffer != 0) {
+		for (uint32_t texture : { oit->accumulation, oit->revealage, oit->depth }) forgetTexture(&glState, texture);
+		uint32_t textures[] = { oit->accumulation, oit->revealage, oit->depth };
+		glDeleteTextures(3, textures);
+		glDeleteFramebuffers(1, &oit->framebuffer);
+	}
+
+	oit->size = size;
+	oit->accumulation = createTarget(GL_RGBA16F, size);
+	oit->revealage = createTarget(GL_R8, size);
+	// the depth attachment follows the target, see attachDepth
+	oit->depth = 0;
+	oit->attachedDepth = 0;
+
+	glCreateFramebuffers(1, &oit->framebuffer);
+	glNamedFramebufferTexture(oit->framebuffer, GL_COLOR_ATTACHMENT0, oit->accumulation, 0);
+	glNamedFramebufferTexture(oit->framebuffer, GL_COLOR_ATTACHMENT1, oit->revealage, 0);
+	GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(oit->framebuffer, 2, drawBuffers);
+}
+
+// an offscreen target's depth is attached as is, only the window's needs a copy of its own.
+// the target is resized along with this, which remakes the framebuffer, so a reused renderbuffer name never passes for the attached one
+static void attachDepth(OitTarget* oit) {
+	uint32_t depth;
+	if (oit->target != nullptr) {
+		depth = oit->target->depth;
+		if (depth == oit->attachedDepth) return;
+		glNamedFramebufferRenderbuffer(oit->framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+	}
+	else {
+		if (oit->depth == 0) oit->depth = createTarget(oit->depthFormat, oit->size);
+		depth = oit->depth;
+		if (depth == oit->attachedDepth) return;
+		glNamedFramebufferTexture(oit->framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, depth, 0);
+	}
+	oit->attachedDepth = depth;
+
+	if (glCheckNamedFramebufferStatus(oit->framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		spdlog::error("OIT framebuffer of {}x{} is incomplete", oit->size.x, oit->size.y);
+		throw std::runtime_error("OIT framebuffer is incomplete");
+	}
+}
+
+void beginOitAccumulation(OitTarget* oit) {
+	PROFILE_SCOPE("oit accumulate");
+	attachDepth(oit);
+	if (oit->target == nullptr) {
+		glm::ivec2 s = oit->size;
+		glBlitNamedFramebuffer(0, oit->framebuffer, 0, 0, s.x, s.y, 0, 0, s.x, s.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+
+	const float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float one[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glClearNamedFramebufferfv(oit->framebuffer, GL_COLOR, 0, zero);
+	glClearNamedFramebufferfv(oit->framebuffer, GL_COLOR, 1, one);
+	glBindFramebuffer(GL_FRAMEBUFFER, oit->framebuffer);
+
+	setBlend(&glState, true);
+	setDepthTest(&glState, true);
+	setDepthWrite(&glState, false);
+	glBlendFunci(0, GL_ONE, GL_ONE);
+	glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+	// glBlendFunci went around the cache
+	glState.blendSrc = GL_STATE_UNKNOWN;
+	glState.blendDst = GL_STATE_UNKNOWN;
+}
+
+void resolveOit(OitTarget* oit) {
+	PROFILE_SCOPE("oit resolve");
+	glBindFramebuffer(GL_FRAMEBUFFER, oit->target != nullptr ? oit->target->framebuffer : 0);
+
+	// colour = average * (1 - revealage) + destination * revealage
+	setBlend(&glState, true);
+	setBlendFunc(&glState, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+	setDepthTest(&glState, false);
+	bindProgram(&glState, oit->compositeProgram->handle);
+	bindTexture(&glState, OIT_ACCUMULATION_UNIT, oit->accumulation);
+	bindTexture(&glState, OIT_REVEALAGE_UNIT, oit->revealage);
+	bindVertexArray(&glState, oit->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	countDrawCall(1);
+
+	setDepthTest(&glState, true);
+}
@@ -0,0 +1,209 @@
+#include "profiler.hpp"
+#include "gl_state.hpp"
+#include "job_system.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+Profiler profiler;
+
+static const auto epoch = std::chrono::steady_clock::now();
+static thread_local uint32_t scopeDepth = 0;
+
+uint64_t profilerNow() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void beginProfilerFrame(Profiler* p) {
+	std::lock_guard<std::mutex> lock(p->mutex);
+	p->current.index = p->frameIndex;
+	p->current.begin = profilerNow();
+}
+
+static void completeFrame(Profiler* p, ProfilerFrame& frame) {
+	if (p->captureFrames > 0) {
+		p->capture.push_back(frame);
+		if (--p->captureFrames == 0) {
+			writeChromeTrace(p->capture, p->capturePath);
+			spdlog::info("Wrote {} profiled frames to {}", p->capture.size(), p->capturePath);
+			p->capture.clear();
+		}
+	}
+	p->last = std::move(frame);
+}
+
+void endProfilerFrame(Profiler* p) {
+	if (p->gpuScopeOpen) endGpuScope(p);
+	std::lock_guard<std::mutex> lock(p->mutex);
+	p->current.end = profilerNow();
+	p->current.counters.stateChanges = glState.counters.issued;
+
+	if (p->hasPending) {
+		// recorded a whole frame ago, the results are almost always in. waiting for a late one would stall
+		std::vector<GpuTimer>& timers = p->timers[p->pending.index % PROFILER_QUERY_FRAMES];
+		for (const GpuTimer& t : timers) {
+			GLint available = 0;
+			glGetQueryObjectiv(t.query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available) {
+				GLuint64 ns;
+				glGetQueryObjectui64v(t.query, GL_QUERY_RESULT, &ns);
+				p->pending.gpu.push_back({ t.name, t.cpuBegin, ns });
+			}
+			else p->pending.gpuDropped++;
+			p->freeQueries.push_back(t.query);
+		}
+		timers.clear();
+		completeFrame(p, p->pending);
+	}
+
+	p->pending = std::move(p->current);
+	p->hasPending = true;
+	p->current = ProfilerFrame();
+	p->frameIndex++;
+}
+
+ProfileScope::ProfileScope(const char* name) : name(name), begin(profilerNow()), depth(scopeDepth++) {}
+
+ProfileScope::~ProfileScope() {
+	scopeDepth--;
+	if (!profiler.enabled) return;
+	uint64_t end = profilerNow();
+	std::lock_guard<std::mutex> lock(profiler.mutex);
+	profiler.current.cpu.push_back({ name, jobThreadIndex(), depth, begin, end });
+}
+
+bool beginGpuScope(Profiler* p, const char* name) {
+	std::vector<GpuTimer>& timers = p->timers[p->frameIndex % PROFILER_QUERY_FRAMES];
+	if (!p->enabled || p->gpuScopeOpen || timers.size() >= PROFILER_MAX_GPU_SCOPES) return false;
+
+	uint32_t query;
+	if (!p->freeQueries.empty()) {
+		query = p->freeQueries.back();
+		p->freeQueries.pop_back();
+	}
+	else glGenQueries(1, &query);
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	timers.push_back({ name, profilerNow(), query });
+	p->gpuScopeOpen = true;
+	return true;
+}
+
+void endGpuScope(Profiler* p) {
+	if (!p->gpuScopeOpen) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	p->gpuScopeOpen = false;
+}
+
+ProfilePass::ProfilePass(const char* name) : cpu(name), gpu(beginGpuScope(&profiler, name)) {}
+
+ProfilePass::~ProfilePass() {
+	if (gpu) endGpuScope(&profiler);
+}
+
+uint64_t primitiveTriangles(GLenum mode, uint64_t count) {
+	if (mode == GL_TRIANGLES) return count / 3;
+	if (mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) return count >= 3 ? count - 2 : 0;
+	return 0;
+}
+
+void startProfilerCapture(Profiler* p, uint32_t frames, const std::string& path) {
+	p->capture.clear();
+	p->captureFrames = frames;
+	p->capturePath = path;
+}
+
+static double micros(uint64_t ns) {
+	return static_cast<double>(ns) / 1000.0;
+}
+
+void writeChromeTrace(const std::vector<ProfilerFrame>& frames, const std::string& path) {
+	std::ofstream out(path);
+	if (!out) {
+		spdlog::error("Failed to open {} for the trace", path);
+		return;
+	}
+
+	// names are string literals from the engine, nothing in them needs escaping
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}},\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"main\"}}";
+	for (const ProfilerFrame& f : frames) {
+		out << fmt::format(",\n{{\"name\":\"frame {}\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":0,\"tid\":0}}",
+			f.index, micros(f.begin), micros(f.end - f.begin));
+		for (const ProfileEvent& e : f.cpu) {
+			out << fmt::format(",\n{{\"name\":\"{}\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":0,\"tid\":{}}}",
+				e.name, micros(e.begin), micros(e.end - e.begin), e.thread);
+		}
+		for (const GpuScopeResult& g : f.gpu) {
+			out << fmt::format(",\n{{\"name\":\"{}\",\"cat\":\"gpu\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":0}}",
+				g.name, micros(g.cpuBegin), micros(g.gpuNanoseconds));
+		}
+		const FrameCounters& c = f.counters;
+		out << fmt::format(",\n{{\"name\":\"counters\",\"ph\":\"C\",\"ts\":{:.3f},\"pid\":0,\"args\":{{\"drawCalls\":{},\"triangles\":{},\"stateChanges\":{},\"uploadBytes\":{},\"performanceWarnings\":{}}}}}",
+			micros(f.begin), c.drawCalls, c.triangles, c.stateChanges, c.uploadBytes, c.performanceWarnings);
+	}
+	out << "\n]}\n";
+}
+
+std::string profilerSummary(const Profiler* p) {
+	const ProfilerFrame& f = p->last;
+	uint64_t gpu = 0;
+	for (const GpuScopeResult& g : f.gpu) gpu += g.gpuNanoseconds;
+
+	const ProfileEvent* slowest = nullptr;
+	for (const ProfileEvent& e : f.cpu) {
+		if (e.thread == 0 && e.depth == 0 && (slowest == nullptr || e.end - e.begin > slowest->end - slowest->begin)) slowest = &e;
+	}
+
+	const FrameCounters& c = f.counters;
+	std::string s = fmt::format("frame {:.2f} ms | gpu {:.2f} ms | {} draws, {} tris, {} state changes, {:.1f} KB uploaded",
+		(f.end - f.begin) / 1e6, gpu / 1e6, c.drawCalls, c.triangles, c.stateChanges, c.uploadBytes / 1024.0);
+	if (c.performanceWarnings > 0) s += fmt::format(" | {} GL performance warnings", c.performanceWarnings);
+	if (slowest != nullptr) s += fmt::format(" | slowest {} {:.2f} ms", slowest->name, (slowest->end - slowest->begin) / 1e6);
+	return s;
+}
+
+static glm::vec3 scopeColor(const char* name) {
+	uint32_t h = 2166136261u;
+	for (const char* c = name; *c; c++) h = (h ^ static_cast<uint8_t>(*c)) * 16777619u;
+	return glm::vec3((h & 0xFF) / 255.0f, ((h >> 8) & 0xFF) / 255.0f, ((h >> 16) & 0xFF) / 255.0f) * 0.7f + 0.3f;
+}
+
+static void drawBar(glm::ivec2 framebufferSize, int row, double from, double to, glm::vec3 color) {
+	constexpr int ROW_HEIGHT = 8;
+	int x0 = static_cast<int>(from / PROFILER_OVERLAY_SPAN * framebufferSize.x);
+	int x1 = static_cast<int>(to / PROFILER_OVERLAY_SPAN * framebufferSize.x);
+	if (x1 <= x0) x1 = x0 + 1;
+	glScissor(x0, framebufferSize.y - (row + 1) * ROW_HEIGHT, x1 - x0, ROW_HEIGHT - 1);
+	glClearColor(color.r, color.g, color.b, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void drawProfilerOverlay(const Profiler* p, glm::ivec2 framebufferSize) {
+	if (framebufferSize.x <= 0 || framebufferSize.y <= 0) return;
+	const ProfilerFrame& f = p->last;
+
+	GLfloat clear[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clear);
+	glEnable(GL_SCISSOR_TEST);
+
+	// the frame, then main thread scopes where they ran, then GPU passes back to back
+	drawBar(framebufferSize, 0, 0.0, (f.end - f.begin) / 1e9, glm::vec3(0.2f));
+	for (const ProfileEvent& e : f.cpu) {
+		if (e.thread != 0 || e.depth != 0) continue;
+		drawBar(framebufferSize, 1, (e.begin - f.begin) / 1e9, (e.end - f.begin) / 1e9, scopeColor(e.name));
+	}
+	double at = 0.0;
+	for (const GpuScopeResult& g : f.gpu) {
+		double length = g.gpuNanoseconds / 1e9;
+		drawBar(framebufferSize, 2, at, at + length, scopeColor(g.name));
+		at += length;
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+	glClearColor(clear[0], clear[1], clear[2], clear[3]);
+}
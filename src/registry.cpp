@@ -0,0 +1,381 @@
+#include "registry.hpp"
+#include "profiler.hpp"
+#include "transform_kernel.hpp"
+#include "mesh_lod.hpp"
+#include "job_system.hpp"
+#include "frame_arena.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <stdexcept>
+
+static uint32_t allocateSlot(Registry* registry, uint32_t dense) {
+	uint32_t slot;
+	if (!registry->freeSlots.empty()) {
+		slot = registry->freeSlots.back();
+		registry->freeSlots.pop_back();
+	}
+	else {
+		slot = static_cast<uint32_t>(registry->generations.size());
+		registry->generations.push_back(0);
+		registry->slotToDense.push_back(0);
+	}
+	registry->slotToDense[slot] = dense;
+	return slot;
+}
+
+static void pushComponents(Registry* registry, uint32_t slot, Mesh* mesh, Material* material, const Transform& transform) {
+	registry->denseToSlot.push_back(slot);
+	registry->positions.push_back(transform.position);
+	registry->rotations.push_back(transform.rotation);
+	registry->scales.push_back(transform.scale);
+	registry->meshes.push_back(mesh);
+	registry->lodChains.push_back(nullptr);
+	registry->materials.push_back(material);
+	registry->worldMatrices.push_back(createModelMatrix(transform));
+	Aabb bounds = mesh != nullptr ? mesh->bounds : Aabb{ glm::vec3(0.0f), glm::vec3(0.0f) };
+	registry->localBounds.push_back(bounds);
+	registry->worldBounds.push_back(transformAabb(registry->worldMatrices.back(), bounds));
+	registry->spatialLeaves.push_back(registry->spatial != nullptr ? insertBvhLeaf(registry->spatial, registry->worldBounds.back(), slot) : BVH_NULL);
+
+	registry->parents.push_back(NULL_ENTITY);
+	registry->firstChildren.push_back(NULL_ENTITY);
+	registry->nextSiblings.push_back(NULL_ENTITY);
+	registry->prevSiblings.push_back(NULL_ENTITY);
+	registry->dirty.push_back(0);
+	registry->orderDirty = true;
+}
+
+Entity createEntity(Registry* registry, Mesh* mesh, Material* material, const Transform& transform) {
+	uint32_t dense = static_cast<uint32_t>(registry->denseToSlot.size());
+	uint32_t slot = allocateSlot(registry, dense);
+	pushComponents(registry, slot, mesh, material, transform);
+	if (mesh != nullptr && material != nullptr) checkVertexLayout(mesh, material);
+	return { slot, registry->generations[slot] };
+}
+
+std::vector<Entity> createEntities(Registry* registry, const GameObject* prefab, size_t count) {
+	size_t total = registry->denseToSlot.size() + count;
+	registry->denseToSlot.reserve(total);
+	registry->positions.reserve(total);
+	registry->rotations.reserve(total);
+	registry->scales.reserve(total);
+	registry->meshes.reserve(total);
+	registry->lodChains.reserve(total);
+	registry->materials.reserve(total);
+	registry->worldMatrices.reserve(total);
+	registry->localBounds.reserve(total);
+	registry->worldBounds.reserve(total);
+	registry->spatialLeaves.reserve(total);
+	registry->parents.reserve(total);
+	registry->firstChildren.reserve(total);
+	registry->nextSiblings.reserve(total);
+	registry->prevSiblings.reserve(total);
+	registry->dirty.reserve(total);
+
+	std::vector<Entity> entities(count);
+	for (size_t i = 0; i < count; i++) {
+		entities[i] = createEntity(registry, prefab->meshRenderer.mesh, prefab->meshRenderer.material, prefab->transform);
+		registry->lodChains.back() = prefab->meshRenderer.lods;
+	}
+	return entities;
+}
+
+template<typename T>
+static void swapRemove(std::vector<T>& v, uint32_t i) {
+	v[i] = v.back();
+	v.pop_back();
+}
+
+void destroyEntity(Registry* registry, Entity e) {
+	while (true) {
+		Entity child = registry->firstChildren[denseIndexOf(registry, e)];
+		if (child == NULL_ENTITY) break;
+		setParent(registry, child, NULL_ENTITY);
+	}
+	setParent(registry, e, NULL_ENTITY);
+
+	uint32_t dense = denseIndexOf(registry, e);
+	uint32_t last = static_cast<uint32_t>(registry->denseToSlot.size() - 1);
+
+	uint32_t movedSlot = registry->denseToSlot[last];
+	registry->slotToDense[movedSlot] = dense;
+
+	if (registry->dirty[dense]) registry->dirtyCount--;
+	if (registry->spatialLeaves[dense] != BVH_NULL) removeBvhLeaf(registry->spatial, registry->spatialLeaves[dense]);
+
+	swapRemove(registry->denseToSlot, dense);
+	swapRemove(registry->positions, dense);
+	swapRemove(registry->rotations, dense);
+	swapRemove(registry->scales, dense);
+	swapRemove(registry->meshes, dense);
+	swapRemove(registry->lodChains, dense);
+	swapRemove(registry->materials, dense);
+	swapRemove(registry->worldMatrices, dense);
+	swapRemove(registry->localBounds, dense);
+	swapRemove(registry->worldBounds, dense);
+	swapRemove(registry->spatialLeaves, dense);
+	swapRemove(registry->parents, dense);
+	swapRemove(registry->firstChildren, dense);
+	swapRemove(registry->nextSiblings, dense);
+	swapRemove(registry->prevSiblings, dense);
+	swapRemove(registry->dirty, dense);
+	registry->orderDirty = true;
+
+	registry->generations[e.slot]++;
+	registry->freeSlots.push_back(e.slot);
+}
+
+bool isAlive(const Registry* registry, Entity e) {
+	return e.slot < registry->generations.size() && registry->generations[e.slot] == e.generation;
+}
+
+uint32_t denseIndexOf(const Registry* registry, Entity e) {
+	if (!isAlive(registry, e)) {
+		spdlog::error("Stale entity handle {}:{}", e.slot, e.generation);
+		throw std::runtime_error("Stale entity handle");
+	}
+	return registry->slotToDense[e.slot];
+}
+
+size_t entityCount(const Registry* registry) {
+	return registry->denseToSlot.size();
+}
+
+Entity entityAt(const Registry* registry, uint32_t dense) {
+	uint32_t slot = registry->denseToSlot[dense];
+	return { slot, registry->generations[slot] };
+}
+
+Transform getTransform(const Registry* registry, Entity e) {
+	uint32_t i = denseIndexOf(registry, e);
+	return { registry->positions[i], registry->rotations[i], registry->scales[i] };
+}
+
+static void markDenseDirty(Registry* registry, uint32_t i) {
+	if (!registry->dirty[i]) {
+		registry->dirty[i] = 1;
+		registry->dirtyCount++;
+	}
+}
+
+void markDirty(Registry* registry, Entity e) {
+	markDenseDirty(registry, denseIndexOf(registry, e));
+}
+
+void setTransform(Registry* registry, Entity e, const Transform& transform) {
+	uint32_t i = denseIndexOf(registry, e);
+	registry->positions[i] = transform.position;
+	registry->rotations[i] = transform.rotation;
+	registry->scales[i] = transform.scale;
+	markDenseDirty(registry, i);
+}
+
+void setPosition(Registry* registry, Entity e, const glm::vec3& position) {
+	uint32_t i = denseIndexOf(registry, e);
+	registry->positions[i] = position;
+	markDenseDirty(registry, i);
+}
+
+void setRotation(Registry* registry, Entity e, const glm::fquat& rotation) {
+	uint32_t i = denseIndexOf(registry, e);
+	registry->rotations[i] = rotation;
+	markDenseDirty(registry, i);
+}
+
+void setScale(Registry* registry, Entity e, const glm::vec3& scale) {
+	uint32_t i = denseIndexOf(registry, e);
+	registry->scales[i] = scale;
+	markDenseDirty(registry, i);
+}
+
+void setMaterial(Registry* registry, Entity e, Material* material) {
+	uint32_t i = denseIndexOf(registry, e);
+	registry->materials[i] = material;
+	if (registry->meshes[i] != nullptr) checkVertexLayout(registry->meshes[i], material);
+}
+
+void setLodChain(Registry* registry, Entity e, const LodChain* lods) {
+	uint32_t i = denseIndexOf(registry, e);
+	registry->lodChains[i] = lods;
+	if (lods == nullptr) return;
+
+	// bounds and culling always use the full detail mesh
+	registry->meshes[i] = lods->levels[0].mesh;
+	registry->localBounds[i] = lods->levels[0].mesh->bounds;
+	markDenseDirty(registry, i);
+}
+
+Mesh* meshOf(const Registry* registry, Entity e) {
+	return registry->meshes[denseIndexOf(registry, e)];
+}
+
+Material* materialOf(const Registry* registry, Entity e) {
+	return registry->materials[denseIndexOf(registry, e)];
+}
+
+static void unlink(Registry* registry, uint32_t i) {
+	Entity parent = registry->parents[i];
+	if (parent == NULL_ENTITY) return;
+
+	Entity prev = registry->prevSiblings[i];
+	Entity next = registry->nextSiblings[i];
+	if (prev != NULL_ENTITY) registry->nextSiblings[denseIndexOf(registry, prev)] = next;
+	else registry->firstChildren[denseIndexOf(registry, parent)] = next;
+	if (next != NULL_ENTITY) registry->prevSiblings[denseIndexOf(registry, next)] = prev;
+
+	registry->parents[i] = NULL_ENTITY;
+	registry->prevSiblings[i] = NULL_ENTITY;
+	registry->nextSiblings[i] = NULL_ENTITY;
+}
+
+void setParent(Registry* registry, Entity child, Entity parent) {
+	uint32_t i = denseIndexOf(registry, child);
+	if (registry->parents[i] == parent) return;
+
+	for (Entity p = parent; p != NULL_ENTITY; p = registry->parents[denseIndexOf(registry, p)]) {
+		if (p == child) {
+			spdlog::error("Parenting entity {} would create a cycle", child.slot);
+			throw std::runtime_error("Parenting would create a cycle");
+		}
+	}
+
+	unlink(registry, i);
+	if (parent != NULL_ENTITY) {
+		uint32_t p = denseIndexOf(registry, parent);
+		Entity first = registry->firstChildren[p];
+		if (first != NULL_ENTITY) registry->prevSiblings[denseIndexOf(registry, first)] = child;
+		registry->nextSiblings[i] = first;
+		registry->firstChildren[p] = child;
+		registry->parents[i] = parent;
+	}
+
+	markDenseDirty(registry, i);
+	registry->orderDirty = true;
+}
+
+Entity parentOf(const Registry* registry, Entity e) {
+	return registry->parents[denseIndexOf(registry, e)];
+}
+
+std::vector<Entity> childrenOf(const Registry* registry, Entity e) {
+	std::vector<Entity> children;
+	for (Entity c = registry->firstChildren[denseIndexOf(registry, e)]; c != NULL_ENTITY; c = registry->nextSiblings[denseIndexOf(registry, c)]) {
+		children.push_back(c);
+	}
+	return children;
+}
+
+static void rebuildOrder(Registry* registry) {
+	size_t n = registry->denseToSlot.size();
+
+	// counting sort by depth, walking up from each entity until a known depth is found
+	constexpr uint32_t unknown = 0xFFFFFFFF;
+	FrameVector<uint32_t> depths(n, unknown);
+	FrameVector<uint32_t> chain;
+	uint32_t maxDepth = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t cur = i;
+		while (depths[cur] == unknown && registry->parents[cur] != NULL_ENTITY) {
+			chain.push_back(cur);
+			cur = registry->slotToDense[registry->parents[cur].slot];
+		}
+		if (depths[cur] == unknown) depths[cur] = 0;
+
+		uint32_t d = depths[cur];
+		while (!chain.empty()) {
+			depths[chain.back()] = ++d;
+			chain.pop_back();
+		}
+		maxDepth = std::max(maxDepth, depths[i]);
+	}
+
+	FrameVector<uint32_t> offsets(maxDepth + 2, 0);
+	for (uint32_t d : depths) offsets[d + 1]++;
+	for (size_t d = 1; d < offsets.size(); d++) offsets[d] += offsets[d - 1];
+
+	registry->order.resize(n);
+	for (uint32_t i = 0; i < n; i++) {
+		registry->order[offsets[depths[i]]++] = i;
+	}
+	registry->orderDirty = false;
+}
+
+void setSpatialIndex(Registry* registry, Bvh* bvh) {
+	for (uint32_t i = 0; i < registry->spatialLeaves.size(); i++) {
+		int32_t& leaf = registry->spatialLeaves[i];
+		if (leaf != BVH_NULL) removeBvhLeaf(registry->spatial, leaf);
+		leaf = bvh != nullptr ? insertBvhLeaf(bvh, registry->worldBounds[i], registry->denseToSlot[i]) : BVH_NULL;
+	}
+	registry->spatial = bvh;
+}
+
+Entity entityOfSlot(const Registry* registry, uint32_t slot) {
+	return { slot, registry->generations[slot] };
+}
+
+Entity pickEntity(const Registry* registry, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* distance) {
+	BvhHit hit;
+	if (registry->spatial == nullptr || !raycastBvh(registry->spatial, origin, direction, maxDistance, &hit)) return NULL_ENTITY;
+	if (distance != nullptr) *distance = hit.distance;
+	return entityOfSlot(registry, hit.value);
+}
+
+std::vector<Entity> nearestEntities(const Registry* registry, const glm::vec3& point, size_t k) {
+	std::vector<Entity> entities;
+	if (registry->spatial == nullptr) return entities;
+
+	std::vector<BvhHit> hits;
+	nearestBvh(registry->spatial, point, k, hits);
+	for (const BvhHit& hit : hits) entities.push_back(entityOfSlot(registry, hit.value));
+	return entities;
+}
+
+static void moveSpatialLeaf(Registry* registry, uint32_t i) {
+	if (registry->spatialLeaves[i] != BVH_NULL) moveBvhLeaf(registry->spatial, registry->spatialLeaves[i], registry->worldBounds[i]);
+}
+
+// entities per kernel job, a few cache lines of every input stream
+constexpr size_t TRANSFORM_JOB_GRAIN = 1024;
+
+void updateWorldMatrices(Registry* registry, JobSystem* jobs) {
+	if (registry->orderDirty) rebuildOrder(registry);
+	if (registry->dirtyCount == 0) return;
+	PROFILE_SCOPE("world matrices");
+
+	size_t n = registry->denseToSlot.size();
+	if (registry->dirtyCount * REGISTRY_BATCH_DIRTY_DIVISOR >= n) {
+		// cheaper to redo everything in SIMD than to walk the flags, roots are final after this
+		parallelFor(jobs, n, TRANSFORM_JOB_GRAIN, [registry](size_t begin, size_t end, uint32_t) {
+			batchTransforms(registry->positions.data() + begin, registry->rotations.data() + begin, registry->scales.data() + begin, registry->localBounds.data() + begin, end - begin, registry->worldMatrices.data() + begin, registry->worldBounds.data() + begin);
+		});
+
+		for (uint32_t i : registry->order) {
+			Entity parent = registry->parents[i];
+			if (parent == NULL_ENTITY) continue;
+
+			// still the local matrix, the parent's is already in world space
+			registry->worldMatrices[i] = registry->worldMatrices[registry->slotToDense[parent.slot]] * registry->worldMatrices[i];
+			registry->worldBounds[i] = transformAabb(registry->worldMatrices[i], registry->localBounds[i]);
+		}
+		for (uint32_t i = 0; i < n; i++) moveSpatialLeaf(registry, i);
+	}
+	else {
+		for (uint32_t i : registry->order) {
+			Entity parent = registry->parents[i];
+			uint32_t p = parent != NULL_ENTITY ? registry->slotToDense[parent.slot] : 0;
+
+			// parents come first in `order`, so their flag already includes their own ancestors
+			if (parent != NULL_ENTITY && registry->dirty[p]) registry->dirty[i] = 1;
+			if (!registry->dirty[i]) continue;
+
+			glm::mat4 local = composeTRS(registry->positions[i], registry->rotations[i], registry->scales[i]);
+			registry->worldMatrices[i] = parent != NULL_ENTITY ? registry->worldMatrices[p] * local : local;
+			registry->worldBounds[i] = transformAabb(registry->worldMatrices[i], registry->localBounds[i]);
+			moveSpatialLeaf(registry, i);
+		}
+	}
+
+	std::fill(registry->dirty.begin(), registry->dirty.end(), 0);
+	registry->dirtyCount = 0;
+}
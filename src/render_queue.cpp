@@ -0,0 +1,462 @@
+#include "render_queue.hpp"
+#include "profiler.hpp"
+#include "gl_state.hpp"
+#include "mesh_lod.hpp"
+#include "texture_streamer.hpp"
+#include "job_system.hpp"
+#include "frame_constants.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtx/norm.hpp>
+#include <algorithm>
+#include <cmath>
+
+RenderPass passOf(const RenderQueue* queue, const Material* mat) {
+	if (!isTransparent(mat)) return RenderPass::Opaque;
+	return queue->oit != nullptr && mat->oitShader != nullptr ? RenderPass::Accumulated : RenderPass::Transparent;
+}
+
+uint64_t makeSortKey(RenderPass pass, uint32_t shader, uint32_t material, uint32_t mesh, float depth01) {
+	constexpr uint64_t stateMask = (1ull << SORT_KEY_STATE_BITS) - 1;
+	constexpr uint64_t depthMask = (1ull << SORT_KEY_DEPTH_BITS) - 1;
+
+	uint64_t depth = static_cast<uint64_t>(std::clamp(depth01, 0.0f, 1.0f) * static_cast<float>(depthMask));
+	// ids that overflow their field only weaken the grouping, never the draw itself
+	uint64_t state = ((shader & stateMask) << (2 * SORT_KEY_STATE_BITS)) | ((material & stateMask) << SORT_KEY_STATE_BITS) | (mesh & stateMask);
+
+	uint64_t passBits = static_cast<uint64_t>(pass) << 62;
+	if (pass != RenderPass::Transparent) {
+		return passBits | (state << (SORT_KEY_DEPTH_BITS + 2)) | (depth << 2);
+	}
+
+	return passBits | ((depthMask - depth) << (3 * SORT_KEY_STATE_BITS + 2)) | (state << 2);
+}
+
+// the material is not part of the state then, objects of any such material share batches.
+// the table shaders have no OIT variant, accumulated draws bind their material the usual way
+static bool usesMaterialTable(const RenderQueue* queue, const Material* material) {
+	return queue->materials != nullptr && material->bindlessShader != nullptr && passOf(queue, material) != RenderPass::Accumulated && isRegistered(queue->materials, material);
+}
+
+static ShaderProgram* shaderOf(const RenderQueue* queue, const Material* material) {
+	return passOf(queue, material) == RenderPass::Accumulated ? material->oitShader : material->shader;
+}
+
+static ShaderProgram* instancedShaderOf(const RenderQueue* queue, const Material* material) {
+	return passOf(queue, material) == RenderPass::Accumulated ? material->oitInstancedShader : material->instancedShader;
+}
+
+void clearRenderQueue(RenderQueue* queue) {
+	queue->items.clear();
+	queue->keys.clear();
+}
+
+void submitRenderItem(RenderQueue* queue, Camera* camera, Mesh* mesh, Material* material, const glm::mat4& model, float lodFade) {
+	float depth = glm::length(camera->position - glm::vec3(model[3])) / camera->farPlane;
+
+	uint32_t index = static_cast<uint32_t>(queue->items.size());
+	queue->items.push_back({ mesh, material, model, lodFade });
+	RenderPass pass = passOf(queue, material);
+	uint64_t key = usesMaterialTable(queue, material)
+		? makeSortKey(pass, material->bindlessShader->handle, 0, mesh->sortId, depth)
+		: makeSortKey(pass, shaderOf(queue, material)->handle, material->sortId, mesh->sortId, depth);
+	queue->keys.push_back({ key, index });
+}
+
+static void reserveQueue(RenderQueue* queue, size_t count) {
+	queue->items.reserve(queue->items.size() + count);
+	queue->keys.reserve(queue->keys.size() + count);
+}
+
+void submitLodItem(RenderQueue* queue, Camera* camera, const LodChain* lods, Mesh* mesh, Material* material, const glm::mat4& model) {
+	// transform-only entities, like scene asset group nodes
+	if (mesh == nullptr) return;
+	if (queue->lodProjectionScale <= 0.0f || (lods == nullptr && !queue->textureFootprints)) {
+		submitRenderItem(queue, camera, mesh, material, model);
+		return;
+	}
+
+	const Mesh* full = lods != nullptr ? lods->levels[0].mesh : mesh;
+	glm::vec4 sphere = transformSphere(model, full->boundingSphere);
+	float distance = std::max(glm::length(glm::vec3(sphere) - camera->position) - sphere.w, 0.0f);
+	if (queue->textureFootprints) {
+		float pixels = 2.0f * sphere.w * queue->lodProjectionScale / std::max(distance, camera->nearPlane);
+		if (queue->footprints != nullptr) queue->footprints->push_back({ material, pixels });
+		else noteMaterialUsage(material, pixels);
+	}
+	if (lods == nullptr) {
+		submitRenderItem(queue, camera, mesh, material, model);
+		return;
+	}
+
+	float scale = std::sqrt(std::max(glm::length2(glm::vec3(model[0])), std::max(glm::length2(glm::vec3(model[1])), glm::length2(glm::vec3(model[2])))));
+
+	LodSelection lod = selectLod(lods, distance, scale, queue->lodProjectionScale);
+	Mesh* current = lods->levels[lod.level].mesh;
+	if (lod.next == lod.level) {
+		submitRenderItem(queue, camera, current, material, model);
+		return;
+	}
+
+	// complementary dither masks, every pixel is covered by exactly one of the two
+	submitRenderItem(queue, camera, current, material, model, -lod.fade);
+	submitRenderItem(queue, camera, lods->levels[lod.next].mesh, material, model, lod.fade);
+}
+
+static bool culled(RenderQueue* queue, const Aabb& worldBounds) {
+	return queue->culling != nullptr && cullBounds(queue->culling, worldBounds);
+}
+
+void submitGameObjects(RenderQueue* queue, Camera* camera, const std::vector<GameObject*>& objs) {
+	reserveQueue(queue, objs.size());
+	for (GameObject* go : objs) {
+		Mesh* mesh = go->meshRenderer.mesh;
+		glm::mat4 model = createModelMatrix(go->transform);
+		if (culled(queue, transformAabb(model, mesh->bounds))) continue;
+		submitLodItem(queue, camera, go->meshRenderer.lods, mesh, go->meshRenderer.material, model);
+	}
+}
+
+// dense indices per job, enough to pay for the list setup
+constexpr size_t PARALLEL_SUBMIT_GRAIN = 256;
+
+static void beginCommandLists(RenderQueue* queue) {
+	uint32_t threads = jobThreadCount(queue->jobs);
+	if (queue->commandLists.size() != threads) queue->commandLists.resize(threads);
+	for (RenderCommandList& list : queue->commandLists) {
+		RenderQueue* q = &list.queue;
+		clearRenderQueue(q);
+		q->materials = queue->materials;
+		q->oit = queue->oit;
+		q->lodProjectionScale = queue->lodProjectionScale;
+		q->textureFootprints = queue->textureFootprints;
+		q->footprints = &list.footprints;
+		list.footprints.clear();
+		if (queue->culling != nullptr) {
+			list.culler = *queue->culling;
+			list.culler.stats = {};
+			q->culling = &list.culler;
+		}
+		else q->culling = nullptr;
+	}
+}
+
+static void replayCommandLists(RenderQueue* queue) {
+	size_t items = 0;
+	for (const RenderCommandList& list : queue->commandLists) items += list.queue.items.size();
+	reserveQueue(queue, items);
+
+	for (RenderCommandList& list : queue->commandLists) {
+		uint32_t offset = static_cast<uint32_t>(queue->items.size());
+		queue->items.insert(queue->items.end(), list.queue.items.begin(), list.queue.items.end());
+		for (RenderKey k : list.queue.keys) queue->keys.push_back({ k.key, k.item + offset });
+
+		for (const MaterialFootprint& f : list.footprints) {
+			if (queue->footprints != nullptr) queue->footprints->push_back(f);
+			else noteMaterialUsage(f.material, f.pixels);
+		}
+		if (queue->culling != nullptr) {
+			queue->culling->stats.tested += list.culler.stats.tested;
+			queue->culling->stats.frustumRejected += list.culler.stats.frustumRejected;
+			queue->culling->stats.occlusionRejected += list.culler.stats.occlusionRejected;
+		}
+	}
+}
+
+static void submitRegistryParallel(RenderQueue* queue, Camera* camera, const Registry* registry) {
+	PROFILE_SCOPE("submit registry");
+	size_t n = entityCount(registry);
+	beginCommandLists(queue);
+
+	if (queue->culling != nullptr && registry->spatial != nullptr) {
+		// the tree walk stays on this thread, the occlusion tests and everything after it are spread out
+		Culler* culler = queue->culling;
+		queryBvhFrustum(registry->spatial, culler->frustum, queue->visible);
+		culler->stats.tested += static_cast<uint32_t>(n);
+		culler->stats.frustumRejected += static_cast<uint32_t>(n - queue->visible.size());
+
+		parallelFor(queue->jobs, queue->visible.size(), PARALLEL_SUBMIT_GRAIN, [&](size_t begin, size_t end, uint32_t thread) {
+			PROFILE_SCOPE("record commands");
+			RenderCommandList& list = queue->commandLists[thread];
+			for (size_t v = begin; v < end; v++) {
+				uint32_t i = registry->slotToDense[queue->visible[v]];
+				if (list.culler.hiz != nullptr && aabbOccluded(list.culler.hiz, registry->worldBounds[i])) {
+					list.culler.stats.occlusionRejected++;
+					continue;
+				}
+				submitLodItem(&list.queue, camera, registry->lodChains[i], registry->meshes[i], registry->materials[i], registry->worldMatrices[i]);
+			}
+		});
+		queue->visible.clear();
+	}
+	else {
+		parallelFor(queue->jobs, n, PARALLEL_SUBMIT_GRAIN, [&](size_t begin, size_t end, uint32_t thread) {
+			PROFILE_SCOPE("record commands");
+			RenderQueue* q = &queue->commandLists[thread].queue;
+			for (size_t i = begin; i < end; i++) {
+				if (culled(q, registry->worldBounds[i])) continue;
+				submitLodItem(q, camera, registry->lodChains[i], registry->meshes[i], registry->materials[i], registry->worldMatrices[i]);
+			}
+		});
+	}
+
+	PROFILE_SCOPE("replay commands");
+	replayCommandLists(queue);
+}
+
+void submitRegistry(RenderQueue* queue, Camera* camera, const Registry* registry) {
+	size_t n = entityCount(registry);
+	if (queue->jobs != nullptr && n > PARALLEL_SUBMIT_GRAIN) {
+		submitRegistryParallel(queue, camera, registry);
+		return;
+	}
+	PROFILE_SCOPE("submit registry");
+
+	if (queue->culling != nullptr && registry->spatial != nullptr) {
+		// only the subtrees touching the frustum are visited, the occlusion test runs on what is left
+		Culler* culler = queue->culling;
+		queryBvhFrustum(registry->spatial, culler->frustum, queue->visible);
+		reserveQueue(queue, queue->visible.size());
+
+		culler->stats.tested += static_cast<uint32_t>(n);
+		culler->stats.frustumRejected += static_cast<uint32_t>(n - queue->visible.size());
+		for (uint32_t slot : queue->visible) {
+			uint32_t i = registry->slotToDense[slot];
+			if (culler->hiz != nullptr && aabbOccluded(culler->hiz, registry->worldBounds[i])) {
+				culler->stats.occlusionRejected++;
+				continue;
+			}
+			submitLodItem(queue, camera, registry->lodChains[i], registry->meshes[i], registry->materials[i], registry->worldMatrices[i]);
+		}
+		queue->visible.clear();
+		return;
+	}
+
+	reserveQueue(queue, n);
+	for (size_t i = 0; i < n; i++) {
+		if (culled(queue, registry->worldBounds[i])) continue;
+		submitLodItem(queue, camera, registry->lodChains[i], registry->meshes[i], registry->materials[i], registry->worldMatrices[i]);
+	}
+}
+
+void submitEntities(RenderQueue* queue, Camera* camera, const Registry* registry, const std::vector<Entity>& entities) {
+	reserveQueue(queue, entities.size());
+	for (Entity e : entities) {
+		uint32_t i = denseIndexOf(registry, e);
+		if (culled(queue, registry->worldBounds[i])) continue;
+		submitLodItem(queue, camera, registry->lodChains[i], registry->meshes[i], registry->materials[i], registry->worldMatrices[i]);
+	}
+}
+
+void radixSortKeys(std::vector<RenderKey>& keys, std::vector<RenderKey>& scratch) {
+	// LSD radix sort, 8 bits per pass. all histograms are built in one read of the keys
+	// and passes where every key lands in the same bucket are skipped.
+	constexpr size_t passes = 8;
+	size_t n = keys.size();
+	if (n < 2) return;
+
+	uint32_t counts[passes][256] = {};
+	for (const RenderKey& k : keys) {
+		for (size_t p = 0; p < passes; p++) {
+			counts[p][(k.key >> (p * 8)) & 0xFF]++;
+		}
+	}
+
+	scratch.resize(n);
+	RenderKey* src = keys.data();
+	RenderKey* dst = scratch.data();
+
+	for (size_t p = 0; p < passes; p++) {
+		uint32_t* c = counts[p];
+		if (c[(src[0].key >> (p * 8)) & 0xFF] == n) continue;
+
+		uint32_t offsets[256];
+		uint32_t sum = 0;
+		for (size_t b = 0; b < 256; b++) {
+			offsets[b] = sum;
+			sum += c[b];
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			dst[offsets[(src[i].key >> (p * 8)) & 0xFF]++] = src[i];
+		}
+		std::swap(src, dst);
+	}
+
+	if (src != keys.data()) {
+		std::copy(src, src + n, keys.data());
+	}
+}
+
+void sortRenderQueue(RenderQueue* queue) {
+	PROFILE_SCOPE("sort queue");
+	radixSortKeys(queue->keys, queue->scratch);
+}
+
+static void beginPass(RenderQueue* queue, RenderPass pass) {
+	if (pass == RenderPass::Opaque) {
+		setBlend(&glState, false);
+		setDepthWrite(&glState, true);
+	}
+	else if (pass == RenderPass::Accumulated) {
+		beginOitAccumulation(queue->oit);
+	}
+	else {
+		setBlend(&glState, true);
+		setBlendFunc(&glState, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		setDepthWrite(&glState, false);
+	}
+}
+
+static void endPass(RenderQueue* queue, RenderPass pass) {
+	if (pass == RenderPass::Accumulated) resolveOit(queue->oit);
+}
+
+static RenderPass passOfKey(uint64_t key) {
+	return static_cast<RenderPass>(key >> 62);
+}
+
+static void drawItem(RenderQueue* queue, const RenderItem& item) {
+	ShaderProgram* shader = shaderOf(queue, item.material);
+	bindVertexArray(&glState, item.mesh->vao);
+	applyMaterial(item.material, shader);
+	if (shader->builtins.drawConstants && queue->transient != nullptr) {
+		DrawConstants constants{ item.model, item.material->color, item.lodFade, { 0.0f, 0.0f, 0.0f } };
+		bindTransientUniforms(queue->transient, DRAW_CONSTANTS_BINDING, &constants, sizeof(constants));
+	}
+	else {
+		applyTransform(shader, item.model);
+		if (shader->builtins.lodFade >= 0) glUniform1f(shader->builtins.lodFade, item.lodFade);
+	}
+	drawMesh(item.mesh);
+}
+
+// length of the run starting at `first` that can share one instanced draw
+static size_t batchLength(const RenderQueue* queue, size_t first) {
+	const RenderItem& lead = queue->items[queue->keys[first].item];
+	bool table = usesMaterialTable(queue, lead.material);
+	// the instanced shaders have no per-instance fade, a fading item is drawn on its own
+	if (queue->instances == nullptr || (!table && instancedShaderOf(queue, lead.material) == nullptr) || lead.lodFade != 0.0f) return 1;
+
+	RenderPass pass = passOfKey(queue->keys[first].key);
+	size_t end = first + 1;
+	while (end < queue->keys.size()) {
+		const RenderKey& k = queue->keys[end];
+		const RenderItem& item = queue->items[k.item];
+		if (passOfKey(k.key) != pass || item.mesh != lead.mesh || item.lodFade != 0.0f) break;
+		if (table ? !usesMaterialTable(queue, item.material) || item.material->bindlessShader != lead.material->bindlessShader : item.material != lead.material) break;
+		end++;
+	}
+	return end - first;
+}
+
+static bool drawBatch(RenderQueue* queue, size_t first, size_t count) {
+	InstanceAllocation alloc = allocateInstances(queue->instances, static_cast<uint32_t>(count));
+	if (alloc.data == nullptr) return false;
+
+	const RenderItem& lead = queue->items[queue->keys[first].item];
+	countUpload(count * sizeof(InstanceData));
+	for (size_t i = 0; i < count; i++) {
+		const RenderItem& item = queue->items[queue->keys[first + i].item];
+		alloc.data[i].model = item.model;
+		alloc.data[i].color = item.material->color;
+		alloc.data[i].material = item.material->sortId;
+	}
+
+	attachInstanceBuffer(lead.mesh, queue->instances);
+	bindVertexArray(&glState, lead.mesh->vao);
+	// table shaders take nothing from the material, there are no textures to bind or uniforms to load
+	if (usesMaterialTable(queue, lead.material)) bindProgram(&glState, lead.material->bindlessShader->handle);
+	else applyMaterial(lead.material, instancedShaderOf(queue, lead.material));
+	drawMeshInstanced(lead.mesh, static_cast<uint32_t>(count), alloc.baseInstance);
+	return true;
+}
+
+// opaque draws sorted by state still run mesh by mesh, each run becomes one instanced depth-only draw.
+// fading items are left to the opaque pass, their dither would have to discard here too
+static void drawDepthPrepass(RenderQueue* queue) {
+	PROFILE_SCOPE("depth prepass");
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	setBlend(&glState, false);
+	setDepthTest(&glState, true);
+	setDepthWrite(&glState, true);
+	bindProgram(&glState, queue->depthPrepass->handle);
+
+	size_t n = queue->keys.size();
+	size_t i = 0;
+	while (i < n && passOfKey(queue->keys[i].key) == RenderPass::Opaque) {
+		Mesh* mesh = queue->items[queue->keys[i].item].mesh;
+		size_t end = i;
+		uint32_t count = 0;
+		for (; end < n && passOfKey(queue->keys[end].key) == RenderPass::Opaque; end++) {
+			const RenderItem& item = queue->items[queue->keys[end].item];
+			if (item.mesh != mesh) break;
+			if (item.lodFade == 0.0f) count++;
+		}
+
+		if (count > 0) {
+			InstanceAllocation alloc = allocateInstances(queue->instances, count);
+			// the opaque pass still draws everything, a full region only costs the early rejection
+			if (alloc.data == nullptr) break;
+			countUpload(count * sizeof(InstanceData));
+			uint32_t written = 0;
+			for (size_t j = i; j < end; j++) {
+				const RenderItem& item = queue->items[queue->keys[j].item];
+				if (item.lodFade == 0.0f) alloc.data[written++].model = item.model;
+			}
+
+			attachDepthInstanceBuffer(mesh->pool, queue->instances);
+			bindVertexArray(&glState, mesh->pool->depthVao);
+			drawMeshInstanced(mesh, count, alloc.baseInstance);
+		}
+		i = end;
+	}
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void flushRenderQueue(RenderQueue* queue) {
+	PROFILE_SCOPE("flush queue");
+	if (queue->materials != nullptr) bindMaterialTable(queue->materials);
+	if (queue->depthPrepass != nullptr && queue->instances != nullptr) drawDepthPrepass(queue);
+	bool started = false;
+	RenderPass current = RenderPass::Opaque;
+
+	size_t i = 0;
+	while (i < queue->keys.size()) {
+		RenderPass pass = passOfKey(queue->keys[i].key);
+		if (!started || pass != current) {
+			if (started) endPass(queue, current);
+			beginPass(queue, pass);
+			current = pass;
+			started = true;
+		}
+
+		size_t count = batchLength(queue, i);
+		if (count < INSTANCING_MIN_BATCH || !drawBatch(queue, i, count)) {
+			// a full instance region falls back to per-object draws for the rest of the frame
+			for (size_t j = i; j < i + count; j++) {
+				drawItem(queue, queue->items[queue->keys[j].item]);
+			}
+		}
+		i += count;
+	}
+	if (started) endPass(queue, current);
+
+	// glClear honours the depth mask, so leave it writable for the next frame
+	setDepthWrite(&glState, true);
+}
+
+void renderGameObjectsQueued(RenderQueue* queue, Camera* camera, const std::vector<GameObject*>& objs) {
+	clearRenderQueue(queue);
+	submitGameObjects(queue, camera, objs);
+	sortRenderQueue(queue);
+	flushRenderQueue(queue);
+}
+
+void renderRegistryQueued(RenderQueue* queue, Camera* camera, const Registry* registry) {
+	clearRenderQueue(queue);
+	submitRegistry(queue, camera, registry);
+	sortRenderQueue(queue);
+	flushRenderQueue(queue);
+}
@@ -0,0 +1,44 @@
+#include "render_target.hpp"
+#include "profiler.hpp"
+
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+RenderTarget* createRenderTarget(GLenum colorFormat, GLenum depthFormat) {
+	RenderTarget* target = new RenderTarget();
+	target->colorFormat = colorFormat;
+	target->depthFormat = depthFormat;
+	return target;
+}
+
+void resizeRenderTarget(RenderTarget* target, glm::ivec2 size) {
+	if (size == target->size || size.x <= 0 || size.y <= 0) return;
+
+	if (target->framebuffer != 0) {
+		uint32_t renderbuffers[] = { target->color, target->depth };
+		glDeleteRenderbuffers(2, renderbuffers);
+		glDeleteFramebuffers(1, &target->framebuffer);
+	}
+
+	target->size = size;
+	glCreateRenderbuffers(1, &target->color);
+	glNamedRenderbufferStorage(target->color, target->colorFormat, size.x, size.y);
+	glCreateRenderbuffers(1, &target->depth);
+	glNamedRenderbufferStorage(target->depth, target->depthFormat, size.x, size.y);
+
+	glCreateFramebuffers(1, &target->framebuffer);
+	glNamedFramebufferRenderbuffer(target->framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->color);
+	glNamedFramebufferRenderbuffer(target->framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target->depth);
+
+	if (glCheckNamedFramebufferStatus(target->framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		spdlog::error("Render target of {}x{} is incomplete", size.x, size.y);
+		throw std::runtime_error("Render target is incomplete");
+	}
+}
+
+void presentRenderTarget(RenderTarget* target) {
+	PROFILE_SCOPE("present");
+	glm::ivec2 s = target->size;
+	glBlitNamedFramebuffer(target->framebuffer, 0, 0, 0, s.x, s.y, 0, 0, s.x, s.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
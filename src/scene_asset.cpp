@@ -0,0 +1,266 @@
+#include "scene_asset.hpp"
+#include "mapped_file.hpp"
+
+#include <spdlog/spdlog.h>
+#include <glad/glad.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+// the file structs are written and mapped as raw memory
+static_assert(std::endian::native == std::endian::little);
+
+static uint64_t alignOffset(uint64_t offset) {
+	return (offset + SCENE_ASSET_ALIGNMENT - 1) & ~(SCENE_ASSET_ALIGNMENT - 1);
+}
+
+static void writePadding(std::ofstream& out, uint64_t offset) {
+	static const char zeros[SCENE_ASSET_ALIGNMENT] = {};
+	uint64_t at = static_cast<uint64_t>(out.tellp());
+	out.write(zeros, static_cast<std::streamsize>(offset - at));
+}
+
+void writeSceneAsset(const std::string& path, std::span<const SceneAssetSource> meshes, std::span<const SceneAssetNode> nodes, const VertexLayout& layout) {
+	size_t maxVertices = 0;
+	SceneAssetHeader header{};
+	header.magic = SCENE_ASSET_MAGIC;
+	header.version = SCENE_ASSET_VERSION;
+	for (uint32_t a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++) header.formats[a] = static_cast<uint8_t>(layout.formats[a]);
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.nodeCount = static_cast<uint32_t>(nodes.size());
+
+	std::vector<SceneAssetMesh> records(meshes.size());
+	for (size_t i = 0; i < meshes.size(); i++) {
+		const SceneAssetSource& src = meshes[i];
+		Aabb bounds = computeBounds(src.vertices);
+		glm::vec4 sphere = computeBoundingSphere(src.vertices);
+
+		SceneAssetMesh& record = records[i];
+		record.baseVertex = header.vertexCount;
+		record.firstIndex = header.indexCount;
+		record.vertexCount = static_cast<uint32_t>(src.vertices.size());
+		record.indexCount = static_cast<uint32_t>(src.indices.size());
+		record.primitive = static_cast<uint32_t>(src.primitiveFormat);
+		std::memcpy(record.boundingSphere, &sphere, sizeof(record.boundingSphere));
+		std::memcpy(record.boundsMin, &bounds.min, sizeof(record.boundsMin));
+		std::memcpy(record.boundsMax, &bounds.max, sizeof(record.boundsMax));
+
+		header.vertexCount += record.vertexCount;
+		header.indexCount += record.indexCount;
+		maxVertices = std::max(maxVertices, src.vertices.size());
+	}
+	for (const SceneAssetNode& node : nodes) {
+		if ((node.mesh != SCENE_ASSET_NO_MESH && node.mesh >= meshes.size()) || node.parent >= static_cast<int32_t>(&node - nodes.data())) {
+			spdlog::error("Scene asset {} has a node with an invalid mesh or parent", path);
+			throw std::runtime_error("Invalid scene asset node");
+		}
+	}
+
+	header.indexType = selectIndexType(static_cast<uint32_t>(maxVertices));
+	uint32_t indexSize = header.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	header.meshOffset = alignOffset(sizeof(SceneAssetHeader));
+	header.nodeOffset = alignOffset(header.meshOffset + records.size() * sizeof(SceneAssetMesh));
+	header.vertexOffset = alignOffset(header.nodeOffset + nodes.size() * sizeof(SceneAssetNode));
+	const VertexLayout positionLayout = makeVertexLayout(layout.formats[static_cast<uint32_t>(VertexAttribute::Position)], AttributeFormat::None, AttributeFormat::None, AttributeFormat::None);
+	header.positionOffset = alignOffset(header.vertexOffset + static_cast<uint64_t>(header.vertexCount) * layout.stride);
+	header.indexOffset = alignOffset(header.positionOffset + static_cast<uint64_t>(header.vertexCount) * positionLayout.stride);
+	header.fileSize = header.indexOffset + static_cast<uint64_t>(header.indexCount) * indexSize;
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) {
+		spdlog::error("Failed to open {} for writing", path);
+		throw std::runtime_error("Failed to write scene asset " + path);
+	}
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	writePadding(out, header.meshOffset);
+	out.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(SceneAssetMesh)));
+	writePadding(out, header.nodeOffset);
+	out.write(reinterpret_cast<const char*>(nodes.data()), static_cast<std::streamsize>(nodes.size() * sizeof(SceneAssetNode)));
+
+	writePadding(out, header.vertexOffset);
+	std::vector<uint8_t> packed;
+	for (const SceneAssetSource& src : meshes) {
+		packed.resize(src.vertices.size() * layout.stride);
+		packVertices(layout, src.vertices.data(), src.vertices.size(), packed.data());
+		out.write(reinterpret_cast<const char*>(packed.data()), static_cast<std::streamsize>(packed.size()));
+	}
+
+	writePadding(out, header.positionOffset);
+	for (const SceneAssetSource& src : meshes) {
+		packed.resize(src.vertices.size() * positionLayout.stride);
+		packVertices(positionLayout, src.vertices.data(), src.vertices.size(), packed.data());
+		out.write(reinterpret_cast<const char*>(packed.data()), static_cast<std::streamsize>(packed.size()));
+	}
+
+	writePadding(out, header.indexOffset);
+	for (const SceneAssetSource& src : meshes) {
+		if (header.indexType == GL_UNSIGNED_INT) {
+			out.write(reinterpret_cast<const char*>(src.indices.data()), static_cast<std::streamsize>(src.indices.size_bytes()));
+			continue;
+		}
+		std::vector<uint16_t> narrow(src.indices.begin(), src.indices.end());
+		out.write(reinterpret_cast<const char*>(narrow.data()), static_cast<std::streamsize>(narrow.size() * sizeof(uint16_t)));
+	}
+
+	if (!out) {
+		spdlog::error("Failed to write {}", path);
+		throw std::runtime_error("Failed to write scene asset " + path);
+	}
+}
+
+static bool sectionFits(const SceneAssetHeader& header, uint64_t offset, uint64_t bytes) {
+	return offset % SCENE_ASSET_ALIGNMENT == 0 && offset <= header.fileSize && bytes <= header.fileSize - offset;
+}
+
+// everything the loader reads is checked against the file size, a corrupt file is an error and not a crash
+static VertexLayout headerLayout(const SceneAssetHeader& header) {
+	return makeVertexLayout(static_cast<AttributeFormat>(header.formats[0]), static_cast<AttributeFormat>(header.formats[1]),
+		static_cast<AttributeFormat>(header.formats[2]), static_cast<AttributeFormat>(header.formats[3]));
+}
+
+static bool validateSceneAsset(const MappedFile* file, const SceneAssetHeader& header) {
+	if (header.magic != SCENE_ASSET_MAGIC || header.version != SCENE_ASSET_VERSION || header.fileSize != file->size) return false;
+	if (header.indexType != GL_UNSIGNED_SHORT && header.indexType != GL_UNSIGNED_INT) return false;
+	for (uint8_t format : header.formats) {
+		if (format > static_cast<uint8_t>(AttributeFormat::Snorm10x3_2)) return false;
+	}
+	if (header.formats[static_cast<uint32_t>(VertexAttribute::Position)] == static_cast<uint8_t>(AttributeFormat::None)) return false;
+
+	uint32_t stride = headerLayout(header).stride;
+	uint32_t positionStride = attributeSize(static_cast<AttributeFormat>(header.formats[static_cast<uint32_t>(VertexAttribute::Position)]));
+	uint64_t indexSize = header.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	return sectionFits(header, header.meshOffset, static_cast<uint64_t>(header.meshCount) * sizeof(SceneAssetMesh))
+		&& sectionFits(header, header.nodeOffset, static_cast<uint64_t>(header.nodeCount) * sizeof(SceneAssetNode))
+		&& sectionFits(header, header.vertexOffset, static_cast<uint64_t>(header.vertexCount) * stride)
+		&& sectionFits(header, header.positionOffset, static_cast<uint64_t>(header.vertexCount) * positionStride)
+		&& sectionFits(header, header.indexOffset, static_cast<uint64_t>(header.indexCount) * indexSize);
+}
+
+static bool validateMesh(const SceneAssetHeader& header, const SceneAssetMesh& record) {
+	switch (static_cast<PrimitiveFormat>(record.primitive)) {
+	case PrimitiveFormat::Triangles:
+	case PrimitiveFormat::TriangleFan:
+	case PrimitiveFormat::TriangleStrip:
+	case PrimitiveFormat::Lines:
+	case PrimitiveFormat::LineStrip:
+		break;
+	default:
+		return false;
+	}
+	return record.baseVertex <= header.vertexCount && record.vertexCount <= header.vertexCount - record.baseVertex
+		&& record.firstIndex <= header.indexCount && record.indexCount <= header.indexCount - record.firstIndex;
+}
+
+// indices are local to the mesh, any one past its vertices would read another mesh or past the pool
+static bool meshIndicesFit(const SceneAssetView& view, const SceneAssetMesh& record) {
+	const uint8_t* indices = view.indices + static_cast<size_t>(record.firstIndex) * view.indexSize;
+	for (uint32_t i = 0; i < record.indexCount; i++) {
+		uint32_t index;
+		if (view.indexSize == sizeof(uint16_t)) index = reinterpret_cast<const uint16_t*>(indices)[i];
+		else index = reinterpret_cast<const uint32_t*>(indices)[i];
+		if (index >= record.vertexCount) return false;
+	}
+	return true;
+}
+
+static void invalidAsset(const std::string& path, const char* what) {
+	spdlog::error("Scene asset {} {}", path, what);
+	throw std::runtime_error("Invalid scene asset " + path);
+}
+
+void readSceneAsset(const MappedFile* file, const std::string& path, SceneAssetView* view) {
+	if (file->size < sizeof(SceneAssetHeader)) invalidAsset(path, "is truncated");
+
+	SceneAssetHeader& header = view->header;
+	std::memcpy(&header, file->data, sizeof(header));
+	if (!validateSceneAsset(file, header)) invalidAsset(path, "has a bad header, version or size");
+
+	// sections are aligned, so the tables can be read in place
+	view->meshes = reinterpret_cast<const SceneAssetMesh*>(file->data + header.meshOffset);
+	view->nodes = reinterpret_cast<const SceneAssetNode*>(file->data + header.nodeOffset);
+	view->indexSize = header.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+	view->indices = file->data + header.indexOffset;
+	for (uint32_t i = 0; i < header.meshCount; i++) {
+		if (!validateMesh(header, view->meshes[i])) invalidAsset(path, "has a mesh out of range");
+		if (!meshIndicesFit(*view, view->meshes[i])) invalidAsset(path, "has an index past its mesh's vertices");
+	}
+	for (uint32_t i = 0; i < header.nodeCount; i++) {
+		const SceneAssetNode& node = view->nodes[i];
+		if ((node.mesh != SCENE_ASSET_NO_MESH && node.mesh >= header.meshCount) || node.parent >= static_cast<int32_t>(i)) invalidAsset(path, "has a node with an invalid mesh or parent");
+	}
+
+	view->layout = &internVertexLayout(headerLayout(header));
+	view->vertices = file->data + header.vertexOffset;
+	view->positions = file->data + header.positionOffset;
+	view->positionStride = attributeSize(view->layout->formats[static_cast<uint32_t>(VertexAttribute::Position)]);
+}
+
+SceneAsset* createSceneAsset(const SceneAssetView& view, GeometryPool* pool) {
+	SceneAsset* asset = new SceneAsset();
+	asset->pool = pool;
+	asset->meshes.reserve(view.header.meshCount);
+	for (uint32_t i = 0; i < view.header.meshCount; i++) {
+		const SceneAssetMesh& record = view.meshes[i];
+		Mesh* mesh = allocateMesh();
+		mesh->primitiveFormat = static_cast<PrimitiveFormat>(record.primitive);
+		mesh->layout = view.layout;
+		mesh->vao = pool->vao;
+		mesh->pool = pool;
+		mesh->baseVertex = record.baseVertex;
+		mesh->firstIndex = record.firstIndex;
+		mesh->indexCount = record.indexCount;
+		std::memcpy(&mesh->boundingSphere, record.boundingSphere, sizeof(record.boundingSphere));
+		std::memcpy(&mesh->bounds.min, record.boundsMin, sizeof(record.boundsMin));
+		std::memcpy(&mesh->bounds.max, record.boundsMax, sizeof(record.boundsMax));
+		asset->meshes.push_back(mesh);
+	}
+	asset->nodes.assign(view.nodes, view.nodes + view.header.nodeCount);
+	return asset;
+}
+
+SceneAsset* loadSceneAsset(const std::string& path) {
+	MappedFile* file = mapFile(path);
+	SceneAssetView view;
+	try {
+		readSceneAsset(file, path, &view);
+	}
+	catch (...) {
+		unmapFile(file);
+		throw;
+	}
+
+	// the GL copies out of the mapped pages here, there is no staging copy on our side
+	const SceneAssetHeader& header = view.header;
+	GeometryPool* pool = createGeometryPool(*view.layout, header.indexType, view.vertices, view.positions, header.vertexCount, view.indices, header.indexCount);
+	SceneAsset* asset = createSceneAsset(view, pool);
+
+	unmapFile(file);
+	spdlog::info("Loaded scene asset {}: {} meshes, {} nodes, {} vertices", path, header.meshCount, header.nodeCount, header.vertexCount);
+	return asset;
+}
+
+void destroySceneAsset(SceneAsset* asset) {
+	for (Mesh* mesh : asset->meshes) destroyMesh(mesh);
+	destroyGeometryPool(asset->pool);
+	delete asset;
+}
+
+std::vector<Entity> instantiateSceneAsset(Registry* registry, const SceneAsset* asset, Material* material) {
+	std::vector<Entity> entities;
+	entities.reserve(asset->nodes.size());
+	for (const SceneAssetNode& node : asset->nodes) {
+		Transform transform;
+		transform.position = glm::vec3(node.position[0], node.position[1], node.position[2]);
+		transform.rotation = glm::fquat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+		transform.scale = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+
+		Mesh* mesh = node.mesh != SCENE_ASSET_NO_MESH ? asset->meshes[node.mesh] : nullptr;
+		Entity e = createEntity(registry, mesh, material, transform);
+		if (node.parent >= 0) setParent(registry, e, entities[node.parent]);
+		entities.push_back(e);
+	}
+	return entities;
+}
@@ -0,0 +1,107 @@
+#include "shader_cache.hpp"
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+static bool parallelCompile = false;
+
+static void hashBytes(ProgramCacheKey* key, const void* data, size_t size) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++) {
+		key->hash ^= bytes[i];
+		key->hash *= 1099511628211ull;
+	}
+}
+
+static void hashString(ProgramCacheKey* key, const GLubyte* s) {
+	if (s == nullptr) return;
+	std::string_view view(reinterpret_cast<const char*>(s));
+	hashBytes(key, view.data(), view.size());
+	hashBytes(key, "\0", 1);
+}
+
+ProgramCacheKey beginProgramCacheKey() {
+	ProgramCacheKey key;
+	hashString(&key, glGetString(GL_VENDOR));
+	hashString(&key, glGetString(GL_RENDERER));
+	hashString(&key, glGetString(GL_VERSION));
+	return key;
+}
+
+void hashProgramSource(ProgramCacheKey* key, uint32_t stage, std::string_view source) {
+	hashBytes(key, &stage, sizeof(stage));
+	uint64_t length = source.size();
+	hashBytes(key, &length, sizeof(length));
+	hashBytes(key, source.data(), source.size());
+}
+
+static std::filesystem::path cachePath(ProgramCacheKey key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key.hash));
+	return std::filesystem::path(SHADER_CACHE_DIR) / name;
+}
+
+struct ProgramBinaryHeader {
+	uint32_t magic;
+	uint32_t format;
+	uint64_t length;
+};
+
+bool loadProgramBinary(uint32_t program, ProgramCacheKey key) {
+	std::filesystem::path path = cachePath(key);
+	std::error_code error;
+	uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (error || fileSize < sizeof(ProgramBinaryHeader)) return false;
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+
+	ProgramBinaryHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != SHADER_CACHE_MAGIC) return false;
+	// a truncated or corrupt file must not size the allocation, and the driver takes the length as a GLsizei
+	if (header.length == 0 || header.length > fileSize - sizeof(ProgramBinaryHeader) || header.length > INT32_MAX) return false;
+	std::vector<char> binary(header.length);
+	if (!in.read(binary.data(), static_cast<std::streamsize>(binary.size()))) return false;
+
+	glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+	int linked;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked) spdlog::info("Cached program binary {:016x} was rejected by the driver, rebuilding", key.hash);
+	return linked != 0;
+}
+
+void storeProgramBinary(uint32_t program, ProgramCacheKey key) {
+	int length;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(program, length, &length, &format, binary.data());
+
+	std::error_code error;
+	std::filesystem::create_directories(SHADER_CACHE_DIR, error);
+	std::ofstream out(cachePath(key), std::ios::binary | std::ios::trunc);
+	ProgramBinaryHeader header{ SHADER_CACHE_MAGIC, format, static_cast<uint64_t>(length) };
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(binary.data(), length);
+	// a cache that cannot be written only costs the next start its speed
+	if (!out) spdlog::warn("Failed to write program binary {}", cachePath(key).string());
+}
+
+bool enableParallelShaderCompile() {
+	// 0xFFFFFFFF lets the implementation pick the thread count
+	if (GLAD_GL_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else if (GLAD_GL_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	else return false;
+	parallelCompile = true;
+	return true;
+}
+
+bool parallelShaderCompileEnabled() {
+	return parallelCompile;
+}
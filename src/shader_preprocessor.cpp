@@ -0,0 +1,241 @@
+#include "shader_preprocessor.hpp"
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+ShaderSourceCache shaderSources;
+
+// nested includes past this are taken to be a cycle
+constexpr int SHADER_INCLUDE_DEPTH = 32;
+
+static bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static std::string_view trim(std::string_view s) {
+	while (!s.empty() && isBlank(s.front())) s.remove_prefix(1);
+	while (!s.empty() && isBlank(s.back())) s.remove_suffix(1);
+	return s;
+}
+
+// pops the first line off `rest`, without its newline
+static std::string_view nextLine(std::string_view* rest) {
+	size_t i = rest->find('\n');
+	std::string_view line = rest->substr(0, i);
+	rest->remove_prefix(i == std::string_view::npos ? rest->size() : i + 1);
+	return line;
+}
+
+// the directive name of a preprocessor line, empty for anything else. `args` gets the trimmed remainder
+static std::string_view directive(std::string_view line, std::string_view* args) {
+	line = trim(line);
+	if (line.empty() || line.front() != '#') return {};
+	line = trim(line.substr(1));
+	size_t end = 0;
+	while (end < line.size() && !isBlank(line[end])) end++;
+	*args = trim(line.substr(end));
+	return line.substr(0, end);
+}
+
+static std::string_view firstWord(std::string_view s) {
+	size_t end = 0;
+	while (end < s.size() && !isBlank(s[end]) && s[end] != '/') end++;
+	return s.substr(0, end);
+}
+
+uint32_t shaderStageFromName(std::string_view name) {
+	std::string ln(name);
+	std::transform(ln.begin(), ln.end(), ln.begin(), [](unsigned char c) { return std::tolower(c); });
+	if (ln == "vertex") return GL_VERTEX_SHADER;
+	if (ln == "fragment") return GL_FRAGMENT_SHADER;
+	if (ln == "compute") return GL_COMPUTE_SHADER;
+	if (ln == "geometry") return GL_GEOMETRY_SHADER;
+	if (ln == "tess-control") return GL_TESS_CONTROL_SHADER;
+	if (ln == "tess-evaluation") return GL_TESS_EVALUATION_SHADER;
+	spdlog::error("Unknown shader type {}", name);
+	throw std::runtime_error("Unknown shader type " + ln);
+}
+
+// `#pragma once`, or every line outside comments sitting between `#ifndef X` / `#define X` and a final `#endif`
+static bool includedOnce(std::string_view text) {
+	std::vector<std::string_view> lines;
+	std::string_view rest = text;
+	while (!rest.empty()) {
+		std::string_view l = trim(nextLine(&rest));
+		if (l.empty() || l.starts_with("//")) continue;
+		std::string_view args;
+		if (directive(l, &args) == "pragma" && args == "once") return true;
+		lines.push_back(l);
+	}
+	if (lines.size() < 3) return false;
+
+	std::string_view a, b, c;
+	if (directive(lines[0], &a) != "ifndef" || directive(lines[1], &b) != "define" || directive(lines.back(), &c) != "endif") return false;
+	return firstWord(a) == firstWord(b);
+}
+
+static const ShaderSourceFile& loadSource(ShaderSourceCache* cache, const std::string& path) {
+	auto it = cache->files.find(path);
+	if (it != cache->files.end()) return it->second;
+
+	std::ifstream f(path, std::ios::binary);
+	if (!f) {
+		spdlog::error("Failed to open shader file {}", path);
+		throw std::runtime_error("Failed to open shader " + path);
+	}
+	ShaderSourceFile file;
+	file.text.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	file.once = includedOnce(file.text);
+	return cache->files.emplace(path, std::move(file)).first->second;
+}
+
+struct Expansion {
+	ShaderSourceCache* cache = nullptr;
+	ShaderStageSource* stage = nullptr;
+	std::vector<std::string> expandedOnce;
+	// the top level file's #version line, hoisted above the defines
+	std::string_view version;
+};
+
+static void expand(Expansion* ex, std::string_view text, uint32_t fileIndex, uint32_t firstLine, int depth) {
+	std::string& out = ex->stage->source;
+	const std::string includer = ex->stage->files[fileIndex];
+	std::string_view rest = text;
+	for (uint32_t line = firstLine; !rest.empty(); line++) {
+		std::string_view l = nextLine(&rest);
+		std::string_view args;
+		std::string_view name = directive(l, &args);
+
+		if (name == "version" && depth == 0) {
+			ex->version = trim(l);
+			out += '\n';
+		}
+		else if (name == "pragma" && args == "once") {
+			out += '\n';
+		}
+		else if (name == "type") {
+			spdlog::error("Shader {} line {}: #type is only allowed in the file a program is built from", includer, line);
+			throw std::runtime_error("Misplaced #type in shader " + includer);
+		}
+		else if (name == "include") {
+			if (args.size() < 2 || args.front() != '"' || args.find('"', 1) == std::string_view::npos) {
+				spdlog::error("Shader {} line {}: expected #include \"path\"", includer, line);
+				throw std::runtime_error("Malformed #include in shader " + includer);
+			}
+			if (depth >= SHADER_INCLUDE_DEPTH) {
+				spdlog::error("Shader {}: includes nest deeper than {}, is there a cycle?", includer, SHADER_INCLUDE_DEPTH);
+				throw std::runtime_error("Include cycle in shader " + includer);
+			}
+			std::string_view target = args.substr(1, args.find('"', 1) - 1);
+			std::string path = (std::filesystem::path(includer).parent_path() / target).lexically_normal().generic_string();
+			const ShaderSourceFile& file = loadSource(ex->cache, path);
+
+			if (file.once && std::find(ex->expandedOnce.begin(), ex->expandedOnce.end(), path) != ex->expandedOnce.end()) {
+				out += '\n';
+				continue;
+			}
+			if (file.once) ex->expandedOnce.push_back(path);
+
+			uint32_t index = static_cast<uint32_t>(ex->stage->files.size());
+			ex->stage->files.push_back(path);
+			out += fmt::format("#line 1 {}\n", index);
+			expand(ex, file.text, index, 1, depth + 1);
+			if (!out.empty() && out.back() != '\n') out += '\n';
+			out += fmt::format("#line {} {}\n", line + 1, fileIndex);
+		}
+		else {
+			out += l;
+			out += '\n';
+		}
+	}
+}
+
+struct ShaderSection {
+	uint32_t stage;
+	std::string_view text;
+	// line number of the section's first line
+	uint32_t line;
+};
+
+void preprocessShader(ShaderSourceCache* cache, const std::string& path, std::span<const ShaderDefine> defines, std::vector<ShaderStageSource>* stages) {
+	const ShaderSourceFile& file = loadSource(cache, path);
+
+	// split on #type lines, the views point into the cached text
+	std::string_view prologue;
+	std::vector<ShaderSection> sections;
+	std::string_view rest = file.text;
+	uint32_t line = 1;
+	const char* start = file.text.data();
+	while (!rest.empty()) {
+		const char* at = rest.data();
+		std::string_view l = nextLine(&rest);
+		std::string_view args;
+		if (directive(l, &args) == "type") {
+			if (sections.empty()) prologue = std::string_view(start, at - start);
+			else sections.back().text = std::string_view(sections.back().text.data(), at - sections.back().text.data());
+			sections.push_back({ shaderStageFromName(trim(args)), rest, line + 1 });
+		}
+		line++;
+	}
+	if (sections.empty()) {
+		spdlog::error("Failed to read shader file {}. Missing a type header.", path);
+		throw std::runtime_error("Failed to read shader " + path);
+	}
+
+	std::vector<ShaderDefine> sorted(defines.begin(), defines.end());
+	std::sort(sorted.begin(), sorted.end(), [](const ShaderDefine& a, const ShaderDefine& b) { return a.name < b.name; });
+	std::string header;
+	for (const ShaderDefine& d : sorted) header += fmt::format("#define {} {}\n", d.name, d.value);
+
+	for (const ShaderSection& section : sections) {
+		ShaderStageSource body{ section.stage, {}, { path } };
+		Expansion ex{ cache, &body, {}, {} };
+		if (!prologue.empty()) {
+			body.source += "#line 1 0\n";
+			expand(&ex, prologue, 0, 1, 0);
+		}
+		std::string_view shared = ex.version;
+		ex.version = {};
+		body.source += fmt::format("#line {} 0\n", section.line);
+		expand(&ex, section.text, 0, section.line, 0);
+		if (ex.version.empty()) ex.version = shared;
+		if (ex.version.empty()) {
+			spdlog::error("Shader {} has a stage without a #version line", path);
+			throw std::runtime_error("Missing #version in shader " + path);
+		}
+
+		ShaderStageSource stage{ body.stage, {}, std::move(body.files) };
+		stage.source.reserve(ex.version.size() + header.size() + body.source.size() + 1);
+		stage.source += ex.version;
+		stage.source += '\n';
+		stage.source += header;
+		stage.source += body.source;
+		stages->push_back(std::move(stage));
+	}
+}
+
+static void hashBytes(uint64_t* hash, std::string_view bytes) {
+	for (char c : bytes) {
+		*hash ^= static_cast<uint8_t>(c);
+		*hash *= 1099511628211ull;
+	}
+	*hash ^= 0xFF;
+	*hash *= 1099511628211ull;
+}
+
+uint64_t shaderVariantKey(std::span<const std::string> files, std::span<const ShaderDefine> defines) {
+	uint64_t hash = 14695981039346656037ull;
+	for (const std::string& f : files) hashBytes(&hash, f);
+
+	std::vector<ShaderDefine> sorted(defines.begin(), defines.end());
+	std::sort(sorted.begin(), sorted.end(), [](const ShaderDefine& a, const ShaderDefine& b) { return a.name < b.name; });
+	for (const ShaderDefine& d : sorted) {
+		hashBytes(&hash, d.name);
+		hashBytes(&hash, d.value);
+	}
+	return hash;
+}
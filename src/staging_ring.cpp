@@ -0,0 +1,72 @@
+#include "staging_ring.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <stdexcept>
+
+StagingRing* createStagingRing(size_t size) {
+	StagingRing* ring = new StagingRing();
+	ring->size = size;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &ring->handle);
+	glNamedBufferStorage(ring->handle, static_cast<GLsizeiptr>(size), nullptr, flags);
+	ring->mapped = static_cast<uint8_t*>(glMapNamedBufferRange(ring->handle, 0, static_cast<GLsizeiptr>(size), flags));
+	if (ring->mapped == nullptr) {
+		spdlog::error("Failed to map staging ring");
+		throw std::runtime_error("Failed to map staging ring");
+	}
+	return ring;
+}
+
+void destroyStagingRing(StagingRing* ring) {
+	for (StagingRing::Fence& fence : ring->fences) glDeleteSync(fence.sync);
+	glUnmapNamedBuffer(ring->handle);
+	glDeleteBuffers(1, &ring->handle);
+	delete ring;
+}
+
+static uint64_t alignUp(uint64_t v) {
+	return (v + STAGING_ALIGNMENT - 1) & ~static_cast<uint64_t>(STAGING_ALIGNMENT - 1);
+}
+
+size_t stagingContiguousFree(const StagingRing* ring) {
+	uint64_t head = alignUp(ring->head);
+	size_t position = head % ring->size;
+	size_t free = ring->size - static_cast<size_t>(std::min<uint64_t>(head - ring->tail, ring->size));
+	// either up to the end of the buffer, or from its start after skipping the end
+	size_t toEnd = std::min(free, ring->size - position);
+	size_t fromStart = free > toEnd ? std::min(free - toEnd, position) : 0;
+	return std::max(toEnd, fromStart);
+}
+
+StagingAllocation allocateStaging(StagingRing* ring, size_t size) {
+	uint64_t head = alignUp(ring->head);
+	size_t position = head % ring->size;
+	if (position + size > ring->size) {
+		// skip the tail end of the buffer so the allocation stays contiguous
+		head += ring->size - position;
+		position = 0;
+	}
+	if (head + size - ring->tail > ring->size) return { nullptr, 0 };
+
+	ring->head = head + size;
+	return { ring->mapped + position, position };
+}
+
+void fenceStaging(StagingRing* ring) {
+	if (ring->head == ring->fencedHead) return;
+	ring->fences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), ring->head });
+	ring->fencedHead = ring->head;
+}
+
+void retireStaging(StagingRing* ring) {
+	while (!ring->fences.empty()) {
+		StagingRing::Fence& fence = ring->fences.front();
+		GLenum r = glClientWaitSync(fence.sync, 0, 0);
+		if (r == GL_TIMEOUT_EXPIRED) break;
+		glDeleteSync(fence.sync);
+		ring->tail = fence.head;
+		ring->fences.pop_front();
+	}
+}
@@ -0,0 +1,293 @@
+#include "texture.hpp"
+#include "profiler.hpp"
+#include "mapped_file.hpp"
+#include "staging_ring.hpp"
+#include "gl_state.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// EXT_texture_sRGB, not part of the core profile headers
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+static glm::ivec2 levelExtent(glm::ivec2 size, uint32_t level) {
+	return glm::ivec2(std::max(size.x >> level, 1), std::max(size.y >> level, 1));
+}
+
+static uint32_t fullMipCount(glm::ivec2 size) {
+	uint32_t levels = 1;
+	while ((std::max(size.x, size.y) >> levels) > 0) levels++;
+	return levels;
+}
+
+bool textureFormatSupported(GLenum internalFormat) {
+	switch (internalFormat) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		return GLAD_GL_EXT_texture_compression_s3tc != 0;
+	case GL_COMPRESSED_RGBA_ASTC_4x4_KHR:
+	case GL_COMPRESSED_RGBA_ASTC_6x6_KHR:
+	case GL_COMPRESSED_RGBA_ASTC_8x8_KHR:
+	case GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR:
+	case GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR:
+	case GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR:
+		return GLAD_GL_KHR_texture_compression_astc_ldr != 0;
+	default:
+		// RGTC and BPTC are core since 4.2, RGBA8 always
+		return true;
+	}
+}
+
+// vkFormat values from the KTX2 header
+static bool ktxFormatInfo(uint32_t vkFormat, TextureFormatInfo* info) {
+	switch (vkFormat) {
+	case 37: *info = { GL_RGBA8, 1, 1, 4, GL_RGBA, GL_UNSIGNED_BYTE }; return true;
+	case 43: *info = { GL_SRGB8_ALPHA8, 1, 1, 4, GL_RGBA, GL_UNSIGNED_BYTE }; return true;
+	case 131: *info = { GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 4, 4, 8, GL_NONE, GL_NONE }; return true;
+	case 132: *info = { GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 4, 4, 8, GL_NONE, GL_NONE }; return true;
+	case 133: *info = { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 4, 4, 8, GL_NONE, GL_NONE }; return true;
+	case 134: *info = { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 4, 4, 8, GL_NONE, GL_NONE }; return true;
+	case 137: *info = { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 138: *info = { GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 139: *info = { GL_COMPRESSED_RED_RGTC1, 4, 4, 8, GL_NONE, GL_NONE }; return true;
+	case 140: *info = { GL_COMPRESSED_SIGNED_RED_RGTC1, 4, 4, 8, GL_NONE, GL_NONE }; return true;
+	case 141: *info = { GL_COMPRESSED_RG_RGTC2, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 142: *info = { GL_COMPRESSED_SIGNED_RG_RGTC2, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 143: *info = { GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 144: *info = { GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 145: *info = { GL_COMPRESSED_RGBA_BPTC_UNORM, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 146: *info = { GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 157: *info = { GL_COMPRESSED_RGBA_ASTC_4x4_KHR, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 158: *info = { GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR, 4, 4, 16, GL_NONE, GL_NONE }; return true;
+	case 165: *info = { GL_COMPRESSED_RGBA_ASTC_6x6_KHR, 6, 6, 16, GL_NONE, GL_NONE }; return true;
+	case 166: *info = { GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR, 6, 6, 16, GL_NONE, GL_NONE }; return true;
+	case 171: *info = { GL_COMPRESSED_RGBA_ASTC_8x8_KHR, 8, 8, 16, GL_NONE, GL_NONE }; return true;
+	case 172: *info = { GL_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR, 8, 8, 16, GL_NONE, GL_NONE }; return true;
+	default: return false;
+	}
+}
+
+size_t textureLevelBytes(const TextureFormatInfo& format, glm::ivec2 extent) {
+	size_t blocksX = (static_cast<size_t>(extent.x) + format.blockWidth - 1) / format.blockWidth;
+	size_t blocksY = (static_cast<size_t>(extent.y) + format.blockHeight - 1) / format.blockHeight;
+	return blocksX * blocksY * format.blockBytes;
+}
+
+size_t textureResidentBytes(const Texture* texture) {
+	size_t bytes = 0;
+	if (texture->source != nullptr) {
+		for (uint32_t level = texture->residentLevel; level < texture->levelCount; level++) bytes += texture->source->levels[level].bytes;
+		return bytes;
+	}
+
+	// generated chains, sized as RGBA8
+	TextureFormatInfo rgba{ texture->internalFormat, 1, 1, 4 };
+	for (uint32_t level = texture->residentLevel; level < texture->levelCount; level++) bytes += textureLevelBytes(rgba, levelExtent(texture->size, level));
+	return bytes;
+}
+
+static uint32_t createStorage(glm::ivec2 size, GLenum internalFormat, uint32_t levelCount) {
+	uint32_t handle;
+	glCreateTextures(GL_TEXTURE_2D, 1, &handle);
+	glTextureStorage2D(handle, static_cast<GLsizei>(levelCount), internalFormat, size.x, size.y);
+	glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(handle, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(handle, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameterf(handle, GL_TEXTURE_MAX_ANISOTROPY, TEXTURE_MAX_ANISOTROPY);
+	return handle;
+}
+
+Texture* createTexture(glm::ivec2 size, GLenum internalFormat, uint32_t levelCount) {
+	Texture* texture = new Texture();
+	texture->size = size;
+	texture->internalFormat = internalFormat;
+	texture->levelCount = std::clamp(levelCount, 1u, fullMipCount(size));
+	texture->handle = createStorage(size, internalFormat, texture->levelCount);
+	return texture;
+}
+
+Texture* createTextureRGBA8(const uint8_t* pixels, glm::ivec2 size, bool mipmaps) {
+	Texture* texture = createTexture(size, GL_RGBA8, mipmaps ? fullMipCount(size) : 1);
+	glTextureSubImage2D(texture->handle, 0, 0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	countUpload(static_cast<uint64_t>(size.x) * size.y * 4);
+	if (texture->levelCount > 1) glGenerateTextureMipmap(texture->handle);
+	return texture;
+}
+
+static void uploadLevel(uint32_t handle, uint32_t glLevel, const TextureSource* source, uint32_t level, StagingRing* staging) {
+	const TextureLevel& l = source->levels[level];
+	const TextureFormatInfo& format = source->format;
+	const uint8_t* pixels = source->file->data + l.offset;
+	countUpload(l.bytes);
+
+	// through the staging ring the copy out of the mapping is ours and the GL reads from a PBO, without it the driver copies synchronously
+	StagingAllocation alloc = staging != nullptr ? allocateStaging(staging, l.bytes) : StagingAllocation{ nullptr, 0 };
+	const void* src = pixels;
+	if (alloc.data != nullptr) {
+		std::memcpy(alloc.data, pixels, l.bytes);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->handle);
+		src = reinterpret_cast<const void*>(alloc.offset);
+	}
+
+	if (format.format == GL_NONE) {
+		glCompressedTextureSubImage2D(handle, static_cast<GLint>(glLevel), 0, 0, l.extent.x, l.extent.y, format.internalFormat, static_cast<GLsizei>(l.bytes), src);
+	}
+	else {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(handle, static_cast<GLint>(glLevel), 0, 0, l.extent.x, l.extent.y, format.format, format.type, src);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	if (alloc.data != nullptr) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/*
+KTX2 layout, little endian:
+  12 byte identifier
+  vkFormat typeSize pixelWidth pixelHeight pixelDepth layerCount faceCount levelCount supercompressionScheme, uint32 each
+  dfd offset and length, kvd offset and length as uint32, sgd offset and length as uint64
+  per level: byteOffset byteLength uncompressedByteLength, uint64 each
+*/
+static constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static constexpr size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+
+struct Ktx2Header {
+	uint32_t vkFormat, typeSize, pixelWidth, pixelHeight, pixelDepth, layerCount, faceCount, levelCount, supercompressionScheme;
+};
+
+static void invalidKtx2(MappedFile* file, const std::string& path, const char* what) {
+	unmapFile(file);
+	spdlog::error("Failed to load texture {}: {}", path, what);
+	throw std::runtime_error("Failed to load texture " + path);
+}
+
+Texture* loadKtx2(const std::string& path, bool streamed) {
+	MappedFile* file = mapFile(path);
+	if (file->size < KTX2_LEVEL_INDEX_OFFSET || std::memcmp(file->data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) invalidKtx2(file, path, "not a KTX2 file");
+
+	Ktx2Header header;
+	std::memcpy(&header, file->data + sizeof(KTX2_IDENTIFIER), sizeof(header));
+	if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0) invalidKtx2(file, path, "only 2D textures are supported");
+	if (header.supercompressionScheme != 0) invalidKtx2(file, path, "supercompressed files are not supported");
+
+	TextureSource* source = new TextureSource();
+	source->file = file;
+	if (!ktxFormatInfo(header.vkFormat, &source->format)) {
+		delete source;
+		invalidKtx2(file, path, "unsupported format");
+	}
+	if (!textureFormatSupported(source->format.internalFormat)) {
+		delete source;
+		invalidKtx2(file, path, "format not supported by the driver");
+	}
+
+	glm::ivec2 size(static_cast<int32_t>(header.pixelWidth), static_cast<int32_t>(header.pixelHeight));
+	// 0 asks the loader to generate the chain
+	uint32_t fileLevels = std::max(header.levelCount, 1u);
+	if (fileLevels > fullMipCount(size) || file->size < KTX2_LEVEL_INDEX_OFFSET + fileLevels * 24) {
+		delete source;
+		invalidKtx2(file, path, "bad level count");
+	}
+
+	for (uint32_t level = 0; level < fileLevels; level++) {
+		uint64_t entry[3];
+		std::memcpy(entry, file->data + KTX2_LEVEL_INDEX_OFFSET + level * sizeof(entry), sizeof(entry));
+		TextureLevel l{ static_cast<size_t>(entry[0]), static_cast<size_t>(entry[1]), levelExtent(size, level) };
+		if (l.bytes != textureLevelBytes(source->format, l.extent) || l.offset > file->size || l.bytes > file->size - l.offset) {
+			delete source;
+			invalidKtx2(file, path, "level out of range");
+		}
+		source->levels.push_back(l);
+	}
+
+	bool generate = fileLevels == 1 && source->format.format != GL_NONE;
+	if (generate) {
+		// a single uncompressed level is uploaded whole and mipmapped on the GPU, nothing stays mapped
+		Texture* texture = createTexture(size, source->format.internalFormat, fullMipCount(size));
+		uploadLevel(texture->handle, 0, source, 0, nullptr);
+		glGenerateTextureMipmap(texture->handle);
+		delete source;
+		unmapFile(file);
+		return texture;
+	}
+
+	Texture* texture = new Texture();
+	texture->size = size;
+	texture->internalFormat = source->format.internalFormat;
+	texture->levelCount = fileLevels;
+	texture->source = source;
+
+	// start from the finest level that is still small, or everything when not streamed
+	uint32_t first = 0;
+	if (streamed) {
+		while (first + 1 < fileLevels && static_cast<uint32_t>(std::max(source->levels[first].extent.x, source->levels[first].extent.y)) > TEXTURE_STREAMING_MIN_SIZE) first++;
+	}
+	texture->residentLevel = fileLevels;
+	texture->handle = 0;
+	setResidentLevel(texture, first);
+
+	if (!streamed) {
+		texture->source = nullptr;
+		delete source;
+		unmapFile(file);
+	}
+	return texture;
+}
+
+static void releaseTexture(Texture* texture) {
+	if (texture->bindlessOf == texture->handle && texture->bindlessHandle != 0) {
+		glMakeTextureHandleNonResidentARB(texture->bindlessHandle);
+		texture->bindlessHandle = 0;
+		texture->bindlessOf = 0;
+	}
+	forgetTexture(&glState, texture->handle);
+	glDeleteTextures(1, &texture->handle);
+}
+
+void setResidentLevel(Texture* texture, uint32_t level, StagingRing* staging) {
+	level = std::min(level, texture->levelCount - 1);
+	if (level == texture->residentLevel) return;
+	if (level < texture->residentLevel && texture->source == nullptr) {
+		spdlog::error("Texture levels below {} cannot be made resident, it has no source", texture->residentLevel);
+		throw std::runtime_error("Texture has no source to stream from");
+	}
+
+	glm::ivec2 extent = levelExtent(texture->size, level);
+	uint32_t handle = createStorage(extent, texture->internalFormat, texture->levelCount - level);
+
+	// levels both storages hold are copied on the GPU, the rest come from the source
+	for (uint32_t l = level; l < texture->levelCount; l++) {
+		if (texture->handle != 0 && l >= texture->residentLevel) {
+			glm::ivec2 e = levelExtent(texture->size, l);
+			glCopyImageSubData(texture->handle, GL_TEXTURE_2D, static_cast<GLint>(l - texture->residentLevel), 0, 0, 0,
+				handle, GL_TEXTURE_2D, static_cast<GLint>(l - level), 0, 0, 0, e.x, e.y, 1);
+		}
+		else {
+			uploadLevel(handle, l - level, texture->source, l, staging);
+		}
+	}
+
+	if (texture->handle != 0) releaseTexture(texture);
+	texture->handle = handle;
+	texture->residentLevel = level;
+}
+
+void destroyTexture(Texture* texture) {
+	releaseTexture(texture);
+	if (texture->source != nullptr) {
+		unmapFile(texture->source->file);
+		delete texture->source;
+	}
+	delete texture;
+}
@@ -0,0 +1,109 @@
+#include "texture_streamer.hpp"
+#include "staging_ring.hpp"
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+TextureStreamer* createTextureStreamer(size_t budget, StagingRing* staging) {
+	TextureStreamer* streamer = new TextureStreamer();
+	streamer->budget = budget;
+	streamer->staging = staging;
+	return streamer;
+}
+
+void addStreamedTexture(TextureStreamer* streamer, Texture* texture) {
+	if (texture->source == nullptr) return;
+	streamer->textures.push_back(texture);
+}
+
+void removeStreamedTexture(TextureStreamer* streamer, Texture* texture) {
+	std::erase(streamer->textures, texture);
+}
+
+void noteMaterialUsage(const Material* material, float pixels) {
+	for (Texture* texture : material->textures) {
+		if (texture == nullptr || texture->source == nullptr) continue;
+		texture->source->footprint = std::max(texture->source->footprint, pixels);
+	}
+}
+
+uint32_t desiredTextureLevel(const Texture* texture, float pixels) {
+	float texels = static_cast<float>(std::max(texture->size.x, texture->size.y));
+	if (pixels <= 0.0f) return texture->levelCount - 1;
+	// the finer of the two levels around the exact ratio, so magnification never shows
+	float level = std::floor(std::log2(std::max(texels / pixels, 1.0f)));
+	return std::min(static_cast<uint32_t>(level), texture->levelCount - 1);
+}
+
+// coarsest level streaming may drop to, the same level loadKtx2 starts from
+static uint32_t floorLevel(const Texture* texture) {
+	uint32_t level = 0;
+	const std::vector<TextureLevel>& levels = texture->source->levels;
+	while (level + 1 < texture->levelCount && static_cast<uint32_t>(std::max(levels[level].extent.x, levels[level].extent.y)) > TEXTURE_STREAMING_MIN_SIZE) level++;
+	return level;
+}
+
+static size_t levelBytes(const Texture* texture, uint32_t level) {
+	return texture->source->levels[level].bytes;
+}
+
+// drops the finest level of the least recently used textures that are not needed at it, until `needed` more bytes fit
+static bool evict(TextureStreamer* streamer, size_t needed, uint64_t keepFrame) {
+	while (streamer->stats.residentBytes + needed > streamer->budget) {
+		Texture* victim = nullptr;
+		for (Texture* texture : streamer->textures) {
+			if (texture->residentLevel >= floorLevel(texture)) continue;
+			// textures drawn this frame only lose levels finer than they currently need
+			if (texture->source->lastUsedFrame >= keepFrame && texture->residentLevel >= desiredTextureLevel(texture, texture->source->footprint)) continue;
+			if (victim == nullptr || texture->source->lastUsedFrame < victim->source->lastUsedFrame) victim = texture;
+		}
+		if (victim == nullptr) return false;
+
+		streamer->stats.residentBytes -= levelBytes(victim, victim->residentLevel);
+		setResidentLevel(victim, victim->residentLevel + 1, streamer->staging);
+		streamer->stats.evicted++;
+	}
+	return true;
+}
+
+void updateTextureStreaming(TextureStreamer* streamer) {
+	streamer->frame++;
+	streamer->stats.upgraded = 0;
+	streamer->stats.evicted = 0;
+	streamer->stats.starved = 0;
+
+	size_t resident = 0;
+	FrameVector<Texture*> wanting;
+	wanting.reserve(streamer->textures.size());
+	for (Texture* texture : streamer->textures) {
+		TextureSource* source = texture->source;
+		if (source->footprint > 0.0f) source->lastUsedFrame = streamer->frame;
+		resident += textureResidentBytes(texture);
+		if (desiredTextureLevel(texture, source->footprint) < texture->residentLevel) wanting.push_back(texture);
+	}
+	streamer->stats.residentBytes = resident;
+
+	// the biggest gap between needed and resident detail first
+	std::sort(wanting.begin(), wanting.end(), [](const Texture* a, const Texture* b) {
+		return a->residentLevel - desiredTextureLevel(a, a->source->footprint) > b->residentLevel - desiredTextureLevel(b, b->source->footprint);
+	});
+
+	for (Texture* texture : wanting) {
+		if (streamer->stats.upgraded == TEXTURE_UPGRADES_PER_FRAME) break;
+		size_t bytes = levelBytes(texture, texture->residentLevel - 1);
+		if (!evict(streamer, bytes, streamer->frame)) {
+			streamer->stats.starved++;
+			continue;
+		}
+		setResidentLevel(texture, texture->residentLevel - 1, streamer->staging);
+		streamer->stats.residentBytes += bytes;
+		streamer->stats.upgraded++;
+	}
+
+	// a lowered budget, or textures added since the last frame
+	evict(streamer, 0, streamer->frame);
+
+	for (Texture* texture : streamer->textures) texture->source->footprint = 0.0f;
+	if (streamer->staging != nullptr) fenceStaging(streamer->staging);
+}
@@ -0,0 +1,191 @@
+#include "transform_kernel.hpp"
+#include "transform_kernel_impl.hpp"
+
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+#if defined(TRANSFORM_KERNEL_X86)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TRANSFORM_KERNEL_NEON 1
+#endif
+
+// the kernel reads the glm arrays as packed floats
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be tightly packed");
+static_assert(sizeof(glm::fquat) == 4 * sizeof(float), "glm::fquat must be tightly packed");
+static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "glm::mat4 must be tightly packed");
+static_assert(sizeof(Aabb) == 6 * sizeof(float), "Aabb must be tightly packed");
+
+namespace {
+
+#if defined(TRANSFORM_KERNEL_X86)
+struct Sse2Lanes {
+	using F = __m128;
+	static constexpr size_t width = 4;
+
+	static F set1(float v) { return _mm_set1_ps(v); }
+	static F add(F a, F b) { return _mm_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+	static F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+	static F gather(const float* base, size_t stride) {
+		return _mm_setr_ps(base[0], base[stride], base[2 * stride], base[3 * stride]);
+	}
+
+	static void scatter(float* base, size_t stride, F v) {
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, v);
+		for (size_t k = 0; k < 4; k++) base[k * stride] = lanes[k];
+	}
+
+	// one column of four consecutive matrices
+	static void storeColumn(float* out, F x, F y, F z, F w) {
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(out + 0, x);
+		_mm_storeu_ps(out + 16, y);
+		_mm_storeu_ps(out + 32, z);
+		_mm_storeu_ps(out + 48, w);
+	}
+};
+#endif
+
+#if defined(TRANSFORM_KERNEL_NEON)
+struct NeonLanes {
+	using F = float32x4_t;
+	static constexpr size_t width = 4;
+
+	static F set1(float v) { return vdupq_n_f32(v); }
+	static F add(F a, F b) { return vaddq_f32(a, b); }
+	static F sub(F a, F b) { return vsubq_f32(a, b); }
+	static F mul(F a, F b) { return vmulq_f32(a, b); }
+	static F abs(F a) { return vabsq_f32(a); }
+
+	static F gather(const float* base, size_t stride) {
+		float lanes[4] = { base[0], base[stride], base[2 * stride], base[3 * stride] };
+		return vld1q_f32(lanes);
+	}
+
+	static void scatter(float* base, size_t stride, F v) {
+		float lanes[4];
+		vst1q_f32(lanes, v);
+		for (size_t k = 0; k < 4; k++) base[k * stride] = lanes[k];
+	}
+
+	static void storeColumn(float* out, F x, F y, F z, F w) {
+		float32x4x2_t xy = vtrnq_f32(x, y);
+		float32x4x2_t zw = vtrnq_f32(z, w);
+		vst1q_f32(out + 0, vcombine_f32(vget_low_f32(xy.val[0]), vget_low_f32(zw.val[0])));
+		vst1q_f32(out + 16, vcombine_f32(vget_low_f32(xy.val[1]), vget_low_f32(zw.val[1])));
+		vst1q_f32(out + 32, vcombine_f32(vget_high_f32(xy.val[0]), vget_high_f32(zw.val[0])));
+		vst1q_f32(out + 48, vcombine_f32(vget_high_f32(xy.val[1]), vget_high_f32(zw.val[1])));
+	}
+};
+#endif
+
+}
+
+static bool cpuHasAvx2() {
+#if defined(TRANSFORM_KERNEL_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	// the OS has to save the ymm registers on context switch
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif defined(TRANSFORM_KERNEL_X86)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+bool transformKernelSupported(TransformKernelIsa isa) {
+	switch (isa) {
+	case TransformKernelIsa::Scalar:
+		return true;
+#if defined(TRANSFORM_KERNEL_X86)
+	case TransformKernelIsa::Sse2:
+		return true;
+	case TransformKernelIsa::Avx2: {
+		static const bool avx2 = cpuHasAvx2();
+		return avx2;
+	}
+#endif
+#if defined(TRANSFORM_KERNEL_NEON)
+	case TransformKernelIsa::Neon:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+TransformKernelIsa transformKernelIsa() {
+	static const TransformKernelIsa isa = [] {
+		for (TransformKernelIsa candidate : { TransformKernelIsa::Avx2, TransformKernelIsa::Neon, TransformKernelIsa::Sse2 }) {
+			if (transformKernelSupported(candidate)) return candidate;
+		}
+		return TransformKernelIsa::Scalar;
+	}();
+	return isa;
+}
+
+const char* transformKernelName(TransformKernelIsa isa) {
+	switch (isa) {
+	case TransformKernelIsa::Sse2: return "sse2";
+	case TransformKernelIsa::Avx2: return "avx2";
+	case TransformKernelIsa::Neon: return "neon";
+	default: return "scalar";
+	}
+}
+
+void batchTransforms(TransformKernelIsa isa, const glm::vec3* positions, const glm::fquat* rotations, const glm::vec3* scales, const Aabb* localBounds, size_t count, glm::mat4* outWorld, Aabb* outBounds) {
+	if (!transformKernelSupported(isa)) {
+		spdlog::error("Transform kernel {} is not supported on this CPU", transformKernelName(isa));
+		throw std::runtime_error("Transform kernel is not supported on this CPU");
+	}
+
+	const float* pos = reinterpret_cast<const float*>(positions);
+	const float* rot = reinterpret_cast<const float*>(rotations);
+	const float* scl = reinterpret_cast<const float*>(scales);
+	const float* lb = outBounds != nullptr ? reinterpret_cast<const float*>(localBounds) : nullptr;
+	float* world = reinterpret_cast<float*>(outWorld);
+	float* wb = reinterpret_cast<float*>(outBounds);
+
+	switch (isa) {
+#if defined(TRANSFORM_KERNEL_X86)
+	case TransformKernelIsa::Avx2:
+		runTransformKernelAvx2(pos, rot, scl, lb, count, world, wb);
+		break;
+	case TransformKernelIsa::Sse2:
+		runTransformKernel<Sse2Lanes>(pos, rot, scl, lb, count, world, wb);
+		break;
+#endif
+#if defined(TRANSFORM_KERNEL_NEON)
+	case TransformKernelIsa::Neon:
+		runTransformKernel<NeonLanes>(pos, rot, scl, lb, count, world, wb);
+		break;
+#endif
+	default:
+		runTransformKernel<ScalarLanes>(pos, rot, scl, lb, count, world, wb);
+		break;
+	}
+}
+
+void batchTransforms(const glm::vec3* positions, const glm::fquat* rotations, const glm::vec3* scales, const Aabb* localBounds, size_t count, glm::mat4* outWorld, Aabb* outBounds) {
+	batchTransforms(transformKernelIsa(), positions, rotations, scales, localBounds, count, outWorld, outBounds);
+}
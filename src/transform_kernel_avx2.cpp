@@ -0,0 +1,58 @@
+// built with AVX2 enabled, only ever called after transformKernelSupported said so
+#include "transform_kernel_impl.hpp"
+
+#if defined(TRANSFORM_KERNEL_X86)
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Lanes {
+	using F = __m256;
+	static constexpr size_t width = 8;
+
+	static F set1(float v) { return _mm256_set1_ps(v); }
+	static F add(F a, F b) { return _mm256_add_ps(a, b); }
+	static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+	static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+	static F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+	static F gather(const float* base, size_t stride) {
+		int s = static_cast<int>(stride);
+		__m256i offsets = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+		return _mm256_i32gather_ps(base, offsets, 4);
+	}
+
+	static void scatter(float* base, size_t stride, F v) {
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, v);
+		for (size_t k = 0; k < 8; k++) base[k * stride] = lanes[k];
+	}
+
+	// transposes within each 128 bit half, the low half holds matrices 0-3 and the high half 4-7
+	static void storeColumn(float* out, F x, F y, F z, F w) {
+		F xy0 = _mm256_unpacklo_ps(x, y), xy1 = _mm256_unpackhi_ps(x, y);
+		F zw0 = _mm256_unpacklo_ps(z, w), zw1 = _mm256_unpackhi_ps(z, w);
+		F r0 = _mm256_shuffle_ps(xy0, zw0, 0x44);
+		F r1 = _mm256_shuffle_ps(xy0, zw0, 0xEE);
+		F r2 = _mm256_shuffle_ps(xy1, zw1, 0x44);
+		F r3 = _mm256_shuffle_ps(xy1, zw1, 0xEE);
+
+		_mm_storeu_ps(out + 0, _mm256_castps256_ps128(r0));
+		_mm_storeu_ps(out + 16, _mm256_castps256_ps128(r1));
+		_mm_storeu_ps(out + 32, _mm256_castps256_ps128(r2));
+		_mm_storeu_ps(out + 48, _mm256_castps256_ps128(r3));
+		_mm_storeu_ps(out + 64, _mm256_extractf128_ps(r0, 1));
+		_mm_storeu_ps(out + 80, _mm256_extractf128_ps(r1, 1));
+		_mm_storeu_ps(out + 96, _mm256_extractf128_ps(r2, 1));
+		_mm_storeu_ps(out + 112, _mm256_extractf128_ps(r3, 1));
+	}
+};
+
+}
+
+void runTransformKernelAvx2(const float* pos, const float* rot, const float* scl, const float* localBounds, size_t count, float* world, float* worldBounds) {
+	runTransformKernel<Avx2Lanes>(pos, rot, scl, localBounds, count, world, worldBounds);
+	// avoid the AVX-SSE transition penalty in the caller
+	_mm256_zeroupper();
+}
+#endif
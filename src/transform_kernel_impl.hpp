@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+width-generic body of the batch transform kernel, instantiated once per
+instruction set. included by translation units built with different target
+flags, so everything here has internal linkage and must not pull in glm or
+the standard library: an inline function emitted with AVX2 could otherwise
+be picked by the linker for code that runs on any CPU.
+
+layouts, all tightly packed floats:
+  positions, scales: x y z
+  rotations:         x y z w
+  bounds:            min.xyz max.xyz
+  world:             column-major 4x4
+*/
+
+#include <cstddef>
+
+namespace {
+
+struct ScalarLanes {
+	using F = float;
+	static constexpr size_t width = 1;
+
+	static F set1(float v) { return v; }
+	static F add(F a, F b) { return a + b; }
+	static F sub(F a, F b) { return a - b; }
+	static F mul(F a, F b) { return a * b; }
+	static F abs(F a) { return a < 0.0f ? -a : a; }
+	static F gather(const float* base, size_t) { return *base; }
+	static void scatter(float* base, size_t, F v) { *base = v; }
+
+	static void storeColumn(float* out, F x, F y, F z, F w) {
+		out[0] = x; out[1] = y; out[2] = z; out[3] = w;
+	}
+};
+
+template<typename V>
+static void transformBlock(const float* pos, const float* rot, const float* scl, const float* localBounds, float* world, float* worldBounds) {
+	using F = typename V::F;
+
+	F px = V::gather(pos + 0, 3), py = V::gather(pos + 1, 3), pz = V::gather(pos + 2, 3);
+	F qx = V::gather(rot + 0, 4), qy = V::gather(rot + 1, 4), qz = V::gather(rot + 2, 4), qw = V::gather(rot + 3, 4);
+	F sx = V::gather(scl + 0, 3), sy = V::gather(scl + 1, 3), sz = V::gather(scl + 2, 3);
+
+	F one = V::set1(1.0f), two = V::set1(2.0f), zero = V::set1(0.0f);
+
+	F xx = V::mul(qx, qx), yy = V::mul(qy, qy), zz = V::mul(qz, qz);
+	F xy = V::mul(qx, qy), xz = V::mul(qx, qz), yz = V::mul(qy, qz);
+	F wx = V::mul(qw, qx), wy = V::mul(qw, qy), wz = V::mul(qw, qz);
+
+	// rotation columns, each scaled by its axis scale
+	F c0x = V::mul(V::sub(one, V::mul(two, V::add(yy, zz))), sx);
+	F c0y = V::mul(V::mul(two, V::add(xy, wz)), sx);
+	F c0z = V::mul(V::mul(two, V::sub(xz, wy)), sx);
+
+	F c1x = V::mul(V::mul(two, V::sub(xy, wz)), sy);
+	F c1y = V::mul(V::sub(one, V::mul(two, V::add(xx, zz))), sy);
+	F c1z = V::mul(V::mul(two, V::add(yz, wx)), sy);
+
+	F c2x = V::mul(V::mul(two, V::add(xz, wy)), sz);
+	F c2y = V::mul(V::mul(two, V::sub(yz, wx)), sz);
+	F c2z = V::mul(V::sub(one, V::mul(two, V::add(xx, yy))), sz);
+
+	V::storeColumn(world + 0, c0x, c0y, c0z, zero);
+	V::storeColumn(world + 4, c1x, c1y, c1z, zero);
+	V::storeColumn(world + 8, c2x, c2y, c2z, zero);
+	V::storeColumn(world + 12, px, py, pz, one);
+
+	if (localBounds == nullptr) return;
+
+	// Arvo: transform the box center, and the extents through the absolute rotation-scale
+	F half = V::set1(0.5f);
+	F lx = V::gather(localBounds + 0, 6), ly = V::gather(localBounds + 1, 6), lz = V::gather(localBounds + 2, 6);
+	F hx = V::gather(localBounds + 3, 6), hy = V::gather(localBounds + 4, 6), hz = V::gather(localBounds + 5, 6);
+	F cx = V::mul(V::add(lx, hx), half), cy = V::mul(V::add(ly, hy), half), cz = V::mul(V::add(lz, hz), half);
+	F ex = V::mul(V::sub(hx, lx), half), ey = V::mul(V::sub(hy, ly), half), ez = V::mul(V::sub(hz, lz), half);
+
+	F wcx = V::add(V::add(V::add(V::mul(c0x, cx), V::mul(c1x, cy)), V::mul(c2x, cz)), px);
+	F wcy = V::add(V::add(V::add(V::mul(c0y, cx), V::mul(c1y, cy)), V::mul(c2y, cz)), py);
+	F wcz = V::add(V::add(V::add(V::mul(c0z, cx), V::mul(c1z, cy)), V::mul(c2z, cz)), pz);
+
+	F wex = V::add(V::add(V::mul(V::abs(c0x), ex), V::mul(V::abs(c1x), ey)), V::mul(V::abs(c2x), ez));
+	F wey = V::add(V::add(V::mul(V::abs(c0y), ex), V::mul(V::abs(c1y), ey)), V::mul(V::abs(c2y), ez));
+	F wez = V::add(V::add(V::mul(V::abs(c0z), ex), V::mul(V::abs(c1z), ey)), V::mul(V::abs(c2z), ez));
+
+	V::scatter(worldBounds + 0, 6, V::sub(wcx, wex));
+	V::scatter(worldBounds + 1, 6, V::sub(wcy, wey));
+	V::scatter(worldBounds + 2, 6, V::sub(wcz, wez));
+	V::scatter(worldBounds + 3, 6, V::add(wcx, wex));
+	V::scatter(worldBounds + 4, 6, V::add(wcy, wey));
+	V::scatter(worldBounds + 5, 6, V::add(wcz, wez));
+}
+
+template<typename V>
+static void runTransformKernel(const float* pos, const float* rot, const float* scl, const float* localBounds, size_t count, float* world, float* worldBounds) {
+	constexpr size_t W = V::width;
+	bool bounds = localBounds != nullptr && worldBounds != nullptr;
+
+	size_t i = 0;
+	for (; i + W <= count; i += W) {
+		transformBlock<V>(pos + i * 3, rot + i * 4, scl + i * 3, bounds ? localBounds + i * 6 : nullptr, world + i * 16, bounds ? worldBounds + i * 6 : nullptr);
+	}
+	for (; i < count; i++) {
+		transformBlock<ScalarLanes>(pos + i * 3, rot + i * 4, scl + i * 3, bounds ? localBounds + i * 6 : nullptr, world + i * 16, bounds ? worldBounds + i * 6 : nullptr);
+	}
+}
+
+}
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRANSFORM_KERNEL_X86 1
+// defined in transform_kernel_avx2.cpp, the only file built with AVX2 enabled
+void runTransformKernelAvx2(const float* pos, const float* rot, const float* scl, const float* localBounds, size_t count, float* world, float* worldBounds);
+#endif
@@ -0,0 +1,84 @@
+#include "transient_buffer.hpp"
+#include "profiler.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+TransientBuffer* createTransientBuffer(size_t regionSize) {
+	TransientBuffer* buffer = new TransientBuffer();
+	buffer->regionSize = regionSize;
+
+	GLint alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	buffer->uniformAlignment = static_cast<uint32_t>(std::max(alignment, 1));
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	buffer->storageAlignment = static_cast<uint32_t>(std::max(alignment, 1));
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = static_cast<GLsizeiptr>(regionSize * TRANSIENT_BUFFER_FRAMES);
+
+	glCreateBuffers(1, &buffer->handle);
+	glNamedBufferStorage(buffer->handle, size, nullptr, flags);
+	buffer->mapped = static_cast<uint8_t*>(glMapNamedBufferRange(buffer->handle, 0, size, flags));
+	if (buffer->mapped == nullptr) {
+		spdlog::error("Failed to map transient buffer");
+		throw std::runtime_error("Failed to map transient buffer");
+	}
+
+	glCreateBuffers(1, &buffer->overflow);
+	glNamedBufferStorage(buffer->overflow, TRANSIENT_OVERFLOW_SIZE, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	return buffer;
+}
+
+void beginTransientFrame(TransientBuffer* buffer) {
+	if (buffer->overflowBytes > 0) {
+		spdlog::warn("Transient buffer overflowed by {} bytes last frame, consider a larger region", buffer->overflowBytes);
+		buffer->overflowBytes = 0;
+	}
+	buffer->region = (buffer->region + 1) % TRANSIENT_BUFFER_FRAMES;
+	buffer->used = 0;
+
+	GLsync& fence = buffer->fences[buffer->region];
+	if (fence == nullptr) return;
+
+	while (true) {
+		GLenum r = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		if (r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED || r == GL_WAIT_FAILED) break;
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void endTransientFrame(TransientBuffer* buffer) {
+	GLsync& fence = buffer->fences[buffer->region];
+	if (fence != nullptr) glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+TransientAllocation allocateTransient(TransientBuffer* buffer, size_t size, size_t alignment) {
+	size_t base = buffer->region * buffer->regionSize;
+	// offsets are aligned from the start of the buffer, that is what glBindBufferRange checks
+	size_t offset = (base + buffer->used + alignment - 1) / alignment * alignment;
+	if (offset + size > base + buffer->regionSize) {
+		buffer->overflowBytes += size;
+		return { nullptr, 0 };
+	}
+
+	buffer->used = offset + size - base;
+	return { buffer->mapped + offset, offset };
+}
+
+void bindTransientUniforms(TransientBuffer* buffer, uint32_t binding, const void* data, size_t size) {
+	countUpload(size);
+	TransientAllocation alloc = allocateTransient(buffer, size, buffer->uniformAlignment);
+	if (alloc.data != nullptr) {
+		memcpy(alloc.data, data, size);
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer->handle, static_cast<GLintptr>(alloc.offset), static_cast<GLsizeiptr>(size));
+		return;
+	}
+
+	glNamedBufferSubData(buffer->overflow, 0, static_cast<GLsizeiptr>(std::min(size, TRANSIENT_OVERFLOW_SIZE)), data);
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer->overflow, 0, static_cast<GLsizeiptr>(std::min(size, TRANSIENT_OVERFLOW_SIZE)));
+}
@@ -0,0 +1,91 @@
+#include "uniform_table.hpp"
+
+#include <spdlog/spdlog.h>
+
+static std::string resourceName(uint32_t program, GLenum iface, uint32_t index, int32_t length) {
+	std::string name(length, '\0');
+	glGetProgramResourceName(program, iface, index, length, &length, name.data());
+	name.resize(length);
+
+	// arrays are reported as "name[0]", but are looked up by their base name
+	if (name.ends_with("[0]")) name.resize(name.size() - 3);
+	return name;
+}
+
+static size_t tableSize(size_t count) {
+	// keep the load factor at or below one half
+	size_t size = 1;
+	while (size < count * 2) size <<= 1;
+	return size;
+}
+
+template<typename T>
+static void buildSlots(const std::vector<T>& entries, std::vector<int32_t>& slots) {
+	slots.assign(tableSize(entries.size()), -1);
+	size_t mask = slots.size() - 1;
+	for (size_t i = 0; i < entries.size(); i++) {
+		size_t s = entries[i].hash & mask;
+		while (slots[s] != -1) s = (s + 1) & mask;
+		slots[s] = static_cast<int32_t>(i);
+	}
+}
+
+template<typename T>
+static const T* findEntry(const std::vector<T>& entries, const std::vector<int32_t>& slots, std::string_view name) {
+	if (slots.empty()) return nullptr;
+
+	uint32_t hash = hashName(name);
+	size_t mask = slots.size() - 1;
+	for (size_t s = hash & mask; slots[s] != -1; s = (s + 1) & mask) {
+		const T& e = entries[slots[s]];
+		if (e.hash == hash && e.name == name) return &e;
+	}
+	return nullptr;
+}
+
+void reflectProgram(uint32_t program, UniformTable* table) {
+	table->uniforms.clear();
+	table->blocks.clear();
+
+	int count = 0;
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+	const GLenum uniformProps[] = { GL_NAME_LENGTH, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+	for (int i = 0; i < count; i++) {
+		int values[5];
+		glGetProgramResourceiv(program, GL_UNIFORM, i, 5, uniformProps, 5, nullptr, values);
+
+		// members of uniform blocks have no location of their own
+		if (values[4] != -1) continue;
+
+		std::string name = resourceName(program, GL_UNIFORM, i, values[0]);
+		table->uniforms.push_back({ hashName(name), values[1], static_cast<GLenum>(values[2]), values[3], std::move(name) });
+	}
+
+	glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+	const GLenum blockProps[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+	for (int i = 0; i < count; i++) {
+		int values[3];
+		glGetProgramResourceiv(program, GL_UNIFORM_BLOCK, i, 3, blockProps, 3, nullptr, values);
+
+		std::string name = resourceName(program, GL_UNIFORM_BLOCK, i, values[0]);
+		table->blocks.push_back({ hashName(name), static_cast<uint32_t>(i), values[1], values[2], std::move(name) });
+	}
+
+	buildSlots(table->uniforms, table->uniformSlots);
+	buildSlots(table->blocks, table->blockSlots);
+
+	spdlog::debug("Program {} has {} uniforms and {} uniform blocks", program, table->uniforms.size(), table->blocks.size());
+}
+
+const UniformInfo* findUniform(const UniformTable* table, std::string_view name) {
+	return findEntry(table->uniforms, table->uniformSlots, name);
+}
+
+const UniformBlockInfo* findUniformBlock(const UniformTable* table, std::string_view name) {
+	return findEntry(table->blocks, table->blockSlots, name);
+}
+
+int32_t uniformLocation(const UniformTable* table, std::string_view name) {
+	const UniformInfo* u = findUniform(table, name);
+	return u != nullptr ? u->location : -1;
+}
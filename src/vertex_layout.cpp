@@ -0,0 +1,164 @@
+#include "vertex_layout.hpp"
+#include "game.hpp"
+
+#include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
+#include <spdlog/spdlog.h>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+struct AttributeFormatInfo {
+	int32_t components;
+	GLenum type;
+	bool normalized;
+	uint32_t size;
+};
+
+static AttributeFormatInfo formatInfo(AttributeFormat format) {
+	switch (format) {
+	case AttributeFormat::Float2: return { 2, GL_FLOAT, false, 8 };
+	case AttributeFormat::Float3: return { 3, GL_FLOAT, false, 12 };
+	case AttributeFormat::Float4: return { 4, GL_FLOAT, false, 16 };
+	case AttributeFormat::Half2: return { 2, GL_HALF_FLOAT, false, 4 };
+	case AttributeFormat::Half4: return { 4, GL_HALF_FLOAT, false, 8 };
+	case AttributeFormat::Unorm8x4: return { 4, GL_UNSIGNED_BYTE, true, 4 };
+	case AttributeFormat::Snorm10x3_2: return { 4, GL_INT_2_10_10_10_REV, true, 4 };
+	default: return { 0, GL_NONE, false, 0 };
+	}
+}
+
+uint32_t attributeSize(AttributeFormat format) {
+	return formatInfo(format).size;
+}
+
+VertexLayout makeVertexLayout(AttributeFormat position, AttributeFormat color, AttributeFormat texCoord, AttributeFormat normal) {
+	VertexLayout layout;
+	layout.formats = { position, color, texCoord, normal };
+
+	// every format is a multiple of 4 bytes, so packing them back to back keeps them aligned
+	for (uint32_t a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++) {
+		layout.offsets[a] = layout.stride;
+		layout.stride += attributeSize(layout.formats[a]);
+		if (layout.formats[a] != AttributeFormat::None) layout.mask |= 1u << a;
+		layout.key |= static_cast<uint32_t>(layout.formats[a]) << (a * 4);
+	}
+	return layout;
+}
+
+const VertexLayout& fullVertexLayout() {
+	static const VertexLayout layout = makeVertexLayout(AttributeFormat::Float4, AttributeFormat::Float4, AttributeFormat::Float2, AttributeFormat::Float4);
+	return layout;
+}
+
+const VertexLayout& compactVertexLayout() {
+	static const VertexLayout layout = makeVertexLayout(AttributeFormat::Float3, AttributeFormat::Unorm8x4, AttributeFormat::Half2, AttributeFormat::Snorm10x3_2);
+	return layout;
+}
+
+const VertexLayout& internVertexLayout(const VertexLayout& layout) {
+	// the key encodes every format, and the offsets follow from the formats. asset loader threads intern too
+	static std::mutex mutex;
+	static std::unordered_map<uint32_t, std::unique_ptr<VertexLayout>> layouts;
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<VertexLayout>& interned = layouts[layout.key];
+	if (interned == nullptr) interned = std::make_unique<VertexLayout>(layout);
+	return *interned;
+}
+
+void setupVertexLayout(uint32_t vao, const VertexLayout& layout) {
+	for (uint32_t a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++) {
+		AttributeFormatInfo info = formatInfo(layout.formats[a]);
+		if (info.components == 0) {
+			glDisableVertexArrayAttrib(vao, a);
+			continue;
+		}
+		glVertexArrayAttribBinding(vao, a, 0);
+		glVertexArrayAttribFormat(vao, a, info.components, info.type, info.normalized, layout.offsets[a]);
+		glEnableVertexArrayAttrib(vao, a);
+	}
+}
+
+static void writeAttribute(AttributeFormat format, const glm::vec4& v, uint8_t* out) {
+	switch (format) {
+	case AttributeFormat::Float2:
+	case AttributeFormat::Float3:
+	case AttributeFormat::Float4:
+		std::memcpy(out, &v, attributeSize(format));
+		break;
+	case AttributeFormat::Half2: {
+		uint32_t packed = glm::packHalf2x16(glm::vec2(v));
+		std::memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	case AttributeFormat::Half4: {
+		uint64_t packed = glm::packHalf4x16(v);
+		std::memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	case AttributeFormat::Unorm8x4: {
+		uint32_t packed = glm::packUnorm4x8(v);
+		std::memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	case AttributeFormat::Snorm10x3_2: {
+		uint32_t packed = glm::packSnorm3x10_1x2(v);
+		std::memcpy(out, &packed, sizeof(packed));
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void packVertices(const VertexLayout& layout, const Vertex* vertices, size_t count, void* out) {
+	if (layout.key == fullVertexLayout().key) {
+		std::memcpy(out, vertices, count * sizeof(Vertex));
+		return;
+	}
+
+	uint8_t* dst = static_cast<uint8_t*>(out);
+	for (size_t i = 0; i < count; i++) {
+		const Vertex& v = vertices[i];
+		std::array<glm::vec4, VERTEX_ATTRIBUTE_COUNT> values = { v.position, v.color, glm::vec4(v.textureCoords, 0.0f, 1.0f), v.normals };
+		for (uint32_t a = 0; a < VERTEX_ATTRIBUTE_COUNT; a++) {
+			writeAttribute(layout.formats[a], values[a], dst + layout.offsets[a]);
+		}
+		dst += layout.stride;
+	}
+}
+
+uint32_t reflectVertexInputs(uint32_t program) {
+	int32_t count = 0;
+	glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+
+	uint32_t mask = 0;
+	for (int32_t i = 0; i < count; i++) {
+		const GLenum prop = GL_LOCATION;
+		int32_t location = -1;
+		glGetProgramResourceiv(program, GL_PROGRAM_INPUT, i, 1, &prop, 1, nullptr, &location);
+		if (location >= 0 && location < static_cast<int32_t>(VERTEX_ATTRIBUTE_COUNT)) mask |= 1u << location;
+	}
+	return mask;
+}
+
+bool checkVertexLayout(const Mesh* mesh, const Material* material) {
+	static std::set<std::pair<uint32_t, uint32_t>> warned;
+
+	bool ok = true;
+	for (const ShaderProgram* program : { material->shader, material->instancedShader }) {
+		if (program == nullptr) continue;
+
+		uint32_t missing = program->vertexInputs & ~mesh->layout->mask;
+		if (missing == 0) continue;
+
+		ok = false;
+		if (warned.insert({ mesh->layout->key, program->handle }).second) {
+			spdlog::warn("Program {} reads vertex attributes 0x{:x} the mesh layout does not store, they read as (0, 0, 0, 1)", program->handle, missing);
+		}
+	}
+	return ok;
+}
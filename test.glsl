@@ -1,22 +1,61 @@
-#type fragment
 #version 430 core
+/*
+variants:
+  DRAW_CONSTANTS_BLOCK  model, color and fade come from a uniform block instead of plain uniforms
+  OIT_ACCUMULATE        see fragment_output.glsl
+  CLUSTERED_LIGHTING    lit by the clustered point lights instead of darkened with depth
+*/
+
+#type vertex
+#include "vertex_inputs.glsl"
+#include "frame_constants.glsl"
+#include "draw_constants.glsl"
 
-uniform vec4 uColor;
+// bit for bit what depth_only.glsl writes, so the colour pass passes the depth test the pre-pass laid down
+invariant gl_Position;
 
-out vec4 outColor;
+#ifdef CLUSTERED_LIGHTING
+out vec3 vWorldPosition;
+out vec3 vNormal;
+#endif
 
-float near = 0.1; 
-float far  = 100.0; 
-  
-float LinearizeDepth(float depth) 
-{
-    float z = depth * 2.0 - 1.0; // back to NDC 
-    return (2.0 * near * far) / (far + near - z * (far - near));	
+void main() {
+	gl_Position = uViewProjection * uModel * inPos;
+#ifdef CLUSTERED_LIGHTING
+	vWorldPosition = vec3(uModel * inPos);
+	// uniform scale only, like the rest of the engine
+	vNormal = mat3(uModel) * inNormals.xyz;
+#endif
 }
 
+#type fragment
+#include "depth_shade.glsl"
+#include "draw_constants.glsl"
+#include "fragment_output.glsl"
+#ifdef CLUSTERED_LIGHTING
+#include "clustered_lights.glsl"
+
+in vec3 vWorldPosition;
+in vec3 vNormal;
+#endif
+
+const float bayer[16] = float[](
+	 0.0,  8.0,  2.0, 10.0,
+	12.0,  4.0, 14.0,  6.0,
+	 3.0, 11.0,  1.0,  9.0,
+	15.0,  7.0, 13.0,  5.0);
 
 void main() {
-//	outColor = uColor;
-	outColor = vec4((1 - LinearizeDepth(gl_FragCoord.z) / 6) * uColor.rgb, uColor.a);
-}
+	ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+	float dither = (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+	// the outgoing and incoming levels keep complementary pixels
+	if (uLodFade > 0.0 && dither >= uLodFade) discard;
+	if (uLodFade < 0.0 && dither < -uLodFade) discard;
 
+//	writeColor(uColor);
+#ifdef CLUSTERED_LIGHTING
+	writeColor(vec4(shadeClustered(uColor.rgb, vWorldPosition, vNormal), uColor.a));
+#else
+	writeColor(vec4(depthShade(uColor.rgb), uColor.a));
+#endif
+}